@@ -0,0 +1,335 @@
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+#include "Utils.h"
+
+//the three kernels in kernels/gemm.cl
+enum GemmVariant {
+	GEMM_NAIVE,	//one output per work-item, operands read from global memory
+	GEMM_TILED,	//TS x TS local memory tiles, one output per work-item
+	GEMM_REGBLOCK	//local memory tiles filled with vector loads, WPT x WPT outputs per work-item
+};
+
+const char* GemmVariantName(GemmVariant variant) {
+	switch (variant) {
+	case GEMM_NAIVE: return "naive";
+	case GEMM_TILED: return "tiled";
+	case GEMM_REGBLOCK: return "regblock";
+	default: return "unknown";
+	}
+}
+
+//tile configuration, passed to kernels/gemm.cl as build options
+struct GemmConfig {
+	int ts;		//tile size
+	int wpt;	//outputs per work-item in each dimension (register blocked kernel only)
+	int vw;		//vector load width (register blocked kernel only)
+};
+
+//programs built for the tuned configurations of one precision, gemm_naive is taken from the tiled program
+struct GemmPlan {
+	GemmConfig tiled;
+	GemmConfig regblock;
+	cl::Program tiled_program;
+	cl::Program regblock_program;
+};
+
+template <typename T> const char* GemmTypeName();
+template <> const char* GemmTypeName<float>() { return "float"; }
+template <> const char* GemmTypeName<double>() { return "double"; }
+
+bool DeviceSupportsDouble(const cl::Context& context) {
+	string extensions = context.getInfo<CL_CONTEXT_DEVICES>()[0].getInfo<CL_DEVICE_EXTENSIONS>();
+	return extensions.find("cl_khr_fp64") != string::npos;
+}
+
+template <typename T>
+cl::Program BuildGemmProgram(const cl::Context& context, const GemmConfig& config, cl_int* err = NULL) {
+	stringstream options;
+	options << "-DREAL=" << GemmTypeName<T>() << " -DTS=" << config.ts << " -DWPT=" << config.wpt << " -DVW=" << config.vw;
+	if (sizeof(T) == sizeof(double))
+		options << " -DUSE_DOUBLE";
+	return BuildProgram(context, "kernels/gemm.cl", options.str(), err);
+}
+
+//enqueue C_i = alpha*op(A_i)*op(B_i) + beta*C_i for batch problems packed one after another in A, B and C
+//op(A) is M x K, op(B) is K x N, all matrices are row-major; the enqueue status is returned through err
+template <typename T>
+cl::Event Gemm(cl::CommandQueue& queue, const GemmPlan& plan, GemmVariant variant, bool transA, bool transB,
+		int M, int N, int K, T alpha, const cl::Buffer& A, const cl::Buffer& B, T beta, cl::Buffer& C, int batch = 1, cl_int* err = NULL) {
+	cl::Kernel kernel(variant == GEMM_REGBLOCK ? plan.regblock_program : plan.tiled_program,
+		variant == GEMM_NAIVE ? "gemm_naive" : (variant == GEMM_TILED ? "gemm_tiled" : "gemm_regblock"));
+
+	kernel.setArg(0, M);
+	kernel.setArg(1, N);
+	kernel.setArg(2, K);
+	kernel.setArg(3, alpha);
+	kernel.setArg(4, A);
+	kernel.setArg(5, transA ? M : K); //lda
+	kernel.setArg(6, (int)transA);
+	kernel.setArg(7, B);
+	kernel.setArg(8, transB ? K : N); //ldb
+	kernel.setArg(9, (int)transB);
+	kernel.setArg(10, beta);
+	kernel.setArg(11, C);
+	kernel.setArg(12, N); //ldc
+	kernel.setArg(13, M * K);
+	kernel.setArg(14, K * N);
+	kernel.setArg(15, M * N);
+
+	cl::NDRange global_size, local_size;
+	if (variant == GEMM_NAIVE) {
+		global_size = cl::NDRange(N, M, batch);
+		local_size = cl::NullRange;
+	}
+	else if (variant == GEMM_TILED) {
+		int ts = plan.tiled.ts;
+		global_size = cl::NDRange((N + ts - 1) / ts * ts, (M + ts - 1) / ts * ts, batch);
+		local_size = cl::NDRange(ts, ts, 1);
+	}
+	else {
+		int ts = plan.regblock.ts;
+		int rts = ts / plan.regblock.wpt;
+		global_size = cl::NDRange((N + ts - 1) / ts * rts, (M + ts - 1) / ts * rts, batch);
+		local_size = cl::NDRange(rts, rts, 1);
+	}
+
+	cl::Event prof_event;
+	cl_int status = queue.enqueueNDRangeKernel(kernel, cl::NullRange, global_size, local_size, NULL, &prof_event);
+	if (err)
+		*err = status;
+	return prof_event;
+}
+
+//tile configurations that fit the work-group size and local memory limits of the device
+template <typename T>
+vector<GemmConfig> GemmCandidates(const cl::Device& device, GemmVariant variant) {
+	size_t max_group = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+	cl_ulong local_mem = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+	vector<GemmConfig> candidates;
+
+	if (variant == GEMM_TILED) {
+		for (int ts : { 8, 16, 32 }) {
+			if ((size_t)(ts * ts) <= max_group && 2 * ts * ts * sizeof(T) <= local_mem)
+				candidates.push_back({ ts, 1, 2 });
+		}
+	}
+	else if (variant == GEMM_REGBLOCK) {
+		for (int ts : { 32, 64, 128 })
+			for (int wpt : { 2, 4, 8 })
+				for (int vw : { 2, 4, 8 }) {
+					int rts = ts / wpt;
+					if (vw <= ts && rts >= 4 && (size_t)(rts * rts) <= max_group && 2 * ts * ts * sizeof(T) <= local_mem)
+						candidates.push_back({ ts, wpt, vw });
+				}
+	}
+
+	return candidates;
+}
+
+//fastest configuration of a variant on a 512^3 problem, candidates that fail to build or launch are skipped
+template <typename T>
+GemmConfig TuneGemmVariant(const cl::Context& context, cl::CommandQueue& queue, GemmVariant variant) {
+	const int size = 512;
+	const int repeats = 3;
+	vector<T> host(size * size);
+	for (size_t i = 0; i < host.size(); i++)
+		host[i] = (T)(rand() % 100) / 100;
+
+	cl::Buffer A(context, CL_MEM_READ_ONLY, host.size() * sizeof(T));
+	cl::Buffer B(context, CL_MEM_READ_ONLY, host.size() * sizeof(T));
+	cl::Buffer C(context, CL_MEM_READ_WRITE, host.size() * sizeof(T));
+	queue.enqueueWriteBuffer(A, CL_TRUE, 0, host.size() * sizeof(T), &host[0]);
+	queue.enqueueWriteBuffer(B, CL_TRUE, 0, host.size() * sizeof(T), &host[0]);
+
+	vector<GemmConfig> candidates = GemmCandidates<T>(context.getInfo<CL_CONTEXT_DEVICES>()[0], variant);
+	GemmConfig best = { 16, 1, 2 };
+	cl_ulong best_time = 0;
+
+	for (const GemmConfig& config : candidates) {
+		GemmPlan plan;
+		cl_int err = CL_SUCCESS;
+		plan.tiled = plan.regblock = config;
+		plan.tiled_program = plan.regblock_program = BuildGemmProgram<T>(context, config, &err);
+
+		//warm up, this also rejects configurations the device cannot launch (e.g. too many registers)
+		if (err == CL_SUCCESS)
+			Gemm<T>(queue, plan, variant, false, false, size, size, size, 1, A, B, 0, C, 1, &err).wait();
+
+		if (err != CL_SUCCESS) {
+			std::cerr << "skipping " << GemmVariantName(variant) << " TS=" << config.ts << " WPT=" << config.wpt << " VW=" << config.vw
+				<< ": " << getErrorString(err) << std::endl;
+			continue;
+		}
+
+		cl_ulong total = 0;
+		for (int r = 0; r < repeats; r++) {
+			cl::Event prof_event = Gemm<T>(queue, plan, variant, false, false, size, size, size, 1, A, B, 0, C);
+			prof_event.wait();
+			total += prof_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - prof_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+		}
+
+		if (!best_time || total < best_time) {
+			best_time = total;
+			best = config;
+		}
+	}
+
+	return best;
+}
+
+//build a plan for the device in context; tuned configurations are kept in cache_file, keyed by device
+//name, precision and variant, so each device is only tuned the first time
+template <typename T>
+GemmPlan TuneGemm(const cl::Context& context, cl::CommandQueue& queue, const string& cache_file = "gemm_tuning.txt") {
+	string device_name = context.getInfo<CL_CONTEXT_DEVICES>()[0].getInfo<CL_DEVICE_NAME>();
+
+	//cache line format: device;type;variant;ts;wpt;vw
+	std::map<string, GemmConfig> cache;
+	ifstream in(cache_file);
+	string line;
+	while (getline(in, line)) {
+		size_t split = line.size();
+		for (int i = 0; i < 3 && split != string::npos && split > 0; i++)
+			split = line.rfind(';', split - 1);
+		if (split == string::npos || split == 0)
+			continue;
+		GemmConfig config;
+		if (sscanf(line.c_str() + split + 1, "%d;%d;%d", &config.ts, &config.wpt, &config.vw) == 3)
+			cache[line.substr(0, split)] = config;
+	}
+	in.close();
+
+	GemmPlan plan;
+	GemmConfig* configs[] = { &plan.tiled, &plan.regblock };
+	GemmVariant variants[] = { GEMM_TILED, GEMM_REGBLOCK };
+
+	for (int i = 0; i < 2; i++) {
+		string key = device_name + ";" + GemmTypeName<T>() + ";" + GemmVariantName(variants[i]);
+		if (cache.count(key)) {
+			*configs[i] = cache[key];
+		}
+		else {
+			std::cout << "tuning " << GemmTypeName<T>() << " " << GemmVariantName(variants[i]) << " GEMM on " << device_name << "..." << std::endl;
+			*configs[i] = TuneGemmVariant<T>(context, queue, variants[i]);
+			ofstream out(cache_file, std::ios::app);
+			out << key << ";" << configs[i]->ts << ";" << configs[i]->wpt << ";" << configs[i]->vw << std::endl;
+		}
+	}
+
+	plan.tiled_program = BuildGemmProgram<T>(context, plan.tiled);
+	plan.regblock_program = BuildGemmProgram<T>(context, plan.regblock);
+
+	std::cout << GemmTypeName<T>() << " GEMM: tiled TS=" << plan.tiled.ts << ", regblock TS=" << plan.regblock.ts
+		<< " WPT=" << plan.regblock.wpt << " VW=" << plan.regblock.vw << std::endl;
+
+	return plan;
+}
+
+//element (row, col) of C_batch = op(A_batch)*op(B_batch) computed serially in double precision
+template <typename T>
+double GemmReferenceEntry(const vector<T>& A, const vector<T>& B, bool transA, bool transB,
+			int M, int N, int K, int batch, int row, int col) {
+	const T* a = &A[(size_t)batch * M * K];
+	const T* b = &B[(size_t)batch * K * N];
+	double result = 0;
+	for (int k = 0; k < K; k++)
+		result += (double)(transA ? a[k * M + row] : a[row * K + k]) * (transB ? b[col * K + k] : b[k * N + col]);
+	return result;
+}
+
+struct GemmShape {
+	const char* label;
+	int M, N, K;
+	int batch;
+	bool transA, transB;
+};
+
+//GFLOP/s of every variant on square, skinny, transposed and batched problems, each result is checked
+//against the CPU reference on a random sample of entries
+template <typename T>
+void BenchmarkGemmType(const cl::Context& context, cl::CommandQueue& queue) {
+	const int repeats = 3;
+	const int samples = 256;
+	const double tolerance = sizeof(T) == sizeof(float) ? 1e-4 : 1e-10; //per unit of K
+
+	GemmPlan plan = TuneGemm<T>(context, queue);
+
+	GemmShape shapes[] = {
+		{ "square", 256, 256, 256, 1, false, false },
+		{ "square", 512, 512, 512, 1, false, false },
+		{ "square", 1024, 1024, 1024, 1, false, false },
+		{ "square", 2048, 2048, 2048, 1, false, false },
+		{ "skinny", 4096, 64, 4096, 1, false, false },
+		{ "skinny", 64, 4096, 4096, 1, false, false },
+		{ "low rank", 4096, 4096, 32, 1, false, false },
+		{ "odd size", 1000, 999, 1001, 1, false, false },
+		{ "A^T", 1024, 1024, 1024, 1, true, false },
+		{ "B^T", 1024, 1024, 1024, 1, false, true },
+		{ "A^T B^T", 1024, 1024, 1024, 1, true, true },
+		{ "batched", 16, 16, 16, 4096, false, false },
+		{ "batched", 32, 32, 32, 2048, false, false },
+		{ "batched", 64, 64, 64, 512, false, true },
+	};
+
+	std::cout << std::endl << GemmTypeName<T>() << " GEMM" << std::endl;
+	std::cout << std::setw(10) << "shape" << std::setw(7) << "M" << std::setw(7) << "N" << std::setw(7) << "K" << std::setw(7) << "batch"
+		<< std::setw(10) << "variant" << std::setw(12) << "time [us]" << std::setw(10) << "GFLOP/s" << std::setw(8) << "check" << std::endl;
+
+	for (const GemmShape& shape : shapes) {
+		size_t size_A = (size_t)shape.M * shape.K * shape.batch;
+		size_t size_B = (size_t)shape.K * shape.N * shape.batch;
+		size_t size_C = (size_t)shape.M * shape.N * shape.batch;
+
+		vector<T> A(size_A), B(size_B), C(size_C);
+		for (size_t i = 0; i < size_A; i++) A[i] = (T)(rand() % 2000 - 1000) / 1000;
+		for (size_t i = 0; i < size_B; i++) B[i] = (T)(rand() % 2000 - 1000) / 1000;
+
+		cl::Buffer buffer_A(context, CL_MEM_READ_ONLY, size_A * sizeof(T));
+		cl::Buffer buffer_B(context, CL_MEM_READ_ONLY, size_B * sizeof(T));
+		cl::Buffer buffer_C(context, CL_MEM_READ_WRITE, size_C * sizeof(T));
+		queue.enqueueWriteBuffer(buffer_A, CL_TRUE, 0, size_A * sizeof(T), &A[0]);
+		queue.enqueueWriteBuffer(buffer_B, CL_TRUE, 0, size_B * sizeof(T), &B[0]);
+
+		for (GemmVariant variant : { GEMM_NAIVE, GEMM_TILED, GEMM_REGBLOCK }) {
+			queue.enqueueFillBuffer(buffer_C, (T)0, 0, size_C * sizeof(T));
+
+			cl_ulong total = 0;
+			for (int r = 0; r < repeats; r++) {
+				cl::Event prof_event = Gemm<T>(queue, plan, variant, shape.transA, shape.transB, shape.M, shape.N, shape.K,
+					1, buffer_A, buffer_B, 0, buffer_C, shape.batch);
+				prof_event.wait();
+				total += prof_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - prof_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+			}
+			double seconds = (double)total / repeats / PROF_S;
+			double gflops = 2.0 * shape.M * shape.N * shape.K * shape.batch / seconds / 1e9;
+
+			queue.enqueueReadBuffer(buffer_C, CL_TRUE, 0, size_C * sizeof(T), &C[0]);
+			bool correct = true;
+			for (int s = 0; s < samples; s++) {
+				int b = rand() % shape.batch, row = rand() % shape.M, col = rand() % shape.N;
+				double expected = GemmReferenceEntry(A, B, shape.transA, shape.transB, shape.M, shape.N, shape.K, b, row, col);
+				if (std::fabs(C[(size_t)b * shape.M * shape.N + row * shape.N + col] - expected) > tolerance * shape.K)
+					correct = false;
+			}
+
+			std::cout << std::setw(10) << shape.label << std::setw(7) << shape.M << std::setw(7) << shape.N << std::setw(7) << shape.K
+				<< std::setw(7) << shape.batch << std::setw(10) << GemmVariantName(variant) << std::setw(12) << (int)(seconds * 1e6)
+				<< std::setw(10) << std::fixed << std::setprecision(1) << gflops << std::setw(8) << (correct ? "OK" : "FAILED") << std::endl;
+		}
+	}
+}
+
+void BenchmarkGemm(const cl::Context& context, cl::CommandQueue& queue) {
+	BenchmarkGemmType<float>(context, queue);
+
+	if (DeviceSupportsDouble(context))
+		BenchmarkGemmType<double>(context, queue);
+	else
+		std::cout << "double GEMM skipped, the device does not support cl_khr_fp64" << std::endl;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+
+#include "Utils.h"
+
+//how the stencil treats reads outside of the input, must match the STENCIL_* defines in kernels/stencil.cl
+enum StencilBoundary {
+	STENCIL_CLAMP = 0,	//repeat the edge value
+	STENCIL_MIRROR = 1,	//reflect around the edge value (without repeating it)
+	STENCIL_ZERO = 2,	//treat everything outside as 0
+	STENCIL_WRAP = 3	//periodic signal
+};
+
+const char* StencilBoundaryName(StencilBoundary mode) {
+	switch (mode) {
+	case STENCIL_CLAMP: return "clamp";
+	case STENCIL_MIRROR: return "mirror";
+	case STENCIL_ZERO: return "zero";
+	case STENCIL_WRAP: return "wrap";
+	default: return "unknown";
+	}
+}
+
+//2*radius+1 equal weights - a moving average (generalises avg_filter)
+vector<float> MovingAverageWeights(int radius) {
+	return vector<float>(2 * radius + 1, 1.0f / (2 * radius + 1));
+}
+
+//central finite difference approximating the first derivative with accuracy order 2*radius
+//w[radius +/- k] = +/- (-1)^(k+1) * (r!)^2 / (k * (r-k)! * (r+k)!)
+vector<float> FiniteDifferenceWeights(int radius) {
+	vector<float> weights(2 * radius + 1, 0.0f);
+	for (int k = 1; k <= radius; k++) {
+		double c = ((k % 2) ? 1.0 : -1.0) / k;
+		for (int i = 1; i <= k; i++) //r!/(r-k)! divided by (r+k)!/r!, as a product of small ratios
+			c *= (double)(radius - k + i) / (radius + i);
+		weights[radius + k] = (float)c;
+		weights[radius - k] = (float)-c;
+	}
+	return weights;
+}
+
+//map an out-of-range index the same way stencil_fetch does on the device (-1 means a zero read)
+int StencilIndex(int i, int N, StencilBoundary mode) {
+	if (i >= 0 && i < N) return i;
+	switch (mode) {
+	case STENCIL_CLAMP: return i < 0 ? 0 : N - 1;
+	case STENCIL_WRAP: return ((i % N) + N) % N;
+	case STENCIL_MIRROR: {
+		int period = std::max(2 * N - 2, 1);
+		i = ((i % period) + period) % period;
+		return (i >= N) ? period - i : i;
+	}
+	default: return -1;
+	}
+}
+
+//serial reference implementation used to validate the device results
+vector<float> Stencil1DReference(const vector<float>& A, const vector<float>& W, StencilBoundary mode) {
+	int N = (int)A.size();
+	int radius = (int)W.size() / 2;
+	vector<float> B(N);
+	for (int i = 0; i < N; i++) {
+		float result = 0.0f;
+		for (int k = 0; k <= 2 * radius; k++) {
+			int j = StencilIndex(i + k - radius, N, mode);
+			result += W[k] * (j < 0 ? 0.0f : A[j]);
+		}
+		B[i] = result;
+	}
+	return B;
+}
+
+//enqueue the stencil_1d kernel over N elements of A into B using weights W (2*radius+1 floats)
+//the global size is padded up to a multiple of local_size, the kernel guards the padding itself
+cl::Event Stencil1D(cl::CommandQueue& queue, cl::Program& program, cl::Buffer& A, cl::Buffer& B, cl::Buffer& W,
+			int radius, int N, StencilBoundary mode, size_t local_size = 256) {
+	cl::Kernel kernel(program, "stencil_1d");
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, W);
+	kernel.setArg(3, radius);
+	kernel.setArg(4, N);
+	kernel.setArg(5, (int)mode);
+	kernel.setArg(6, cl::Local((local_size + 2 * radius) * sizeof(float)));
+
+	size_t global_size = ((N + local_size - 1) / local_size) * local_size;
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size), NULL, &prof_event);
+	return prof_event;
+}
+
+//largest absolute difference between two equally sized vectors
+float MaxAbsError(const vector<float>& A, const vector<float>& B) {
+	float error = 0.0f;
+	for (size_t i = 0; i < A.size(); i++)
+		error = std::max(error, std::fabs(A[i] - B[i]));
+	return error;
+}
+
+//checks every boundary mode on a short signal and reports the throughput of moving averages of growing radius on a long one
+void BenchmarkStencil1D(cl::Context& context, cl::CommandQueue& queue, cl::Program& program, int N = 1 << 22) {
+	const int repeats = 10;
+	size_t local_size = 256;
+	int max_radius = 256;
+
+	//a noisy time series
+	vector<float> A(N);
+	for (int i = 0; i < N; i++)
+		A[i] = std::sin(i * 0.001f) + (rand() % 1000) / 1000.0f;
+
+	vector<float> B(N);
+
+	cl::Buffer buffer_A(context, CL_MEM_READ_ONLY, N * sizeof(float));
+	cl::Buffer buffer_B(context, CL_MEM_READ_WRITE, N * sizeof(float));
+	cl::Buffer buffer_W(context, CL_MEM_READ_ONLY, (2 * max_radius + 1) * sizeof(float));
+
+	queue.enqueueWriteBuffer(buffer_A, CL_TRUE, 0, N * sizeof(float), &A[0]);
+
+	//correctness of all boundary modes, including radius larger than the signal itself
+	int short_N = 37;
+	vector<float> short_A(A.begin(), A.begin() + short_N);
+	for (int mode = STENCIL_CLAMP; mode <= STENCIL_WRAP; mode++) {
+		for (int radius : { 1, 5, 50 }) {
+			vector<float> W(2 * radius + 1); //asymmetric weights, so that a flipped window shows up
+			for (int k = 0; k <= 2 * radius; k++) W[k] = (k + 1.0f) / W.size();
+			queue.enqueueWriteBuffer(buffer_W, CL_TRUE, 0, W.size() * sizeof(float), &W[0]);
+			Stencil1D(queue, program, buffer_A, buffer_B, buffer_W, radius, short_N, (StencilBoundary)mode, local_size);
+			vector<float> short_B(short_N);
+			queue.enqueueReadBuffer(buffer_B, CL_TRUE, 0, short_N * sizeof(float), &short_B[0]);
+
+			float error = MaxAbsError(short_B, Stencil1DReference(short_A, W, (StencilBoundary)mode));
+			std::cout << "check " << StencilBoundaryName((StencilBoundary)mode) << " radius " << radius
+				<< ": max error " << error << (error < 1e-4f ? " OK" : " FAILED") << std::endl;
+		}
+	}
+
+	//finite differences of the whole signal
+	vector<float> D = FiniteDifferenceWeights(4);
+	queue.enqueueWriteBuffer(buffer_W, CL_TRUE, 0, D.size() * sizeof(float), &D[0]);
+	Stencil1D(queue, program, buffer_A, buffer_B, buffer_W, 4, N, STENCIL_MIRROR, local_size);
+	queue.enqueueReadBuffer(buffer_B, CL_TRUE, 0, N * sizeof(float), &B[0]);
+	float error = MaxAbsError(B, Stencil1DReference(A, D, STENCIL_MIRROR));
+	std::cout << "check finite difference mirror radius 4: max error " << error << (error < 1e-4f ? " OK" : " FAILED") << std::endl;
+
+	std::cout << "1D stencil (moving average, clamp), N = " << N << ", local size = " << local_size << std::endl;
+	std::cout << std::setw(8) << "radius" << std::setw(14) << "time [us]" << std::setw(16) << "Melements/s"
+		<< std::setw(12) << "GB/s" << std::setw(14) << "max error" << std::endl;
+
+	for (int radius = 1; radius <= max_radius; radius *= 2) {
+		vector<float> W = MovingAverageWeights(radius);
+		queue.enqueueWriteBuffer(buffer_W, CL_TRUE, 0, W.size() * sizeof(float), &W[0]);
+
+		cl_ulong total = 0;
+		for (int r = 0; r < repeats; r++) {
+			cl::Event prof_event = Stencil1D(queue, program, buffer_A, buffer_B, buffer_W, radius, N, STENCIL_CLAMP, local_size);
+			prof_event.wait();
+			total += prof_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - prof_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+		}
+		double seconds = (double)total / repeats / PROF_S;
+
+		queue.enqueueReadBuffer(buffer_B, CL_TRUE, 0, N * sizeof(float), &B[0]);
+		float error = MaxAbsError(B, Stencil1DReference(A, W, STENCIL_CLAMP));
+
+		std::cout << std::setw(8) << radius << std::setw(14) << (int)(seconds * 1e6) << std::setw(16) << (int)(N / seconds / 1e6)
+			<< std::setw(12) << std::setprecision(3) << (2.0 * N * sizeof(float) / seconds / 1e9) << std::setw(14) << error << std::endl;
+	}
+}
@@ -128,6 +128,32 @@ void AddSources(cl::Program::Sources& sources, const string& file_name) {
 	sources.push_back((*source_code).c_str());
 }
 
+//load a single kernel file and build it with the given options (e.g. "-DTS=16"), printing the build log on failure
+//the build status is returned through err, which also works when the bindings are used without exceptions
+cl::Program BuildProgram(const cl::Context& context, const string& file_name, const string& options = "", cl_int* err = NULL) {
+	cl::Program::Sources sources;
+	AddSources(sources, file_name);
+	cl::Program program(context, sources);
+
+	cl_int status = CL_BUILD_PROGRAM_FAILURE;
+	try {
+		status = program.build(options.c_str());
+	}
+	catch (...) {
+	}
+
+	if (status != CL_SUCCESS) {
+		std::cout << "Build Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
+		std::cout << "Build Options:\t" << program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
+		std::cout << "Build Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
+	}
+
+	if (err)
+		*err = status;
+
+	return program;
+}
+
 string ListPlatformsDevices() {
 
 	stringstream sstream;
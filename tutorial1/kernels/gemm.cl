@@ -0,0 +1,191 @@
+//dense matrix multiplication C = alpha*op(A)*op(B) + beta*C, all matrices row-major
+//op(A) is M x K, op(B) is K x N and C is M x N, op(X) = X or X^T depending on transA/transB
+//the program is built once per precision and tile configuration with the following options:
+//  -DREAL=float|double  element type (-DUSE_DOUBLE enables cl_khr_fp64)
+//  -DTS=n   tile size of the tiled and register blocked kernels
+//  -DWPT=n  outputs per work-item in each dimension of the register blocked kernel
+//  -DVW=n   width of the vector loads in the register blocked kernel (2, 4 or 8)
+//the third global dimension indexes a batch of independent problems packed with strides strideA/B/C
+
+#ifdef USE_DOUBLE
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#ifndef REAL
+#define REAL float
+#endif
+#ifndef TS
+#define TS 16
+#endif
+#ifndef WPT
+#define WPT 4
+#endif
+#ifndef VW
+#define VW 4
+#endif
+
+#define RTS (TS / WPT) //work-items per dimension of the register blocked kernel
+
+#define CAT_(a, b) a##b
+#define CAT(a, b) CAT_(a, b)
+#define REALN CAT(REAL, VW)
+#define VLOADN CAT(vload, VW)
+#define VSTOREN CAT(vstore, VW)
+
+//element (row, col) of op(X) where X has leading dimension ld
+#define OP_AT(X, ld, trans, row, col) ((trans) ? X[(col) * (ld) + (row)] : X[(row) * (ld) + (col)])
+
+//one work-item per output element, every operand is read straight from global memory
+kernel void gemm_naive(const int M, const int N, const int K, const REAL alpha,
+			global const REAL* A, const int lda, const int transA,
+			global const REAL* B, const int ldb, const int transB,
+			const REAL beta, global REAL* C, const int ldc,
+			const int strideA, const int strideB, const int strideC) {
+	int col = get_global_id(0);
+	int row = get_global_id(1);
+	int batch = get_global_id(2);
+
+	if (row >= M || col >= N)
+		return;
+
+	A += batch * strideA;
+	B += batch * strideB;
+	C += batch * strideC;
+
+	REAL result = 0;
+	for (int k = 0; k < K; k++)
+		result += OP_AT(A, lda, transA, row, k) * OP_AT(B, ldb, transB, k, col);
+
+	C[row * ldc + col] = alpha * result + (beta != 0 ? beta * C[row * ldc + col] : 0);
+}
+
+//TS x TS tiles of op(A) and op(B) are staged in local memory, one output element per work-item
+//requires a local size of TS x TS, edges are handled by zero-filling the tiles
+kernel void gemm_tiled(const int M, const int N, const int K, const REAL alpha,
+			global const REAL* A, const int lda, const int transA,
+			global const REAL* B, const int ldb, const int transB,
+			const REAL beta, global REAL* C, const int ldc,
+			const int strideA, const int strideB, const int strideC) {
+	local REAL Asub[TS][TS];
+	local REAL Bsub[TS][TS];
+
+	int tx = get_local_id(0);
+	int ty = get_local_id(1);
+	int col = get_group_id(0) * TS + tx;
+	int row = get_group_id(1) * TS + ty;
+	int batch = get_global_id(2);
+
+	A += batch * strideA;
+	B += batch * strideB;
+	C += batch * strideC;
+
+	REAL result = 0;
+	for (int t = 0; t < K; t += TS) {
+		Asub[ty][tx] = (row < M && t + tx < K) ? OP_AT(A, lda, transA, row, t + tx) : 0;
+		Bsub[ty][tx] = (t + ty < K && col < N) ? OP_AT(B, ldb, transB, t + ty, col) : 0;
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		for (int k = 0; k < TS; k++)
+			result += Asub[ty][k] * Bsub[k][tx];
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (row < M && col < N)
+		C[row * ldc + col] = alpha * result + (beta != 0 ? beta * C[row * ldc + col] : 0);
+}
+
+//copy the TS x TS block of op(X) starting at (row0, col0) into tile, zero-filling past (rows, cols)
+//the block is read with VW-wide vector loads along the direction that is contiguous in memory
+void gemm_load_tile(global const REAL* X, const int ld, const int trans, const int row0, const int col0,
+			const int rows, const int cols, local REAL tile[TS][TS], const int tid, const int nthreads) {
+	for (int v = tid; v < TS * TS / VW; v += nthreads) {
+		int major = v / (TS / VW); //index across the contiguous direction
+		int minor = (v % (TS / VW)) * VW; //first index along it
+		int r = trans ? minor : major;
+		int c = trans ? major : minor;
+		int grow = row0 + r;
+		int gcol = col0 + c;
+		REAL values[VW];
+
+		if (!trans && grow < rows && gcol + VW <= cols) {
+			VSTOREN(VLOADN(0, X + grow * ld + gcol), 0, values);
+		}
+		else if (trans && gcol < cols && grow + VW <= rows) {
+			VSTOREN(VLOADN(0, X + gcol * ld + grow), 0, values);
+		}
+		else { //matrix edge, scalar loads with bounds checks
+			for (int i = 0; i < VW; i++) {
+				int er = trans ? grow + i : grow;
+				int ec = trans ? gcol : gcol + i;
+				values[i] = (er < rows && ec < cols) ? OP_AT(X, ld, trans, er, ec) : 0;
+			}
+		}
+
+		for (int i = 0; i < VW; i++) {
+			if (trans)
+				tile[r + i][c] = values[i];
+			else
+				tile[r][c + i] = values[i];
+		}
+	}
+}
+
+//register blocked kernel: each work-group computes a TS x TS block of C with a local size of RTS x RTS,
+//so every work-item accumulates WPT x WPT outputs in private memory and reuses each value read from
+//local memory WPT times; tiles are filled with vector loads
+kernel void gemm_regblock(const int M, const int N, const int K, const REAL alpha,
+			global const REAL* A, const int lda, const int transA,
+			global const REAL* B, const int ldb, const int transB,
+			const REAL beta, global REAL* C, const int ldc,
+			const int strideA, const int strideB, const int strideC) {
+	local REAL Asub[TS][TS];
+	local REAL Bsub[TS][TS];
+
+	int tx = get_local_id(0);
+	int ty = get_local_id(1);
+	int tid = ty * RTS + tx;
+	int row0 = get_group_id(1) * TS;
+	int col0 = get_group_id(0) * TS;
+	int batch = get_global_id(2);
+
+	A += batch * strideA;
+	B += batch * strideB;
+	C += batch * strideC;
+
+	REAL acc[WPT][WPT];
+	for (int wm = 0; wm < WPT; wm++)
+		for (int wn = 0; wn < WPT; wn++)
+			acc[wm][wn] = 0;
+
+	for (int t = 0; t < K; t += TS) {
+		gemm_load_tile(A, lda, transA, row0, t, M, K, Asub, tid, RTS * RTS);
+		gemm_load_tile(B, ldb, transB, t, col0, K, N, Bsub, tid, RTS * RTS);
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		for (int k = 0; k < TS; k++) {
+			REAL Breg[WPT];
+			for (int wn = 0; wn < WPT; wn++)
+				Breg[wn] = Bsub[k][tx + wn * RTS];
+
+			for (int wm = 0; wm < WPT; wm++) {
+				REAL a = Asub[ty + wm * RTS][k];
+				for (int wn = 0; wn < WPT; wn++)
+					acc[wm][wn] += a * Breg[wn];
+			}
+		}
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	for (int wm = 0; wm < WPT; wm++) {
+		int row = row0 + ty + wm * RTS;
+		for (int wn = 0; wn < WPT; wn++) {
+			int col = col0 + tx + wn * RTS;
+			if (row < M && col < N)
+				C[row * ldc + col] = alpha * acc[wm][wn] + (beta != 0 ? beta * C[row * ldc + col] : 0);
+		}
+	}
+}
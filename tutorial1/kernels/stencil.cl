@@ -0,0 +1,56 @@
+//boundary modes for out-of-range reads, must match StencilBoundary in Stencil.h
+#define STENCIL_CLAMP 0
+#define STENCIL_MIRROR 1
+#define STENCIL_ZERO 2
+#define STENCIL_WRAP 3
+
+//read A[i] for any i, resolving indices outside [0, N) with the selected boundary mode
+float stencil_fetch(global const float* A, int i, const int N, const int mode) {
+	if (i >= 0 && i < N)
+		return A[i];
+
+	if (mode == STENCIL_ZERO)
+		return 0.0f;
+
+	if (mode == STENCIL_CLAMP) {
+		i = clamp(i, 0, N - 1);
+	}
+	else if (mode == STENCIL_WRAP) {
+		i = ((i % N) + N) % N;
+	}
+	else { //mirror without repeating the edge value: ... 2 1 | 0 1 2 ... N-2 N-1 | N-2 N-3 ...
+		int period = max(2 * N - 2, 1);
+		i = ((i % period) + period) % period;
+		if (i >= N)
+			i = period - i;
+	}
+
+	return A[i];
+}
+
+//general 1D stencil: B[i] = sum(W[k] * A[i + k - radius]) for k = 0..2*radius
+//each work-group loads its tile plus a halo of radius elements on each side into local memory once,
+//so every input value is read from global memory only once per work-group
+//tile must hold get_local_size(0) + 2*radius floats, the global size can be padded past N
+kernel void stencil_1d(global const float* A, global float* B, constant float* W,
+			const int radius, const int N, const int mode, local float* tile) {
+	int id = get_global_id(0);
+	int lid = get_local_id(0);
+	int L = get_local_size(0);
+	int tile_start = get_group_id(0) * L - radius; //global index of tile[0]
+
+	//cooperative load of the tile and both halos
+	for (int i = lid; i < L + 2 * radius; i += L)
+		tile[i] = stencil_fetch(A, tile_start + i, N, mode);
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (id >= N) //padding work-items
+		return;
+
+	float result = 0.0f;
+	for (int k = 0; k <= 2 * radius; k++)
+		result += W[k] * tile[lid + k];
+
+	B[id] = result;
+}
@@ -4,6 +4,8 @@
 #define CL_HPP_MINIMUM_OPENCL_VERSION 120
 #include <CL/opencl.hpp>
 #include "Utils.h"
+#include "Stencil.h"
+#include "GEMM.h"
 
 #include <iostream>
 #include <vector>
@@ -13,6 +15,7 @@ void print_help() {
 	std::cerr << "  -p : select platform " << std::endl;
 	std::cerr << "  -d : select device" << std::endl;
 	std::cerr << "  -l : list all platforms and devices" << std::endl;
+	std::cerr << "  -b : run a benchmark instead of the example (stencil, gemm)" << std::endl;
 	std::cerr << "  -h : print this message" << std::endl;
 }
 
@@ -20,11 +23,13 @@ int main(int argc, char **argv) {
 	//Part 1 - handle command line options such as device selection, verbosity, etc.
 	int platform_id = 0;
 	int device_id = 0;
+	string benchmark = "";
 
 	for (int i = 1; i < argc; i++)	{
 		if ((strcmp(argv[i], "-p") == 0) && (i < (argc - 1))) { platform_id = atoi(argv[++i]); }
 		else if ((strcmp(argv[i], "-d") == 0) && (i < (argc - 1))) { device_id = atoi(argv[++i]); }
 		else if (strcmp(argv[i], "-l") == 0) { std::cout << ListPlatformsDevices() << std::endl; }
+		else if ((strcmp(argv[i], "-b") == 0) && (i < (argc - 1))) { benchmark = argv[++i]; }
 		else if (strcmp(argv[i], "-h") == 0) { print_help(); return 0; }
 	}
 
@@ -39,6 +44,7 @@ int main(int argc, char **argv) {
 		cl::Program::Sources sources;
 
 		AddSources(sources, "kernels/my_kernels.cl");
+		AddSources(sources, "kernels/stencil.cl");
 		cl::Program program(context, sources);
 
 		//build and debug the kernel code
@@ -53,6 +59,15 @@ int main(int argc, char **argv) {
 			//throw err;
 		}
 
+		if (benchmark == "stencil") {
+			BenchmarkStencil1D(context, queue, program);
+			return 0;
+		}
+		else if (benchmark == "gemm") {
+			BenchmarkGemm(context, queue);
+			return 0;
+		}
+
 		//Part 3 - memory allocation
 		//host - input
 		
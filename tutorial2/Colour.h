@@ -0,0 +1,222 @@
+#pragma once
+
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+#include "ImagePath.h"
+#include "Layout.h"
+
+//colour space conversions (kernels/colour.cl) in float and fixed point, reading and writing planar or
+//interleaved images directly, and RGB to YCbCr with 4:2:2 or 4:2:0 chroma subsampling in the same pass
+
+//the conversions of colour_convert; the fixed-point versions exist for gray, YCbCr and RGB -> HSV
+enum ColourConversion { COLOUR_RGB_TO_GRAY, COLOUR_RGB_TO_YCBCR, COLOUR_YCBCR_TO_RGB, COLOUR_RGB_TO_HSV, COLOUR_HSV_TO_RGB,
+	COLOUR_RGB_TO_LAB, COLOUR_LAB_TO_RGB };
+
+const char* ColourConversionName(ColourConversion conversion) {
+	static const char* names[] = { "rgb -> gray", "rgb -> ycbcr", "ycbcr -> rgb", "rgb -> hsv", "hsv -> rgb", "rgb -> lab", "lab -> rgb" };
+	return names[conversion];
+}
+
+bool HasFixedPoint(ColourConversion conversion) {
+	return conversion <= COLOUR_RGB_TO_HSV;
+}
+
+//an image as colour.cl addresses it: sample c of pixel id is at id*x + c*y
+cl_int2 ColourLayout(ImageLayout layout, int channels, int image_size) {
+	cl_int2 strides;
+	strides.s[0] = layout == LAYOUT_PLANAR ? 1 : channels;
+	strides.s[1] = layout == LAYOUT_PLANAR ? image_size : 1;
+	return strides;
+}
+
+//converts the 3 (or the first 3 of 4) channels of A into B; RGB -> gray writes a single plane, the other
+//conversions write 3 channels in out_layout with out_channels per pixel (4 leaves the fourth untouched)
+cl::Event ConvertColour(cl::CommandQueue& queue, cl::Program& program, ColourConversion conversion, const cl::Buffer& A, ImageLayout in_layout, int in_channels,
+			cl::Buffer& B, ImageLayout out_layout, int out_channels, int width, int height, bool fixed_point = false) {
+	if (fixed_point && !HasFixedPoint(conversion))
+		throw cl::Error(CL_INVALID_VALUE, "ConvertColour: no fixed-point version of this conversion");
+	int image_size = width * height;
+	cl::Kernel kernel(program, "colour_convert");
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, (int)conversion);
+	kernel.setArg(3, (int)fixed_point);
+	kernel.setArg(4, ColourLayout(in_layout, in_channels, image_size));
+	kernel.setArg(5, conversion == COLOUR_RGB_TO_GRAY ? ColourLayout(LAYOUT_PLANAR, 1, image_size) : ColourLayout(out_layout, out_channels, image_size));
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(image_size), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//chroma resolution relative to the luma
+enum ChromaSubsampling { CHROMA_422, CHROMA_420 };
+
+//planar YCbCr with subsampled chroma, the layout encoders take
+struct YCbCrPlanes {
+	int width, height;
+	int chroma_width, chroma_height;
+	int block_height;	//1 for 4:2:2, 2 for 4:2:0
+	cl::Buffer y, cb, cr;
+};
+
+YCbCrPlanes CreateYCbCrPlanes(const cl::Context& context, int width, int height, ChromaSubsampling subsampling) {
+	YCbCrPlanes planes;
+	planes.width = width;
+	planes.height = height;
+	planes.block_height = subsampling == CHROMA_420 ? 2 : 1;
+	planes.chroma_width = (width + 1) / 2;
+	planes.chroma_height = (height + planes.block_height - 1) / planes.block_height;
+	planes.y = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)width * height);
+	planes.cb = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)planes.chroma_width * planes.chroma_height);
+	planes.cr = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)planes.chroma_width * planes.chroma_height);
+	return planes;
+}
+
+//RGB in either layout to subsampled planes in one pass: every work-item converts a 2x1 or 2x2 block
+cl::Event RgbToYCbCrSubsampled(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, ImageLayout layout, int channels,
+			YCbCrPlanes& planes, bool fixed_point = false) {
+	cl::Kernel kernel(program, "rgb_to_ycbcr_subsampled");
+	kernel.setArg(0, A);
+	kernel.setArg(1, planes.y);
+	kernel.setArg(2, planes.cb);
+	kernel.setArg(3, planes.cr);
+	kernel.setArg(4, planes.width);
+	kernel.setArg(5, planes.height);
+	kernel.setArg(6, planes.block_height);
+	kernel.setArg(7, (int)fixed_point);
+	kernel.setArg(8, ColourLayout(layout, channels, planes.width * planes.height));
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(planes.chroma_width, planes.chroma_height), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//back to RGB, every pixel takes the chroma of its block
+cl::Event YCbCrSubsampledToRgb(cl::CommandQueue& queue, cl::Program& program, const YCbCrPlanes& planes, cl::Buffer& B, ImageLayout layout, int channels,
+			bool fixed_point = false) {
+	cl::Kernel kernel(program, "ycbcr_subsampled_to_rgb");
+	kernel.setArg(0, planes.y);
+	kernel.setArg(1, planes.cb);
+	kernel.setArg(2, planes.cr);
+	kernel.setArg(3, B);
+	kernel.setArg(4, planes.chroma_width);
+	kernel.setArg(5, planes.block_height);
+	kernel.setArg(6, (int)fixed_point);
+	kernel.setArg(7, ColourLayout(layout, channels, planes.width * planes.height));
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(planes.width, planes.height), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//every conversion in float and fixed point on planar, RGB and RGBA input: time, round trip error and whether
+//the layouts give the same result; gray against rgb2gray, and the subsampled conversions against 4:4:4
+void BenchmarkColour(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width(), height = image.height(), image_size = width * height;
+	if (image.spectrum() != 3) {
+		std::cout << "The colour benchmark expects an RGB image" << std::endl;
+		return;
+	}
+
+	//the input in the three layouts
+	const ImageLayout layouts[] = { LAYOUT_PLANAR, LAYOUT_INTERLEAVED, LAYOUT_INTERLEAVED };
+	const int layout_channels[] = { 3, 3, 4 };
+	const char* layout_names[] = { "planar", "rgb", "rgba" };
+	cl::Buffer inputs[3], converted[3], restored[3];
+	for (int l = 0; l < 3; l++) {
+		inputs[l] = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)image_size * layout_channels[l]);
+		converted[l] = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)image_size * layout_channels[l]);
+		restored[l] = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)image_size * layout_channels[l]);
+	}
+	queue.enqueueWriteBuffer(inputs[0], CL_TRUE, 0, image.size(), image.data());
+	PlanarToInterleaved(queue, program, inputs[0], inputs[1], image_size, 3, 3);
+	PlanarToInterleaved(queue, program, inputs[0], inputs[2], image_size, 3, 4);
+	//the untouched alpha channel of the RGBA outputs
+	for (int l = 1; l < 3; l++) {
+		queue.enqueueCopyBuffer(inputs[l], converted[l], 0, 0, (size_t)image_size * layout_channels[l]);
+		queue.enqueueCopyBuffer(inputs[l], restored[l], 0, 0, (size_t)image_size * layout_channels[l]);
+	}
+
+	//results of every layout brought back to planar for comparing
+	cl::Buffer dev_planar(context, CL_MEM_READ_WRITE, image.size());
+	vector<unsigned char> result(image.size()), first(image.size());
+	auto read_planar = [&](cl::Buffer& buffer, int l, vector<unsigned char>& data) {
+		if (l)
+			InterleavedToPlanar(queue, program, buffer, dev_planar, image_size, layout_channels[l], 3);
+		queue.enqueueReadBuffer(l ? dev_planar : buffer, CL_TRUE, 0, image.size(), &data[0]);
+	};
+
+	std::cout << "Colour conversions of a " << width << "x" << height << " image, forward and inverse time [us] per input layout" << std::endl;
+	std::cout << std::setw(16) << "conversion" << std::setw(8) << "";
+	for (int l = 0; l < 3; l++)
+		std::cout << std::setw(10) << layout_names[l] << std::setw(10) << "inverse";
+	std::cout << std::setw(12) << "max error" << std::setw(10) << "layouts" << std::endl;
+
+	const ColourConversion conversions[][2] = { { COLOUR_RGB_TO_YCBCR, COLOUR_YCBCR_TO_RGB }, { COLOUR_RGB_TO_HSV, COLOUR_HSV_TO_RGB },
+		{ COLOUR_RGB_TO_LAB, COLOUR_LAB_TO_RGB } };
+	for (const ColourConversion* pair : conversions)
+		for (int fixed_point = 0; fixed_point < 2; fixed_point++) {
+			if (fixed_point && !HasFixedPoint(pair[0]))
+				continue;
+			std::cout << std::setw(16) << ColourConversionName(pair[0]) << std::setw(8) << (fixed_point ? "fixed" : "float");
+			bool layouts_agree = true;
+			int max_error = 0;
+			for (int l = 0; l < 3; l++) {
+				cl::Event forward = ConvertColour(queue, program, pair[0], inputs[l], layouts[l], layout_channels[l], converted[l], layouts[l], layout_channels[l],
+					width, height, fixed_point);
+				//the inverse is always the float version where there is no fixed-point one
+				cl::Event inverse = ConvertColour(queue, program, pair[1], converted[l], layouts[l], layout_channels[l], restored[l], layouts[l], layout_channels[l],
+					width, height, fixed_point && HasFixedPoint(pair[1]));
+				read_planar(converted[l], l, result);
+				if (l == 0)
+					first = result;
+				layouts_agree = layouts_agree && result == first;
+				read_planar(restored[l], l, result);
+				for (size_t i = 0; i < result.size(); i++)
+					max_error = std::max(max_error, abs((int)result[i] - (int)image.data()[i]));
+				std::cout << std::setw(10) << std::fixed << std::setprecision(0) << GetExecutionTime(forward, PROF_US) << std::setw(10) << GetExecutionTime(inverse, PROF_US);
+			}
+			std::cout << std::setw(12) << max_error << std::setw(10) << (layouts_agree ? "OK" : "FAILED") << std::endl;
+		}
+
+	//single channel gray against rgb2gray, which truncates and writes the value 3 times
+	cl::Buffer dev_gray(context, CL_MEM_READ_WRITE, image_size), dev_gray3(context, CL_MEM_READ_WRITE, image.size());
+	cl::Event gray3_event = FilterBuffer(queue, program, FILTER_GRAY, inputs[0], dev_gray3, width, height, 3, FilterParams());
+	vector<unsigned char> gray3(image_size), gray(image_size);
+	queue.enqueueReadBuffer(dev_gray3, CL_TRUE, 0, image_size, &gray3[0]);
+	for (int fixed_point = 0; fixed_point < 2; fixed_point++) {
+		cl::Event gray_event = ConvertColour(queue, program, COLOUR_RGB_TO_GRAY, inputs[0], LAYOUT_PLANAR, 3, dev_gray, LAYOUT_PLANAR, 1, width, height, fixed_point);
+		queue.enqueueReadBuffer(dev_gray, CL_TRUE, 0, image_size, &gray[0]);
+		int max_diff = 0;
+		for (int i = 0; i < image_size; i++)
+			max_diff = std::max(max_diff, abs((int)gray[i] - (int)gray3[i]));
+		std::cout << "gray (" << (fixed_point ? "fixed" : "float") << ", 1 channel) " << GetExecutionTime(gray_event, PROF_US) << " us, rgb2gray (3 channels) "
+			<< GetExecutionTime(gray3_event, PROF_US) << " us, largest difference " << max_diff << (max_diff <= 1 ? " OK" : " FAILED") << std::endl;
+	}
+
+	//subsampling in the same pass: the luma has to be the one of the 4:4:4 conversion
+	vector<unsigned char> luma(image_size), full(image.size());
+	for (int fixed_point = 0; fixed_point < 2; fixed_point++) {
+		cl::Event full_event = ConvertColour(queue, program, COLOUR_RGB_TO_YCBCR, inputs[1], LAYOUT_INTERLEAVED, 3, converted[0], LAYOUT_PLANAR, 3,
+			width, height, fixed_point);
+		queue.enqueueReadBuffer(converted[0], CL_TRUE, 0, image.size(), &full[0]);
+		for (ChromaSubsampling subsampling : { CHROMA_422, CHROMA_420 }) {
+			YCbCrPlanes planes = CreateYCbCrPlanes(context, width, height, subsampling);
+			cl::Event event = RgbToYCbCrSubsampled(queue, program, inputs[1], LAYOUT_INTERLEAVED, 3, planes, fixed_point);
+			YCbCrSubsampledToRgb(queue, program, planes, restored[0], LAYOUT_PLANAR, 3, fixed_point);
+			queue.enqueueReadBuffer(planes.y, CL_TRUE, 0, image_size, &luma[0]);
+			queue.enqueueReadBuffer(restored[0], CL_TRUE, 0, image.size(), &result[0]);
+			double error = 0;
+			for (size_t i = 0; i < result.size(); i++)
+				error += abs((int)result[i] - (int)image.data()[i]);
+			std::cout << (subsampling == CHROMA_420 ? "4:2:0" : "4:2:2") << " (" << (fixed_point ? "fixed" : "float") << ") from rgb " << GetExecutionTime(event, PROF_US)
+				<< " us against 4:4:4 " << GetExecutionTime(full_event, PROF_US) << " us, " << (size_t)image_size + 2 * planes.chroma_width * planes.chroma_height
+				<< " bytes instead of " << image.size() << ", mean round trip error " << std::setprecision(2) << error / result.size()
+				<< ", luma " << (std::equal(luma.begin(), luma.end(), full.begin()) ? "OK" : "FAILED") << std::setprecision(0) << std::endl;
+		}
+	}
+}
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <cmath>
+#include <functional>
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+
+//a mask_size x mask_size mask (row-major, mask[x + y*mask_size]) split into column[y] * row[x] if it has rank 1
+struct SeparableMask {
+	bool separable;
+	vector<float> row;
+	vector<float> column;
+};
+
+//rank-1 check: take the row and column through the largest entry as the factors and test whether their
+//outer product reproduces every entry within tolerance (relative to the largest entry)
+SeparableMask FactorMask(const vector<float>& mask, int mask_size, float tolerance = 1e-5f) {
+	SeparableMask factors;
+	factors.separable = false;
+
+	int pivot = 0;
+	for (int i = 1; i < mask_size * mask_size; i++)
+		if (fabs(mask[i]) > fabs(mask[pivot]))
+			pivot = i;
+	float largest = mask[pivot];
+	if (largest == 0.0f)
+		return factors;
+
+	int px = pivot % mask_size, py = pivot / mask_size;
+	factors.row.resize(mask_size);
+	factors.column.resize(mask_size);
+	for (int i = 0; i < mask_size; i++) {
+		factors.row[i] = mask[i + py * mask_size];
+		factors.column[i] = mask[px + i * mask_size] / largest;
+	}
+
+	for (int y = 0; y < mask_size; y++)
+		for (int x = 0; x < mask_size; x++)
+			if (fabs(mask[x + y * mask_size] - factors.column[y] * factors.row[x]) > tolerance * fabs(largest))
+				return factors;
+
+	factors.separable = true;
+	return factors;
+}
+
+//everything a convolution needs on the device, so repeated calls do not reallocate
+struct ConvolutionPlan {
+	int mask_size;
+	bool separable;
+	cl::Buffer mask;		//full 2D mask for convolutionND
+	cl::Buffer row, column;		//separable factors
+	cl::Buffer intermediate;	//float output of the horizontal pass
+};
+
+//uploads the mask and decides between the separable and the full 2D path; force_2d disables the separable path
+ConvolutionPlan PlanConvolution(const cl::Context& context, cl::CommandQueue& queue, const vector<float>& mask, int mask_size,
+			int width, int height, int channels, bool force_2d = false) {
+	ConvolutionPlan plan;
+	plan.mask_size = mask_size;
+	plan.mask = cl::Buffer(context, CL_MEM_READ_ONLY, mask.size() * sizeof(float));
+	queue.enqueueWriteBuffer(plan.mask, CL_TRUE, 0, mask.size() * sizeof(float), &mask[0]);
+
+	SeparableMask factors = FactorMask(mask, mask_size);
+	plan.separable = factors.separable && !force_2d;
+	if (plan.separable) {
+		plan.row = cl::Buffer(context, CL_MEM_READ_ONLY, mask_size * sizeof(float));
+		plan.column = cl::Buffer(context, CL_MEM_READ_ONLY, mask_size * sizeof(float));
+		plan.intermediate = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)width * height * channels * sizeof(float));
+		queue.enqueueWriteBuffer(plan.row, CL_TRUE, 0, mask_size * sizeof(float), &factors.row[0]);
+		queue.enqueueWriteBuffer(plan.column, CL_TRUE, 0, mask_size * sizeof(float), &factors.column[0]);
+	}
+	return plan;
+}
+
+//B = A convolved with the planned mask; returns one event per launch (2 for the separable path)
+vector<cl::Event> Convolve(cl::CommandQueue& queue, cl::Program& program, const ConvolutionPlan& plan,
+			const cl::Buffer& A, cl::Buffer& B, int width, int height, int channels) {
+	vector<cl::Event> events;
+	cl::NDRange global(width, height, channels);
+
+	if (!plan.separable) {
+		cl::Kernel kernel(program, "convolutionND");
+		kernel.setArg(0, A);
+		kernel.setArg(1, B);
+		kernel.setArg(2, plan.mask);
+		kernel.setArg(3, plan.mask_size);
+		events.push_back(cl::Event());
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NullRange, NULL, &events.back());
+		return events;
+	}
+
+	cl::Kernel rows(program, "convolution_rows");
+	rows.setArg(0, A);
+	rows.setArg(1, plan.intermediate);
+	rows.setArg(2, plan.row);
+	rows.setArg(3, plan.mask_size);
+
+	cl::Kernel columns(program, "convolution_columns");
+	columns.setArg(0, plan.intermediate);
+	columns.setArg(1, B);
+	columns.setArg(2, plan.column);
+	columns.setArg(3, plan.mask_size);
+
+	events.resize(2);
+	queue.enqueueNDRangeKernel(rows, cl::NullRange, global, cl::NullRange, NULL, &events[0]);
+	queue.enqueueNDRangeKernel(columns, cl::NullRange, global, cl::NullRange, NULL, &events[1]);
+	return events;
+}
+
+//total device time of a list of launches
+double GetExecutionTime(const vector<cl::Event>& events, ProfilingResolution resolution = PROF_NS) {
+	double time = 0;
+	for (const cl::Event& evnt : events)
+		time += GetExecutionTime(evnt, resolution);
+	return time;
+}
+
+//normalised 2D Gaussian built as the outer product of a 1D Gaussian, sigma = mask_size/6 covers +-3 sigma
+vector<float> GaussianMask(int mask_size) {
+	float sigma = mask_size / 6.0f;
+	vector<float> line(mask_size), mask(mask_size * mask_size);
+	float sum = 0;
+	for (int i = 0; i < mask_size; i++) {
+		float d = i - mask_size / 2;
+		line[i] = exp(-d * d / (2 * sigma * sigma));
+		sum += line[i];
+	}
+	for (int y = 0; y < mask_size; y++)
+		for (int x = 0; x < mask_size; x++)
+			mask[x + y * mask_size] = line[x] * line[y] / (sum * sum);
+	return mask;
+}
+
+vector<float> BoxMask(int mask_size) {
+	return vector<float>(mask_size * mask_size, 1.0f / (mask_size * mask_size));
+}
+
+//a disc is not separable, so it exercises the 2D fallback
+vector<float> DiscMask(int mask_size) {
+	int r = mask_size / 2, count = 0;
+	vector<float> mask(mask_size * mask_size, 0.0f);
+	for (int y = -r; y <= r; y++)
+		for (int x = -r; x <= r; x++)
+			if (x * x + y * y <= r * r) {
+				mask[(x + r) + (y + r) * mask_size] = 1.0f;
+				count++;
+			}
+	for (float& m : mask)
+		m /= count;
+	return mask;
+}
+
+//times the full 2D and the separable path for mask sizes 3 to 31 on one image and reports where separable wins
+void BenchmarkConvolutionImage(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program,
+			const string& name, const vector<unsigned char>& image, int width, int height, int channels) {
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image.size());
+	cl::Buffer dev_2d(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_separable(context, CL_MEM_READ_WRITE, image.size());
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image.size(), &image[0]);
+	vector<unsigned char> result_2d(image.size()), result_separable(image.size());
+
+	std::cout << name << " (" << width << "x" << height << "x" << channels << ")" << std::endl;
+	std::cout << std::setw(8) << "mask" << std::setw(12) << "type" << std::setw(12) << "auto" << std::setw(14) << "2D [us]"
+		<< std::setw(16) << "separable [us]" << std::setw(10) << "speedup" << std::setw(10) << "max diff" << std::endl;
+
+	int crossover = 0;
+	for (int mask_size = 3; mask_size <= 31; mask_size += 2) {
+		vector<float> mask = GaussianMask(mask_size);
+
+		ConvolutionPlan full = PlanConvolution(context, queue, mask, mask_size, width, height, channels, true);
+		ConvolutionPlan separable = PlanConvolution(context, queue, mask, mask_size, width, height, channels);
+
+		vector<cl::Event> events_2d = Convolve(queue, program, full, dev_input, dev_2d, width, height, channels);
+		vector<cl::Event> events_separable = Convolve(queue, program, separable, dev_input, dev_separable, width, height, channels);
+		queue.finish();
+		double time_2d = GetExecutionTime(events_2d, PROF_US);
+		double time_separable = GetExecutionTime(events_separable, PROF_US);
+
+		queue.enqueueReadBuffer(dev_2d, CL_TRUE, 0, image.size(), &result_2d[0]);
+		queue.enqueueReadBuffer(dev_separable, CL_TRUE, 0, image.size(), &result_separable[0]);
+		int max_diff = 0;
+		for (size_t i = 0; i < image.size(); i++)
+			max_diff = std::max(max_diff, abs((int)result_2d[i] - (int)result_separable[i]));
+
+		if (!crossover && time_separable < time_2d)
+			crossover = mask_size;
+
+		std::cout << std::setw(8) << mask_size << std::setw(12) << "gaussian" << std::setw(12) << (separable.separable ? "separable" : "2D")
+			<< std::setw(14) << std::fixed << std::setprecision(0) << time_2d << std::setw(16) << time_separable
+			<< std::setw(10) << std::setprecision(2) << time_2d / time_separable << std::setw(10) << max_diff << std::endl;
+	}
+
+	//the detection has to reject non-separable masks
+	for (int mask_size : { 3, 15 }) {
+		ConvolutionPlan disc = PlanConvolution(context, queue, DiscMask(mask_size), mask_size, width, height, channels);
+		ConvolutionPlan box = PlanConvolution(context, queue, BoxMask(mask_size), mask_size, width, height, channels);
+		std::cout << std::setw(8) << mask_size << std::setw(12) << "disc" << std::setw(12) << (disc.separable ? "separable" : "2D") << std::endl;
+		std::cout << std::setw(8) << mask_size << std::setw(12) << "box" << std::setw(12) << (box.separable ? "separable" : "2D") << std::endl;
+	}
+
+	if (crossover)
+		std::cout << "separable is faster from mask size " << crossover << std::endl << std::endl;
+	else
+		std::cout << "separable is never faster" << std::endl << std::endl;
+}
+
+//the input image and synthetic images that fit into a single device allocation
+void BenchmarkConvolution(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	BenchmarkConvolutionImage(context, queue, program, "input image", vector<unsigned char>(image.data(), image.data() + image.size()),
+		image.width(), image.height(), image.spectrum());
+
+	cl_ulong max_alloc = context.getInfo<CL_CONTEXT_DEVICES>()[0].getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+	for (int size : { 4096, 8192 }) {
+		//the float intermediate is the largest buffer
+		if ((cl_ulong)size * size * 3 * sizeof(float) > max_alloc)
+			continue;
+		vector<unsigned char> synthetic((size_t)size * size * 3);
+		for (size_t i = 0; i < synthetic.size(); i++)
+			synthetic[i] = (unsigned char)rand();
+		BenchmarkConvolutionImage(context, queue, program, "synthetic", synthetic, size, size, 3);
+	}
+}
+
+//work-group shape of the tiled kernels: tx x ty work-items, each computing all channels of ppt pixels
+struct TileConfig {
+	int tx, ty, ppt;
+};
+
+//local memory of the tiled kernels in bytes
+size_t TileBytes(const TileConfig& config, int offset, int channels) {
+	return (size_t)(config.tx + 2 * offset) * (config.ty * config.ppt + 2 * offset) * channels;
+}
+
+//false if the work-group or its tile does not fit on the device
+bool TileFits(const cl::Device& device, const TileConfig& config, int offset, int channels) {
+	return (size_t)(config.tx * config.ty) <= device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() &&
+		TileBytes(config, offset, channels) <= device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+}
+
+cl::Event EnqueueTiled(cl::CommandQueue& queue, cl::Kernel& kernel, const TileConfig& config, int width, int height) {
+	int rows = config.ty * config.ppt;
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange,
+		cl::NDRange((width + config.tx - 1) / config.tx * config.tx, (height + rows - 1) / rows * config.ty),
+		cl::NDRange(config.tx, config.ty), NULL, &prof_event);
+	return prof_event;
+}
+
+//convolutionND with the input staged in local memory, mask holds mask_size^2 floats
+cl::Event ConvolveTiled(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B, const cl::Buffer& mask,
+			int mask_size, int width, int height, int channels, const TileConfig& config) {
+	cl::Kernel kernel(program, "convolution_tiled");
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, mask);
+	kernel.setArg(3, mask_size);
+	kernel.setArg(4, width);
+	kernel.setArg(5, height);
+	kernel.setArg(6, channels);
+	kernel.setArg(7, config.ppt);
+	kernel.setArg(8, cl::Local(TileBytes(config, mask_size / 2, channels)));
+	return EnqueueTiled(queue, kernel, config, width, height);
+}
+
+//average over a (2*range+1)^2 window with the input staged in local memory
+cl::Event AverageFilterTiled(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B,
+			int range, int width, int height, int channels, const TileConfig& config) {
+	cl::Kernel kernel(program, "avg_filter_tiled");
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, range);
+	kernel.setArg(3, width);
+	kernel.setArg(4, height);
+	kernel.setArg(5, channels);
+	kernel.setArg(6, config.ppt);
+	kernel.setArg(7, cl::Local(TileBytes(config, range, channels)));
+	return EnqueueTiled(queue, kernel, config, width, height);
+}
+
+//times the tiled kernels for several tile shapes against convolutionND and avg_filterND, whose outputs they must reproduce exactly
+void BenchmarkTiled(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+	TileConfig configs[] = { { 8, 8, 1 }, { 16, 16, 1 }, { 32, 8, 1 }, { 16, 16, 2 }, { 16, 16, 4 }, { 32, 4, 4 }, { 32, 8, 4 } };
+
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image.size());
+	cl::Buffer dev_reference(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_tiled(context, CL_MEM_READ_WRITE, image.size());
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image.size(), image.data());
+	vector<unsigned char> reference(image.size()), tiled(image.size());
+
+	std::cout << "Tiled filters on a " << width << "x" << height << "x" << channels << " image" << std::endl;
+	std::cout << std::setw(22) << std::left << "filter" << std::right << std::setw(14) << "tile" << std::setw(14) << "time [us]"
+		<< std::setw(10) << "speedup" << std::setw(8) << "check" << std::endl;
+
+	//the untiled kernel as the reference, then every tile shape that fits
+	auto run = [&](const string& name, int offset, cl::Event reference_event, std::function<cl::Event(const TileConfig&)> launch) {
+		queue.enqueueReadBuffer(dev_reference, CL_TRUE, 0, image.size(), &reference[0]);
+		double reference_time = GetExecutionTime(reference_event, PROF_US);
+		std::cout << std::setw(22) << std::left << name << std::right << std::setw(14) << "untiled" << std::setw(14) << std::fixed
+			<< std::setprecision(0) << reference_time << std::setw(10) << "1.00" << std::setw(8) << "-" << std::endl;
+
+		for (const TileConfig& config : configs) {
+			if (!TileFits(device, config, offset, channels))
+				continue;
+			cl::Event prof_event = launch(config);
+			queue.enqueueReadBuffer(dev_tiled, CL_TRUE, 0, image.size(), &tiled[0]);
+			double time = GetExecutionTime(prof_event, PROF_US);
+			string shape = std::to_string(config.tx) + "x" + std::to_string(config.ty) + "x" + std::to_string(config.ppt);
+			std::cout << std::setw(22) << std::left << name << std::right << std::setw(14) << shape << std::setw(14) << std::setprecision(0) << time
+				<< std::setw(10) << std::setprecision(2) << reference_time / time << std::setw(8) << (tiled == reference ? "OK" : "FAILED") << std::endl;
+		}
+	};
+
+	for (int mask_size : { 3, 5, 9, 15 }) {
+		vector<float> mask = DiscMask(mask_size);
+		ConvolutionPlan plan = PlanConvolution(context, queue, mask, mask_size, width, height, channels, true);
+		cl::Event reference_event = Convolve(queue, program, plan, dev_input, dev_reference, width, height, channels)[0];
+		run("convolution " + std::to_string(mask_size) + "x" + std::to_string(mask_size), mask_size / 2, reference_event,
+			[&](const TileConfig& config) { return ConvolveTiled(queue, program, dev_input, dev_tiled, plan.mask, mask_size, width, height, channels, config); });
+	}
+
+	for (int range : { 2, 4 }) {
+		cl::Kernel kernel(program, "avg_filterND");
+		kernel.setArg(0, dev_input);
+		kernel.setArg(1, dev_reference);
+		kernel.setArg(2, range);
+		cl::Event reference_event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &reference_event);
+		run("average " + std::to_string(2 * range + 1) + "x" + std::to_string(2 * range + 1), range, reference_event,
+			[&](const TileConfig& config) { return AverageFilterTiled(queue, program, dev_input, dev_tiled, range, width, height, channels, config); });
+	}
+}
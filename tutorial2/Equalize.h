@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+
+//contrast enhancement on the device (kernels/equalize.cl): histogram -> CDF by a scan -> remapping table ->
+//applied to the image, with nothing read back in between; CLAHE does the same per tile with clipped histograms
+//and blends the tables of neighbouring tiles
+
+const int EQUALIZE_LOCAL_SIZE = 256;
+
+//global histogram of every channel (256 uint per channel) with local histograms of groups work-groups
+cl::Event ImageHistogram(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& histogram,
+			size_t plane_size, int channels, int groups = 64) {
+	queue.enqueueFillBuffer(histogram, (cl_uint)0, 0, 256 * channels * sizeof(cl_uint));
+	cl::Kernel kernel(program, "histogram_local");
+	kernel.setArg(0, A);
+	kernel.setArg(1, histogram);
+	kernel.setArg(2, (int)plane_size);
+	kernel.setArg(3, cl::Local(256 * sizeof(cl_uint)));
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(groups * EQUALIZE_LOCAL_SIZE, channels), cl::NDRange(EQUALIZE_LOCAL_SIZE, 1), NULL, &prof_event);
+	return prof_event;
+}
+
+//equalises every channel of A into B; histogram and luts hold 256 uint and 256 uchar per channel
+//the events are the histogram, the table and the remapping
+vector<cl::Event> EqualizeHistogram(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B,
+			cl::Buffer& histogram, cl::Buffer& luts, size_t plane_size, int channels) {
+	vector<cl::Event> events(3);
+	events[0] = ImageHistogram(queue, program, A, histogram, plane_size, channels);
+
+	cl::Kernel lut(program, "equalize_lut");
+	lut.setArg(0, histogram);
+	lut.setArg(1, luts);
+	lut.setArg(2, cl::Local(256 * sizeof(cl_uint)));
+	lut.setArg(3, cl::Local(256 * sizeof(cl_uint)));
+	queue.enqueueNDRangeKernel(lut, cl::NullRange, cl::NDRange(256 * channels), cl::NDRange(256), NULL, &events[1]);
+
+	cl::Kernel apply(program, "equalize_apply");
+	apply.setArg(0, A);
+	apply.setArg(1, B);
+	apply.setArg(2, luts);
+	queue.enqueueNDRangeKernel(apply, cl::NullRange, cl::NDRange(plane_size, channels), cl::NullRange, NULL, &events[2]);
+	return events;
+}
+
+//tile grid and contrast limit of CLAHE, clip_limit is in multiples of the mean bin count of a tile
+struct ClaheConfig {
+	int tiles_x = 8, tiles_y = 8;
+	float clip_limit = 4.0f;
+};
+
+//bytes of the tile histograms (uint) and tables (uchar)
+size_t ClaheHistogramBytes(const ClaheConfig& config, int channels) {
+	return (size_t)config.tiles_x * config.tiles_y * channels * 256 * sizeof(cl_uint);
+}
+
+size_t ClaheLutBytes(const ClaheConfig& config, int channels) {
+	return (size_t)config.tiles_x * config.tiles_y * channels * 256;
+}
+
+//contrast-limited adaptive histogram equalisation of every channel of A into B
+//the events are the tile histograms, the clipped tables and the blended remapping
+vector<cl::Event> Clahe(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B, cl::Buffer& histograms, cl::Buffer& luts,
+			int width, int height, int channels, const ClaheConfig& config) {
+	vector<cl::Event> events(3);
+
+	cl::Kernel hist(program, "clahe_histograms");
+	hist.setArg(0, A);
+	hist.setArg(1, histograms);
+	hist.setArg(2, width);
+	hist.setArg(3, height);
+	hist.setArg(4, cl::Local(256 * sizeof(cl_uint)));
+	queue.enqueueNDRangeKernel(hist, cl::NullRange, cl::NDRange(config.tiles_x * EQUALIZE_LOCAL_SIZE, config.tiles_y, channels),
+		cl::NDRange(EQUALIZE_LOCAL_SIZE, 1, 1), NULL, &events[0]);
+
+	cl::Kernel lut(program, "clahe_luts");
+	lut.setArg(0, histograms);
+	lut.setArg(1, luts);
+	lut.setArg(2, config.clip_limit);
+	lut.setArg(3, cl::Local(256 * sizeof(cl_uint)));
+	lut.setArg(4, cl::Local(256 * sizeof(cl_uint)));
+	queue.enqueueNDRangeKernel(lut, cl::NullRange, cl::NDRange(256 * config.tiles_x * config.tiles_y * channels), cl::NDRange(256), NULL, &events[1]);
+
+	cl::Kernel apply(program, "clahe_apply");
+	apply.setArg(0, A);
+	apply.setArg(1, B);
+	apply.setArg(2, luts);
+	apply.setArg(3, config.tiles_x);
+	apply.setArg(4, config.tiles_y);
+	queue.enqueueNDRangeKernel(apply, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &events[2]);
+	return events;
+}
+
+//host CLAHE with the same integer tables, for the check (the blend may round differently by 1)
+vector<unsigned char> ClaheHost(const cimg_library::CImg<unsigned char>& image, const ClaheConfig& config) {
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	int tile_width = (width + config.tiles_x - 1) / config.tiles_x, tile_height = (height + config.tiles_y - 1) / config.tiles_y;
+	vector<unsigned char> luts(ClaheLutBytes(config, channels)), output(image.size());
+
+	for (int c = 0; c < channels; c++)
+		for (int ty = 0; ty < config.tiles_y; ty++)
+			for (int tx = 0; tx < config.tiles_x; tx++) {
+				vector<cl_uint> hist(256, 0);
+				for (int y = ty * tile_height; y < std::min((ty + 1) * tile_height, height); y++)
+					for (int x = tx * tile_width; x < std::min((tx + 1) * tile_width, width); x++)
+						hist[image(x, y, 0, c)]++;
+				cl_uint pixels = 0, excess = 0;
+				for (cl_uint count : hist)
+					pixels += count;
+				cl_uint clip = std::max((cl_uint)(config.clip_limit * pixels / 256), (cl_uint)1);
+				for (cl_uint count : hist)
+					excess += count > clip ? count - clip : 0;
+				cl_ulong cdf = 0, total = std::max(pixels, (cl_uint)1);
+				unsigned char* lut = &luts[((tx + ty * config.tiles_x) + c * config.tiles_x * config.tiles_y) * 256];
+				for (cl_uint i = 0; i < 256; i++) {
+					cdf += std::min(hist[i], clip) + excess / 256 + (i < excess % 256 ? 1 : 0);
+					lut[i] = (unsigned char)((cdf * 255 + total / 2) / total);
+				}
+			}
+
+	for (int c = 0; c < channels; c++)
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++) {
+				unsigned char value = image(x, y, 0, c);
+				float fx = (x + 0.5f) / tile_width - 0.5f, fy = (y + 0.5f) / tile_height - 0.5f;
+				int tx0 = std::min(std::max((int)std::floor(fx), 0), config.tiles_x - 1), ty0 = std::min(std::max((int)std::floor(fy), 0), config.tiles_y - 1);
+				int tx1 = std::min(tx0 + 1, config.tiles_x - 1), ty1 = std::min(ty0 + 1, config.tiles_y - 1);
+				float ax = std::min(std::max(fx - tx0, 0.0f), 1.0f), ay = std::min(std::max(fy - ty0, 0.0f), 1.0f);
+				const unsigned char* plane_luts = &luts[c * config.tiles_x * config.tiles_y * 256];
+				float v00 = plane_luts[(tx0 + ty0 * config.tiles_x) * 256 + value], v10 = plane_luts[(tx1 + ty0 * config.tiles_x) * 256 + value];
+				float v01 = plane_luts[(tx0 + ty1 * config.tiles_x) * 256 + value], v11 = plane_luts[(tx1 + ty1 * config.tiles_x) * 256 + value];
+				float top = v00 + ax * (v10 - v00), bottom = v01 + ax * (v11 - v01);
+				output[x + y * width + c * width * height] = (unsigned char)std::lrint(std::min(std::max(top + ay * (bottom - top), 0.0f), 255.0f));
+			}
+	return output;
+}
+
+//equalisation and CLAHE on the input image and on a tiled copy of at least 16 megapixels, checked against
+//the host, with the throughput of every step
+void BenchmarkEqualize(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int repeat = (int)std::ceil(std::sqrt(16e6 / ((double)image.width() * image.height())));
+	cimg_library::CImg<unsigned char> large(image.width() * repeat, image.height() * repeat, 1, image.spectrum());
+	for (int j = 0; j < repeat; j++)
+		for (int i = 0; i < repeat; i++)
+			large.draw_image(i * image.width(), j * image.height(), image);
+
+	ClaheConfig config;
+	std::cout << "Histogram equalisation and CLAHE (" << config.tiles_x << "x" << config.tiles_y << " tiles, clip limit "
+		<< config.clip_limit << ")" << std::endl;
+	std::cout << std::setw(14) << "image" << std::setw(14) << "step" << std::setw(14) << "time [us]" << std::setw(14) << "MPixel/s" << std::setw(8) << "check" << std::endl;
+
+	const cimg_library::CImg<unsigned char>* inputs[] = { &image, &large };
+	for (const cimg_library::CImg<unsigned char>* input : inputs) {
+		int width = input->width(), height = input->height(), channels = input->spectrum();
+		size_t plane_size = (size_t)width * height;
+		cl::Buffer dev_input(context, CL_MEM_READ_ONLY, input->size());
+		cl::Buffer dev_output(context, CL_MEM_READ_WRITE, input->size());
+		cl::Buffer dev_histogram(context, CL_MEM_READ_WRITE, std::max(ClaheHistogramBytes(config, channels), 256 * channels * sizeof(cl_uint)));
+		cl::Buffer dev_luts(context, CL_MEM_READ_WRITE, ClaheLutBytes(config, channels));
+		queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, input->size(), input->data());
+		vector<unsigned char> output(input->size());
+		string name = std::to_string(width) + "x" + std::to_string(height);
+
+		auto report = [&](const string& step, double us, const char* check) {
+			std::cout << std::setw(14) << name << std::setw(14) << step << std::setw(14) << std::fixed << std::setprecision(0) << us
+				<< std::setw(14) << std::setprecision(1) << plane_size / us << std::setw(8) << check << std::endl;
+		};
+
+		//global equalisation against a histogram and tables computed on the host
+		vector<cl::Event> events = EqualizeHistogram(queue, program, dev_input, dev_output, dev_histogram, dev_luts, plane_size, channels);
+		vector<cl_uint> histogram(256 * channels);
+		queue.enqueueReadBuffer(dev_histogram, CL_TRUE, 0, histogram.size() * sizeof(cl_uint), &histogram[0]);
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, output.size(), &output[0]);
+
+		vector<cl_uint> expected(256 * channels, 0);
+		for (int c = 0; c < channels; c++)
+			for (size_t i = 0; i < plane_size; i++)
+				expected[input->data()[i + c * plane_size] + c * 256]++;
+		bool equalized = true;
+		for (int c = 0; c < channels; c++) {
+			cl_ulong cdf = 0, cdf_min = 0;
+			unsigned char lut[256];
+			for (int i = 0; i < 256; i++) {
+				cdf += expected[i + c * 256];
+				if (!cdf_min && cdf)
+					cdf_min = cdf;
+				cl_ulong range = std::max(plane_size - cdf_min, (cl_ulong)1);
+				lut[i] = (unsigned char)(((cdf > cdf_min ? cdf - cdf_min : 0) * 255 + range / 2) / range);
+			}
+			for (size_t i = 0; i < plane_size; i++)
+				equalized = equalized && output[i + c * plane_size] == lut[input->data()[i + c * plane_size]];
+		}
+
+		report("histogram", GetExecutionTime(events[0], PROF_US), histogram == expected ? "OK" : "FAILED");
+		report("CDF + table", GetExecutionTime(events[1], PROF_US), "-");
+		report("remap", GetExecutionTime(events[2], PROF_US), "-");
+		report("equalise", GetExecutionTime(events, PROF_US), equalized ? "OK" : "FAILED");
+
+		//CLAHE against the host, the blended values may round differently by 1
+		events = Clahe(queue, program, dev_input, dev_output, dev_histogram, dev_luts, width, height, channels, config);
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, output.size(), &output[0]);
+		vector<unsigned char> clahe = ClaheHost(*input, config);
+		bool check = true;
+		for (size_t i = 0; i < output.size(); i++)
+			check = check && std::abs(output[i] - clahe[i]) <= 1;
+		report("CLAHE", GetExecutionTime(events, PROF_US), check ? "OK" : "FAILED");
+	}
+}
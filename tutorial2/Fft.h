@@ -0,0 +1,444 @@
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+
+//fast Fourier transforms (kernels/fft.cl) and convolution in the frequency domain, whose cost does not grow
+//with the mask size: convolutionND does mask_size^2 multiplications per pixel, the FFT path a fixed number
+//of transforms; large images are processed in overlapping tiles (overlap-save) so memory stays bounded
+
+//a transform of n complex values, n a power of two
+struct FftPlan {
+	int n;
+	int max_radix;
+	bool local;		//all passes in one launch, in local memory
+	int local_size;
+	vector<int> radices;	//of the passes of the multi-pass version
+};
+
+//radices up to max_radix (8, 4 or 2); the local memory version needs room for two copies of the transform and
+//contiguous values, column transforms use the multi-pass version in which neighbouring work-items read
+//neighbouring columns
+FftPlan PlanFft(const cl::Device& device, int n, bool contiguous, int max_radix = 8, bool allow_local = true) {
+	if (n < 2 || (n & (n - 1)))
+		throw cl::Error(CL_INVALID_VALUE, "PlanFft: the size has to be a power of two");
+	FftPlan plan;
+	plan.n = n;
+	plan.max_radix = max_radix;
+	for (int left = n; left > 1; left /= plan.radices.back()) {
+		int radix = max_radix;
+		while (left % radix)
+			radix /= 2;
+		plan.radices.push_back(radix);
+	}
+	plan.local_size = (int)std::min((size_t)std::min(n / 2, 256), device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>());
+	plan.local = allow_local && contiguous && 2 * n * sizeof(cl_float2) <= device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+	return plan;
+}
+
+//how a batch of transforms lies in memory (see kernels/fft.cl): element i of transform b is at
+//(b % inner)*inner_stride + (b / inner)*outer_stride + i*stride
+cl_int4 FftBatch(int stride, int inner, int inner_stride, int outer_stride) {
+	cl_int4 batch;
+	batch.s[0] = stride;
+	batch.s[1] = inner;
+	batch.s[2] = inner_stride;
+	batch.s[3] = outer_stride;
+	return batch;
+}
+
+//count transforms of data (direction -1 forward, +1 inverse, not normalised), temp has the size of data;
+//returns the buffer holding the result, which is data or temp depending on the number of passes
+cl::Buffer EnqueueFft(cl::CommandQueue& queue, cl::Program& program, const FftPlan& plan, cl::Buffer& data, cl::Buffer& temp,
+			int count, cl_int4 batch, float direction, vector<cl::Event>& events) {
+	if (plan.local) {
+		cl::Kernel kernel(program, "fft_local");
+		kernel.setArg(0, data);
+		kernel.setArg(1, temp);
+		kernel.setArg(2, plan.n);
+		kernel.setArg(3, direction);
+		kernel.setArg(4, plan.max_radix);
+		kernel.setArg(5, batch);
+		kernel.setArg(6, cl::Local(plan.n * sizeof(cl_float2)));
+		kernel.setArg(7, cl::Local(plan.n * sizeof(cl_float2)));
+		events.push_back(cl::Event());
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(plan.local_size, count), cl::NDRange(plan.local_size, 1), NULL, &events.back());
+		return temp;
+	}
+
+	cl::Buffer X = data, Y = temp;
+	bool columns = batch.s[0] != 1;
+	int ns = 1;
+	for (int radix : plan.radices) {
+		cl::Kernel kernel(program, "fft_pass");
+		kernel.setArg(0, X);
+		kernel.setArg(1, Y);
+		kernel.setArg(2, plan.n);
+		kernel.setArg(3, ns);
+		kernel.setArg(4, radix);
+		kernel.setArg(5, direction);
+		kernel.setArg(6, batch);
+		events.push_back(cl::Event());
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, columns ? cl::NDRange(count, plan.n / radix) : cl::NDRange(plan.n / radix, count),
+			cl::NullRange, NULL, &events.back());
+		std::swap(X, Y);
+		ns *= radix;
+	}
+	return X;
+}
+
+//everything an FFT convolution needs on the device: the transforms work on tiles of fw x fh values, each
+//giving a block of (fw - 2*offset) x (fh - 2*offset) output pixels; a strip of tiles_x tiles of every channel
+//is transformed at once
+struct FftConvolution {
+	int width, height, channels, offset;
+	int fw, fh;
+	int block_width, block_height;
+	int tiles_x, tiles_y;
+	FftPlan rows, columns;			//rows of fw/2 complex values, columns of fh
+	cl::Buffer real, real_temp;		//fw x fh real values per tile
+	cl::Buffer spectrum, spectrum_temp;	//(fw/2 + 1) x fh complex values per tile
+	cl::Buffer mask_spectrum;
+};
+
+//spectra of all tiles above which the image is processed in tiles rather than as a whole
+const size_t FFT_WHOLE_IMAGE_BYTES = 256 << 20;
+
+int NextPowerOfTwo(int value) {
+	int power = 1;
+	while (power < value)
+		power *= 2;
+	return power;
+}
+
+//real tiles in plan.real to their spectra: complex transforms of the rows as (even, odd) pairs, separated into
+//half spectra, then the columns; returns the buffer holding the spectra
+cl::Buffer ForwardFft2D(cl::CommandQueue& queue, cl::Program& program, FftConvolution& plan, int stacks, vector<cl::Event>& events) {
+	int h = plan.fw / 2;
+	cl::Buffer rows = EnqueueFft(queue, program, plan.rows, plan.real, plan.real_temp, stacks * plan.fh, FftBatch(1, stacks * plan.fh, h, 0), -1.0f, events);
+
+	cl::Kernel post(program, "fft_r2c_post");
+	post.setArg(0, rows);
+	post.setArg(1, plan.spectrum);
+	post.setArg(2, plan.fw);
+	events.push_back(cl::Event());
+	queue.enqueueNDRangeKernel(post, cl::NullRange, cl::NDRange(h + 1, stacks * plan.fh), cl::NullRange, NULL, &events.back());
+
+	return EnqueueFft(queue, program, plan.columns, plan.spectrum, plan.spectrum_temp, stacks * (h + 1), FftBatch(h + 1, h + 1, 1, (h + 1) * plan.fh),
+		-1.0f, events);
+}
+
+//the spectra back to real tiles scaled by fw*fh/2; returns the buffer holding the real values
+cl::Buffer InverseFft2D(cl::CommandQueue& queue, cl::Program& program, FftConvolution& plan, cl::Buffer spectra, int stacks, vector<cl::Event>& events) {
+	int h = plan.fw / 2;
+	cl::Buffer other = spectra() == plan.spectrum() ? plan.spectrum_temp : plan.spectrum;
+	cl::Buffer columns = EnqueueFft(queue, program, plan.columns, spectra, other, stacks * (h + 1), FftBatch(h + 1, h + 1, 1, (h + 1) * plan.fh),
+		1.0f, events);
+
+	cl::Kernel pre(program, "fft_c2r_pre");
+	pre.setArg(0, columns);
+	pre.setArg(1, plan.real);
+	pre.setArg(2, plan.fw);
+	events.push_back(cl::Event());
+	queue.enqueueNDRangeKernel(pre, cl::NullRange, cl::NDRange(h, stacks * plan.fh), cl::NullRange, NULL, &events.back());
+
+	return EnqueueFft(queue, program, plan.rows, plan.real, plan.real_temp, stacks * plan.fh, FftBatch(1, stacks * plan.fh, h, 0), 1.0f, events);
+}
+
+//plans the convolution of width x height x channels images with the mask; tile = 0 transforms the whole image
+//at once if the padding at most doubles its area and its spectra fit into FFT_WHOLE_IMAGE_BYTES and a single
+//allocation, otherwise (or with a given tile) the image is processed in tiles of tile x tile values
+FftConvolution PlanFftConvolution(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const vector<float>& mask, int mask_size,
+			int width, int height, int channels, int tile = 0) {
+	cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+	FftConvolution plan;
+	plan.width = width;
+	plan.height = height;
+	plan.channels = channels;
+	plan.offset = mask_size / 2;
+
+	if (!tile) {
+		plan.fw = std::max(NextPowerOfTwo(width + 2 * plan.offset), 4);
+		plan.fh = std::max(NextPowerOfTwo(height + 2 * plan.offset), 2);
+		size_t bytes = (size_t)channels * plan.fh * (plan.fw / 2 + 1) * sizeof(cl_float2);
+		//padding a power-of-two image by the mask doubles each side, tiles then transform far less
+		bool wasteful = (double)plan.fw * plan.fh > 2.0 * width * height;
+		if (wasteful || bytes > FFT_WHOLE_IMAGE_BYTES || bytes > device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>())
+			tile = std::max(512, NextPowerOfTwo(4 * mask_size));
+	}
+	if (tile) {
+		if (tile < 4 || (tile & (tile - 1)) || tile <= 2 * plan.offset)
+			throw cl::Error(CL_INVALID_VALUE, "PlanFftConvolution: the tile has to be a power of two larger than the mask");
+		plan.fw = plan.fh = tile;
+	}
+	plan.block_width = plan.fw - 2 * plan.offset;
+	plan.block_height = plan.fh - 2 * plan.offset;
+	plan.tiles_x = (width + plan.block_width - 1) / plan.block_width;
+	plan.tiles_y = (height + plan.block_height - 1) / plan.block_height;
+
+	int stacks = channels * plan.tiles_x, h = plan.fw / 2;
+	plan.rows = PlanFft(device, h, true);
+	plan.columns = PlanFft(device, plan.fh, false);
+	plan.real = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)stacks * plan.fw * plan.fh * sizeof(float));
+	plan.real_temp = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)stacks * plan.fw * plan.fh * sizeof(float));
+	plan.spectrum = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)stacks * (h + 1) * plan.fh * sizeof(cl_float2));
+	plan.spectrum_temp = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)stacks * (h + 1) * plan.fh * sizeof(cl_float2));
+	plan.mask_spectrum = cl::Buffer(context, CL_MEM_READ_ONLY, (size_t)(h + 1) * plan.fh * sizeof(cl_float2));
+
+	//the mask mirrored around the origin of a tile (wrapping around), so that the product of the spectra
+	//correlates the image with the mask like convolutionND does
+	vector<float> tile_mask((size_t)plan.fw * plan.fh, 0.0f);
+	for (int j = 0; j < mask_size; j++)
+		for (int i = 0; i < mask_size; i++)
+			tile_mask[(plan.fw - (i - plan.offset)) % plan.fw + ((plan.fh - (j - plan.offset)) % plan.fh) * plan.fw] = mask[i + j * mask_size];
+	queue.enqueueWriteBuffer(plan.real, CL_TRUE, 0, tile_mask.size() * sizeof(float), &tile_mask[0]);
+	vector<cl::Event> events;
+	cl::Buffer spectrum = ForwardFft2D(queue, program, plan, 1, events);
+	queue.enqueueCopyBuffer(spectrum, plan.mask_spectrum, 0, 0, (size_t)(h + 1) * plan.fh * sizeof(cl_float2));
+	queue.finish();
+	return plan;
+}
+
+//B = A convolved with the planned mask, pixels outside the image count as 0; returns the events of all launches
+vector<cl::Event> ConvolveFft(cl::CommandQueue& queue, cl::Program& program, FftConvolution& plan, const cl::Buffer& A, cl::Buffer& B) {
+	vector<cl::Event> events;
+	int stacks = plan.channels * plan.tiles_x, h = plan.fw / 2;
+	//the inverse row transforms of half length leave the values scaled by fw/2, the columns by fh
+	float scale = 2.0f / ((float)plan.fw * plan.fh);
+
+	for (int ty = 0; ty < plan.tiles_y; ty++) {
+		int y0 = ty * plan.block_height;
+		cl::Kernel load(program, "fft_load_tiles");
+		load.setArg(0, A);
+		load.setArg(1, plan.real);
+		load.setArg(2, plan.width);
+		load.setArg(3, plan.height);
+		load.setArg(4, plan.block_width);
+		load.setArg(5, y0);
+		load.setArg(6, plan.offset);
+		load.setArg(7, plan.tiles_x);
+		events.push_back(cl::Event());
+		queue.enqueueNDRangeKernel(load, cl::NullRange, cl::NDRange(plan.fw, plan.fh, stacks), cl::NullRange, NULL, &events.back());
+
+		cl::Buffer spectra = ForwardFft2D(queue, program, plan, stacks, events);
+
+		cl::Kernel multiply(program, "fft_multiply");
+		multiply.setArg(0, spectra);
+		multiply.setArg(1, plan.mask_spectrum);
+		multiply.setArg(2, scale);
+		events.push_back(cl::Event());
+		queue.enqueueNDRangeKernel(multiply, cl::NullRange, cl::NDRange((h + 1) * plan.fh, stacks), cl::NullRange, NULL, &events.back());
+
+		cl::Buffer result = InverseFft2D(queue, program, plan, spectra, stacks, events);
+
+		cl::Kernel store(program, "fft_store_tiles");
+		store.setArg(0, result);
+		store.setArg(1, B);
+		store.setArg(2, plan.width);
+		store.setArg(3, plan.height);
+		store.setArg(4, plan.fw);
+		store.setArg(5, plan.fh);
+		store.setArg(6, y0);
+		store.setArg(7, plan.offset);
+		store.setArg(8, plan.tiles_x);
+		events.push_back(cl::Event());
+		queue.enqueueNDRangeKernel(store, cl::NullRange, cl::NDRange(plan.block_width, plan.block_height, stacks), cl::NullRange, NULL, &events.back());
+	}
+	return events;
+}
+
+//mask sizes from which the FFT path is faster than the spatial one for full 2D and for separable masks, 0 if
+//it never is up to the largest size measured
+struct FftCrossover {
+	int full;
+	int separable;
+};
+
+//times both paths on a random image of the given size with disc (full 2D) and Gaussian (separable) masks; the FFT
+//side uses the plan PlanFftConvolution picks for that size, whole image or tiles, like PlanAutoConvolution will
+FftCrossover MeasureFftCrossover(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, int width, int height, int channels,
+			int max_mask_size = 63) {
+	size_t size = (size_t)width * height * channels;
+	vector<unsigned char> image(size);
+	for (size_t i = 0; i < size; i++)
+		image[i] = (unsigned char)rand();
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, size), dev_output(context, CL_MEM_READ_WRITE, size);
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, size, &image[0]);
+
+	FftCrossover crossover = { 0, 0 };
+	for (int mask_size = 3; mask_size <= max_mask_size && !(crossover.full && crossover.separable); mask_size += 4) {
+		for (int separable = 0; separable < 2; separable++) {
+			int& from = separable ? crossover.separable : crossover.full;
+			if (from)
+				continue;
+			vector<float> mask = separable ? GaussianMask(mask_size) : DiscMask(mask_size);
+			ConvolutionPlan spatial = PlanConvolution(context, queue, mask, mask_size, width, height, channels);
+			FftConvolution frequency = PlanFftConvolution(context, queue, program, mask, mask_size, width, height, channels);
+			vector<cl::Event> spatial_events = Convolve(queue, program, spatial, dev_input, dev_output, width, height, channels);
+			vector<cl::Event> fft_events = ConvolveFft(queue, program, frequency, dev_input, dev_output);
+			queue.finish();
+			if (GetExecutionTime(fft_events) < GetExecutionTime(spatial_events))
+				from = mask_size;
+		}
+	}
+	return crossover;
+}
+
+//the spatial or the FFT path, whichever the crossover says is faster for the mask
+struct AutoConvolution {
+	bool fft;
+	ConvolutionPlan spatial;
+	FftConvolution frequency;
+};
+
+AutoConvolution PlanAutoConvolution(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const FftCrossover& crossover,
+			const vector<float>& mask, int mask_size, int width, int height, int channels) {
+	AutoConvolution plan;
+	plan.spatial = PlanConvolution(context, queue, mask, mask_size, width, height, channels);
+	int from = plan.spatial.separable ? crossover.separable : crossover.full;
+	plan.fft = from && mask_size >= from;
+	if (plan.fft)
+		plan.frequency = PlanFftConvolution(context, queue, program, mask, mask_size, width, height, channels);
+	return plan;
+}
+
+vector<cl::Event> ConvolveAuto(cl::CommandQueue& queue, cl::Program& program, AutoConvolution& plan, const cl::Buffer& A, cl::Buffer& B,
+			int width, int height, int channels) {
+	if (plan.fft)
+		return ConvolveFft(queue, program, plan.frequency, A, B);
+	return Convolve(queue, program, plan.spatial, A, B, width, height, channels);
+}
+
+//recursive radix-2 transform in double precision, the reference of the benchmark
+void HostFft(vector<std::complex<double> >& values, int direction) {
+	size_t n = values.size();
+	if (n == 1)
+		return;
+	vector<std::complex<double> > even(n / 2), odd(n / 2);
+	for (size_t i = 0; i < n / 2; i++) {
+		even[i] = values[2 * i];
+		odd[i] = values[2 * i + 1];
+	}
+	HostFft(even, direction);
+	HostFft(odd, direction);
+	for (size_t k = 0; k < n / 2; k++) {
+		std::complex<double> t = std::polar(1.0, direction * 2.0 * M_PI * k / n) * odd[k];
+		values[k] = even[k] + t;
+		values[k + n / 2] = even[k] - t;
+	}
+}
+
+//1D transforms of every version against the host, FFT convolution (as planned and in 256 tiles) against convolutionND
+//for growing masks, the measured crossover, and a large image in tiles
+void BenchmarkFft(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+
+	//batches of 4M complex values, the first 4 transforms are checked
+	std::cout << std::setw(8) << "n" << std::setw(10) << "batch" << std::setw(18) << "radix 2 [us]" << std::setw(18) << "radix 8/4/2 [us]"
+		<< std::setw(16) << "local [us]" << std::setw(12) << "max error" << std::endl;
+	for (int n : { 16, 256, 1024, 4096, 65536 }) {
+		int count = std::max(1, (1 << 22) / n);
+		vector<cl_float2> values((size_t)n * count);
+		for (cl_float2& v : values) {
+			v.s[0] = rand() / (float)RAND_MAX - 0.5f;
+			v.s[1] = rand() / (float)RAND_MAX - 0.5f;
+		}
+		cl::Buffer data(context, CL_MEM_READ_WRITE, values.size() * sizeof(cl_float2)), temp(context, CL_MEM_READ_WRITE, values.size() * sizeof(cl_float2));
+		int checked = std::min(count, 4);
+		vector<std::complex<double> > reference((size_t)n * checked);
+		for (int b = 0; b < checked; b++) {
+			vector<std::complex<double> > row(n);
+			for (int i = 0; i < n; i++)
+				row[i] = std::complex<double>(values[(size_t)b * n + i].s[0], values[(size_t)b * n + i].s[1]);
+			HostFft(row, -1);
+			std::copy(row.begin(), row.end(), reference.begin() + (size_t)b * n);
+		}
+
+		std::cout << std::setw(8) << n << std::setw(10) << count;
+		double max_error = 0;
+		FftPlan plans[] = { PlanFft(device, n, true, 2, false), PlanFft(device, n, true, 8, false), PlanFft(device, n, true, 8, true) };
+		for (const FftPlan& plan : plans) {
+			if (&plan == &plans[2] && !plan.local) {
+				std::cout << std::setw(16) << "-";
+				continue;
+			}
+			queue.enqueueWriteBuffer(data, CL_TRUE, 0, values.size() * sizeof(cl_float2), &values[0]);
+			vector<cl::Event> events;
+			cl::Buffer result = EnqueueFft(queue, program, plan, data, temp, count, FftBatch(1, count, n, 0), -1.0f, events);
+			vector<cl_float2> output((size_t)n * checked);
+			queue.enqueueReadBuffer(result, CL_TRUE, 0, output.size() * sizeof(cl_float2), &output[0]);
+			for (size_t i = 0; i < output.size(); i++)
+				max_error = std::max(max_error, std::abs(std::complex<double>(output[i].s[0], output[i].s[1]) - reference[i]) / sqrt((double)n));
+			std::cout << std::setw(&plan == &plans[2] ? 16 : 18) << std::fixed << std::setprecision(0) << GetExecutionTime(events, PROF_US);
+		}
+		std::cout << std::setw(12) << std::scientific << std::setprecision(1) << max_error << std::fixed << std::endl;
+	}
+
+	//convolution of the input image with non-separable masks
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image.size()), dev_spatial(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_fft(context, CL_MEM_READ_WRITE, image.size());
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image.size(), image.data());
+	vector<unsigned char> spatial_result(image.size()), fft_result(image.size());
+	auto max_diff = [&](cl::Buffer& buffer) {
+		queue.enqueueReadBuffer(buffer, CL_TRUE, 0, image.size(), &fft_result[0]);
+		int diff = 0;
+		for (size_t i = 0; i < image.size(); i++)
+			diff = std::max(diff, abs((int)fft_result[i] - (int)spatial_result[i]));
+		return diff;
+	};
+
+	std::cout << std::endl << "Disc mask convolution of a " << width << "x" << height << "x" << channels << " image" << std::endl;
+	std::cout << std::setw(8) << "mask" << std::setw(16) << "spatial [us]" << std::setw(12) << "FFT [us]" << std::setw(16) << "FFT tiles"
+		<< std::setw(10) << "diff" << std::setw(20) << "256 tiles [us]" << std::setw(8) << "tiles" << std::setw(10) << "diff" << std::endl;
+	for (int mask_size : { 3, 7, 15, 31, 63 }) {
+		vector<float> mask = DiscMask(mask_size);
+		ConvolutionPlan spatial = PlanConvolution(context, queue, mask, mask_size, width, height, channels, true);
+		FftConvolution planned = PlanFftConvolution(context, queue, program, mask, mask_size, width, height, channels);
+		FftConvolution tiled = PlanFftConvolution(context, queue, program, mask, mask_size, width, height, channels, 256);
+
+		vector<cl::Event> spatial_events = Convolve(queue, program, spatial, dev_input, dev_spatial, width, height, channels);
+		queue.enqueueReadBuffer(dev_spatial, CL_TRUE, 0, image.size(), &spatial_result[0]);
+		vector<cl::Event> planned_events = ConvolveFft(queue, program, planned, dev_input, dev_fft);
+		int planned_diff = max_diff(dev_fft);
+		vector<cl::Event> tiled_events = ConvolveFft(queue, program, tiled, dev_input, dev_fft);
+		int tiled_diff = max_diff(dev_fft);
+
+		std::cout << std::setw(8) << mask_size << std::setw(16) << std::setprecision(0) << GetExecutionTime(spatial_events, PROF_US)
+			<< std::setw(12) << GetExecutionTime(planned_events, PROF_US) << std::setw(16) << (std::to_string(planned.tiles_x * planned.tiles_y) + "x" + std::to_string(planned.fw) + "x" + std::to_string(planned.fh))
+			<< std::setw(10) << planned_diff << std::setw(20) << GetExecutionTime(tiled_events, PROF_US)
+			<< std::setw(8) << tiled.tiles_x * tiled.tiles_y << std::setw(10) << tiled_diff << std::endl;
+	}
+
+	//the crossover on a 1024x1024 RGB image decides the path of ConvolveAuto
+	FftCrossover crossover = MeasureFftCrossover(context, queue, program, 1024, 1024, 3);
+	std::cout << "FFT is faster from mask size " << (crossover.full ? std::to_string(crossover.full) : "-") << " (2D masks), "
+		<< (crossover.separable ? std::to_string(crossover.separable) : "-") << " (separable masks)" << std::endl;
+	for (int mask_size : { 5, 41 }) {
+		AutoConvolution automatic = PlanAutoConvolution(context, queue, program, crossover, DiscMask(mask_size), mask_size, width, height, channels);
+		vector<cl::Event> events = ConvolveAuto(queue, program, automatic, dev_input, dev_fft, width, height, channels);
+		queue.finish();
+		std::cout << "disc " << mask_size << ": " << (automatic.fft ? "FFT" : "spatial") << ", " << GetExecutionTime(events, PROF_US) << " us" << std::endl;
+	}
+
+	//a large image goes through tiles, only a strip of them is in memory
+	int size = 8192, mask_size = 31;
+	if ((cl_ulong)size * size * 3 > device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>())
+		return;
+	vector<unsigned char> synthetic((size_t)size * size * 3);
+	for (size_t i = 0; i < synthetic.size(); i++)
+		synthetic[i] = (unsigned char)rand();
+	cl::Buffer dev_large(context, CL_MEM_READ_ONLY, synthetic.size()), dev_large_output(context, CL_MEM_READ_WRITE, synthetic.size());
+	queue.enqueueWriteBuffer(dev_large, CL_TRUE, 0, synthetic.size(), &synthetic[0]);
+	FftConvolution large = PlanFftConvolution(context, queue, program, DiscMask(mask_size), mask_size, size, size, 3);
+	vector<cl::Event> events = ConvolveFft(queue, program, large, dev_large, dev_large_output);
+	queue.finish();
+	double time = GetExecutionTime(events, PROF_US);
+	std::cout << size << "x" << size << "x3 with a " << mask_size << "x" << mask_size << " disc: " << large.tiles_x * large.tiles_y << " tiles of "
+		<< large.fw << "x" << large.fh << ", " << time << " us (" << std::setprecision(1) << (double)size * size / time << " MPixel/s)" << std::endl;
+}
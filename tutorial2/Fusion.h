@@ -0,0 +1,194 @@
+#pragma once
+
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+#include "ImagePath.h"
+
+//point-op fusion: a run of per-pixel filters (invert, filter_r, rgb2gray, gamma) is compiled into a single
+//kernel that loads every pixel once, applies all of them in registers and stores it once, instead of one
+//full read and write pass over the image per filter
+//every step rounds to uchar exactly like the separate kernel does, so the fused output is identical
+//neighbourhood filters (average, convolution) need their neighbours' results and end a fused run
+
+bool IsPointFilter(ImageFilter filter) {
+	return filter != FILTER_AVERAGE && filter != FILTER_CONVOLUTION;
+}
+
+//fused kernels by the names of the filters they apply, e.g. "invert_gamma_rgb2gray"
+struct FusionCache {
+	std::map<string, cl::Kernel> kernels;
+	int builds = 0;
+};
+
+//the name of a run of point filters, also used as the kernel name
+string FusionSignature(const vector<ImageFilter>& filters) {
+	string signature = "fused";
+	for (ImageFilter filter : filters)
+		signature += string("_") + ImageFilterName(filter);
+	return signature;
+}
+
+//OpenCL source of the fused kernel: planar RGB with the global size (width, height) like rgb2gray,
+//gamma values are arguments (one per gamma step) so a kernel serves every gamma
+string FusionSource(const vector<ImageFilter>& filters) {
+	std::stringstream source;
+	source << "kernel void " << FusionSignature(filters) << "(global const uchar* A, global uchar* B";
+	int gammas = 0;
+	for (ImageFilter filter : filters)
+		if (filter == FILTER_GAMMA)
+			source << ", const float gamma" << gammas++;
+	source << ") {\n"
+		"\tint image_size = get_global_size(0)*get_global_size(1);\n"
+		"\tint id = get_global_id(0) + get_global_id(1)*get_global_size(0);\n"
+		"\tuchar r = A[id], g = A[id + image_size], b = A[id + 2*image_size];\n";
+
+	gammas = 0;
+	for (ImageFilter filter : filters) {
+		switch (filter) {
+		case FILTER_INVERT:
+			source << "\tr = 255 - r; g = 255 - g; b = 255 - b;\n";
+			break;
+		case FILTER_R:
+			source << "\tg = 0; b = 0;\n";
+			break;
+		case FILTER_GRAY:
+			source << "\tr = g = b = (0.2126 * r) + (0.7152 * g) + (0.0722 * b);\n";
+			break;
+		case FILTER_GAMMA:
+			source << "\tr = pow((float)(((float)r) / 255.0), gamma" << gammas << ") * 255.0;\n"
+				"\tg = pow((float)(((float)g) / 255.0), gamma" << gammas << ") * 255.0;\n"
+				"\tb = pow((float)(((float)b) / 255.0), gamma" << gammas << ") * 255.0;\n";
+			gammas++;
+			break;
+		default: //identity
+			break;
+		}
+	}
+
+	source << "\tB[id] = r; B[id + image_size] = g; B[id + 2*image_size] = b;\n}\n";
+	return source.str();
+}
+
+//the fused kernel for a run of point filters, compiled on first use
+cl::Kernel GetFusedKernel(const cl::Context& context, FusionCache& cache, const vector<ImageFilter>& filters) {
+	string signature = FusionSignature(filters);
+	std::map<string, cl::Kernel>::iterator cached = cache.kernels.find(signature);
+	if (cached != cache.kernels.end())
+		return cached->second;
+
+	cl::Program program = BuildProgramSource(context, FusionSource(filters));
+	cl::Kernel kernel(program, signature.c_str());
+	cache.kernels[signature] = kernel;
+	cache.builds++;
+	return kernel;
+}
+
+//applies the filters in order to a planar RGB image: runs of point filters become one fused launch,
+//neighbourhood filters run on their own; A is not modified, the result ends up in B
+//temp is a buffer of the image size for the ping-pong between launches
+vector<cl::Event> RunFused(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, FusionCache& cache,
+			const vector<ImageFilter>& filters, const FilterParams& params, const cl::Buffer& A, cl::Buffer& B, cl::Buffer& temp,
+			int width, int height) {
+	//split into launches first, so the ping-pong can be arranged to finish in B
+	vector<vector<ImageFilter> > launches;
+	for (size_t f = 0; f < filters.size(); f++) {
+		if (filters[f] == FILTER_IDENTITY)
+			continue;
+		if (IsPointFilter(filters[f]) && !launches.empty() && IsPointFilter(launches.back()[0]))
+			launches.back().push_back(filters[f]);
+		else
+			launches.push_back(vector<ImageFilter>(1, filters[f]));
+	}
+	if (launches.empty())
+		launches.push_back(vector<ImageFilter>(1, FILTER_IDENTITY));
+
+	vector<cl::Event> events;
+	const cl::Buffer* input = &A;
+	for (size_t l = 0; l < launches.size(); l++) {
+		//the last launch writes B, the others alternate so that they never write their own input
+		cl::Buffer& output = ((launches.size() - 1 - l) % 2 == 0) ? B : temp;
+		cl::Event prof_event;
+		if (!IsPointFilter(launches[l][0]))
+			prof_event = FilterBuffer(queue, program, launches[l][0], *input, output, width, height, 3, params);
+		else {
+			cl::Kernel kernel = GetFusedKernel(context, cache, launches[l]);
+			kernel.setArg(0, *input);
+			kernel.setArg(1, output);
+			int arg = 2;
+			for (ImageFilter filter : launches[l])
+				if (filter == FILTER_GAMMA)
+					kernel.setArg(arg++, params.gamma);
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(width, height), cl::NullRange, NULL, &prof_event);
+		}
+		events.push_back(prof_event);
+		input = &output;
+	}
+	return events;
+}
+
+//fused against one launch per filter for a few chains, the outputs have to be identical
+void BenchmarkFusion(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width(), height = image.height();
+	if (image.spectrum() != 3) {
+		std::cout << "The fusion benchmark expects an RGB image" << std::endl;
+		return;
+	}
+
+	FilterParams params;
+	params.gamma = 1.5f;
+	params.range = 4;
+	params.mask_size = 5;
+	vector<float> mask = GaussianMask(params.mask_size);
+	params.mask = cl::Buffer(context, CL_MEM_READ_ONLY, mask.size() * sizeof(float));
+	queue.enqueueWriteBuffer(params.mask, CL_TRUE, 0, mask.size() * sizeof(float), &mask[0]);
+
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image.size());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_temp(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_unfused[2] = { cl::Buffer(context, CL_MEM_READ_WRITE, image.size()), cl::Buffer(context, CL_MEM_READ_WRITE, image.size()) };
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image.size(), image.data());
+	vector<unsigned char> fused(image.size()), unfused(image.size());
+
+	vector<vector<ImageFilter> > chains = {
+		{ FILTER_INVERT, FILTER_GAMMA },
+		{ FILTER_INVERT, FILTER_GAMMA, FILTER_GRAY },
+		{ FILTER_R, FILTER_INVERT, FILTER_GAMMA, FILTER_GAMMA },
+		{ FILTER_GRAY, FILTER_GAMMA, FILTER_CONVOLUTION, FILTER_INVERT, FILTER_GAMMA },
+		{ FILTER_INVERT, FILTER_GAMMA }, //the same signature again, taken from the cache
+	};
+
+	FusionCache cache;
+	std::cout << "Point-op fusion on a " << width << "x" << height << " image" << std::endl;
+	std::cout << std::setw(44) << std::left << "chain" << std::right << std::setw(10) << "launches" << std::setw(16) << "separate [us]"
+		<< std::setw(14) << "fused [us]" << std::setw(10) << "speedup" << std::setw(8) << "builds" << std::setw(8) << "check" << std::endl;
+
+	for (const vector<ImageFilter>& chain : chains) {
+		string name;
+		for (ImageFilter filter : chain)
+			name += (name.empty() ? "" : ",") + string(ImageFilterName(filter));
+
+		//one launch per filter
+		vector<cl::Event> separate_events;
+		const cl::Buffer* input = &dev_input;
+		for (size_t f = 0; f < chain.size(); f++) {
+			separate_events.push_back(FilterBuffer(queue, program, chain[f], *input, dev_unfused[f % 2], width, height, 3, params));
+			input = &dev_unfused[f % 2];
+		}
+		queue.enqueueReadBuffer(*input, CL_TRUE, 0, image.size(), &unfused[0]);
+
+		int builds = cache.builds;
+		vector<cl::Event> fused_events = RunFused(context, queue, program, cache, chain, params, dev_input, dev_output, dev_temp, width, height);
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &fused[0]);
+
+		double separate = GetExecutionTime(separate_events, PROF_US), together = GetExecutionTime(fused_events, PROF_US);
+		std::cout << std::setw(44) << std::left << name << std::right << std::setw(10) << fused_events.size() << std::setw(16) << std::fixed
+			<< std::setprecision(0) << separate << std::setw(14) << together << std::setw(10) << std::setprecision(2) << separate / together
+			<< std::setw(8) << cache.builds - builds << std::setw(8) << (fused == unfused ? "OK" : "FAILED") << std::endl;
+	}
+}
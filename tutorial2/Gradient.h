@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cmath>
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+#include "ImagePath.h"
+
+//image gradient in a single launch (kernels/gradient.cl): the grayscale conversion, Gx, Gy, the magnitude
+//and optionally the quantised orientation, computed from a local tile so every input pixel is read once
+//per work-group; the building block of edge detection on large images
+
+enum GradientOperator { GRADIENT_SOBEL, GRADIENT_SCHARR };
+enum GradientNorm { GRADIENT_L2, GRADIENT_L1 };
+
+struct GradientConfig {
+	GradientOperator op = GRADIENT_SOBEL;
+	GradientNorm norm = GRADIENT_L2;
+	int bins = 0;		//orientation sectors over 180 degrees, 0 for no orientation output
+	float scale = 1.0f;	//applied to the magnitude before clamping to 0..255
+	int tx = 16, ty = 16;	//work-group size
+};
+
+//magnitude (and orientation if config.bins) of the planar image A with 1 or 3 channels, both outputs are
+//width*height bytes; orientation is not touched when config.bins is 0 and can be an empty buffer
+cl::Event Gradient(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& magnitude, cl::Buffer& orientation,
+			int width, int height, int channels, const GradientConfig& config) {
+	if (channels != 1 && channels != 3)
+		throw cl::Error(CL_INVALID_VALUE, "Gradient: 1 or 3 channels expected");
+
+	cl::Kernel kernel(program, "gradient");
+	kernel.setArg(0, A);
+	kernel.setArg(1, magnitude);
+	kernel.setArg(2, config.bins ? orientation : magnitude);
+	kernel.setArg(3, width);
+	kernel.setArg(4, height);
+	kernel.setArg(5, channels);
+	kernel.setArg(6, (int)(config.op == GRADIENT_SCHARR));
+	kernel.setArg(7, (int)(config.norm == GRADIENT_L1));
+	kernel.setArg(8, config.bins);
+	kernel.setArg(9, config.scale);
+	kernel.setArg(10, cl::Local((config.tx + 2) * (config.ty + 2) * sizeof(float)));
+
+	cl::NDRange global((width + config.tx - 1) / config.tx * config.tx, (height + config.ty - 1) / config.ty * config.ty);
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NDRange(config.tx, config.ty), NULL, &prof_event);
+	return prof_event;
+}
+
+//host reference on a gray image; the L2 magnitude may differ by 1 from the device (hypot is not correctly
+//rounded) and orientations within tolerance radians of a sector boundary may fall on either side
+bool CheckGradient(const vector<unsigned char>& gray, const vector<unsigned char>& magnitude, const vector<unsigned char>& orientation,
+			int width, int height, const GradientConfig& config, double tolerance = 1e-4) {
+	double side = config.op == GRADIENT_SCHARR ? 3 : 1, centre = config.op == GRADIENT_SCHARR ? 10 : 2;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			double gx = 0, gy = 0;
+			for (int j = -1; j <= 1; j++)
+				for (int i = -1; i <= 1; i++)
+					if (x + i >= 0 && x + i < width && y + j >= 0 && y + j < height) {
+						double value = gray[(x + i) + (y + j) * width];
+						gx += value * i * (j == 0 ? centre : side);
+						gy -= value * j * (i == 0 ? centre : side);
+					}
+
+			int id = x + y * width;
+			double m = config.norm == GRADIENT_L1 ? fabs(gx) + fabs(gy) : sqrt(gx * gx + gy * gy);
+			int expected = (int)std::min(std::max(m * config.scale, 0.0), 255.0);
+			if (abs(magnitude[id] - expected) > (config.norm == GRADIENT_L2 ? 1 : 0))
+				return false;
+
+			if (config.bins) {
+				double angle = atan2(gy, gx);
+				if (angle < 0)
+					angle += M_PI;
+				double sector = angle * config.bins / M_PI + 0.5;
+				int bin = (int)sector % config.bins;
+				double boundary = fabs(sector - floor(sector + 0.5)) * M_PI / config.bins;
+				if (orientation[id] != bin && !(boundary < tolerance && (orientation[id] == (bin + 1) % config.bins
+					|| orientation[id] == (bin + config.bins - 1) % config.bins)))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+//the fused kernel against rgb2gray -> sobel_xy -> gradient_magnitude (identical output expected) and
+//the other operator, norm and orientation combinations against the host
+void BenchmarkGradient(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width(), height = image.height(), image_size = width * height;
+	if (image.spectrum() != 3) {
+		std::cout << "The gradient benchmark expects an RGB image" << std::endl;
+		return;
+	}
+
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image.size());
+	cl::Buffer dev_gray(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_gx(context, CL_MEM_READ_WRITE, image_size * sizeof(float));
+	cl::Buffer dev_gy(context, CL_MEM_READ_WRITE, image_size * sizeof(float));
+	cl::Buffer dev_magnitude(context, CL_MEM_READ_WRITE, image_size);
+	cl::Buffer dev_orientation(context, CL_MEM_READ_WRITE, image_size);
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image.size(), image.data());
+	vector<unsigned char> gray(image_size), reference(image_size), magnitude(image_size), orientation(image_size);
+
+	std::cout << "Image gradient on a " << width << "x" << height << " image" << std::endl;
+	std::cout << std::setw(36) << std::left << "method" << std::right << std::setw(10) << "launches" << std::setw(14) << "time [us]"
+		<< std::setw(8) << "check" << std::endl;
+	auto report = [&](const string& name, const vector<cl::Event>& events, bool check) {
+		std::cout << std::setw(36) << std::left << name << std::right << std::setw(10) << events.size() << std::setw(14) << std::fixed
+			<< std::setprecision(0) << GetExecutionTime(events, PROF_US) << std::setw(8) << (check ? "OK" : "FAILED") << std::endl;
+	};
+
+	//separate kernels on the first plane of the gray image
+	vector<cl::Event> separate_events;
+	FilterParams params;
+	separate_events.push_back(FilterBuffer(queue, program, FILTER_GRAY, dev_input, dev_gray, width, height, 3, params));
+	cl::Kernel sobel(program, "sobel_xy");
+	sobel.setArg(0, dev_gray);
+	sobel.setArg(1, dev_gx);
+	sobel.setArg(2, dev_gy);
+	cl::Kernel combine(program, "gradient_magnitude");
+	combine.setArg(0, dev_gx);
+	combine.setArg(1, dev_gy);
+	combine.setArg(2, dev_magnitude);
+	separate_events.push_back(cl::Event());
+	queue.enqueueNDRangeKernel(sobel, cl::NullRange, cl::NDRange(width, height, 1), cl::NullRange, NULL, &separate_events.back());
+	separate_events.push_back(cl::Event());
+	queue.enqueueNDRangeKernel(combine, cl::NullRange, cl::NDRange(width, height, 1), cl::NullRange, NULL, &separate_events.back());
+	queue.enqueueReadBuffer(dev_gray, CL_TRUE, 0, image_size, &gray[0]);
+	queue.enqueueReadBuffer(dev_magnitude, CL_TRUE, 0, image_size, &reference[0]);
+	report("rgb2gray, sobel_xy, magnitude", separate_events, true);
+
+	struct Variant { const char* name; GradientOperator op; GradientNorm norm; int bins; };
+	const Variant variants[] = {
+		{ "fused Sobel L2", GRADIENT_SOBEL, GRADIENT_L2, 0 },
+		{ "fused Sobel L1", GRADIENT_SOBEL, GRADIENT_L1, 0 },
+		{ "fused Scharr L2", GRADIENT_SCHARR, GRADIENT_L2, 0 },
+		{ "fused Sobel L2, 4 orientations", GRADIENT_SOBEL, GRADIENT_L2, 4 },
+		{ "fused Scharr L1, 8 orientations", GRADIENT_SCHARR, GRADIENT_L1, 8 },
+	};
+	for (const Variant& variant : variants) {
+		GradientConfig config;
+		config.op = variant.op;
+		config.norm = variant.norm;
+		config.bins = variant.bins;
+		config.scale = variant.op == GRADIENT_SCHARR ? 0.25f : 1.0f; //Scharr's weights sum to 16 instead of 4
+		cl::Event prof_event = Gradient(queue, program, dev_input, dev_magnitude, dev_orientation, width, height, 3, config);
+		queue.enqueueReadBuffer(dev_magnitude, CL_TRUE, 0, image_size, &magnitude[0]);
+		if (config.bins)
+			queue.enqueueReadBuffer(dev_orientation, CL_TRUE, 0, image_size, &orientation[0]);
+		//the Sobel L2 magnitude uses the same arithmetic as the separate kernels
+		bool check = (&variant == &variants[0]) ? magnitude == reference : CheckGradient(gray, magnitude, orientation, width, height, config);
+		report(variant.name, { prof_event }, check);
+	}
+}
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <chrono>
+#include <iomanip>
+#include <map>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+#include "ImagePath.h"
+#include "Pixel.h"
+
+//device-resident filter graph: nodes are filters, edges are images (values) of the same width, height
+//and channel count; everything stays on the device and only the values marked as outputs are read back
+//nodes are added in topological order (a node can only use values that already exist), so the order in
+//which they are added is a valid execution order for any DAG
+
+//operations with more than one input or output, the single image filters are the ImageFilter values
+enum GraphOp { GRAPH_FILTER, GRAPH_SOBEL, GRAPH_MAGNITUDE, GRAPH_CONVERT };
+
+//a value is a planar image of any pixel type; filters keep the type of their input, so a chain converted to
+//float at the start is only quantised where it is converted back
+struct GraphValue {
+	PixelType type;
+	size_t bytes;
+	bool output;
+	int last_use;	//index of the last node reading the value
+	int buffer;	//slot in the buffer pool, -1 for the graph input
+};
+
+struct GraphNode {
+	GraphOp op;
+	ImageFilter filter;
+	FilterParams params;
+	vector<int> inputs, outputs;
+};
+
+struct FilterGraph {
+	int width, height, channels;
+	vector<GraphValue> values;	//value 0 is the input image
+	vector<GraphNode> nodes;
+	vector<size_t> pool;		//bytes of every pooled buffer, filled by PlanGraph
+};
+
+FilterGraph CreateGraph(int width, int height, int channels, PixelType type = PIXEL_UCHAR) {
+	FilterGraph graph;
+	graph.width = width;
+	graph.height = height;
+	graph.channels = channels;
+	GraphValue input = { type, (size_t)width * height * channels * PixelBytes(type), false, -1, -1 };
+	graph.values.push_back(input);
+	return graph;
+}
+
+int AddGraphValue(FilterGraph& graph, PixelType type) {
+	GraphValue value = { type, (size_t)graph.width * graph.height * graph.channels * PixelBytes(type), false, -1, -1 };
+	graph.values.push_back(value);
+	return (int)graph.values.size() - 1;
+}
+
+void AddGraphNode(FilterGraph& graph, GraphNode& node) {
+	for (int input : node.inputs)
+		if (input < 0 || input >= (int)graph.values.size())
+			throw cl::Error(CL_INVALID_VALUE, "AddGraphNode: input value does not exist");
+	graph.nodes.push_back(node);
+}
+
+//type of an existing value, for checking the inputs of a node
+PixelType GraphValueType(const FilterGraph& graph, int value) {
+	if (value < 0 || value >= (int)graph.values.size())
+		throw cl::Error(CL_INVALID_VALUE, "AddGraphNode: input value does not exist");
+	return graph.values[value].type;
+}
+
+//one of the image filters of my_kernels.cl (uchar values) or kernels/pixel.cl (other types), returns its output value
+int AddFilter(FilterGraph& graph, ImageFilter filter, int input, const FilterParams& params = FilterParams()) {
+	GraphNode node;
+	node.op = GRAPH_FILTER;
+	node.filter = filter;
+	node.params = params;
+	node.inputs.push_back(input);
+	node.outputs.push_back(AddGraphValue(graph, GraphValueType(graph, input)));
+	AddGraphNode(graph, node);
+	return node.outputs[0];
+}
+
+//the value converted to another pixel type (ConvertPixels), one of the two types has to be float
+int AddConvert(FilterGraph& graph, int input, PixelType type) {
+	PixelType from = GraphValueType(graph, input);
+	if (from != PIXEL_FLOAT && type != PIXEL_FLOAT && from != type)
+		throw cl::Error(CL_INVALID_VALUE, "AddConvert: one of the types has to be float");
+	GraphNode node;
+	node.op = GRAPH_CONVERT;
+	node.inputs.push_back(input);
+	node.outputs.push_back(AddGraphValue(graph, type));
+	AddGraphNode(graph, node);
+	return node.outputs[0];
+}
+
+//Sobel derivatives of a uchar value, a node with two outputs: returns the values of Gx and Gy
+std::pair<int, int> AddSobel(FilterGraph& graph, int input) {
+	if (GraphValueType(graph, input) != PIXEL_UCHAR)
+		throw cl::Error(CL_INVALID_VALUE, "AddSobel: the input has to be a uchar value");
+	GraphNode node;
+	node.op = GRAPH_SOBEL;
+	node.inputs.push_back(input);
+	node.outputs.push_back(AddGraphValue(graph, PIXEL_FLOAT));
+	node.outputs.push_back(AddGraphValue(graph, PIXEL_FLOAT));
+	AddGraphNode(graph, node);
+	return std::make_pair(node.outputs[0], node.outputs[1]);
+}
+
+int AddMagnitude(FilterGraph& graph, int gx, int gy) {
+	if (GraphValueType(graph, gx) != PIXEL_FLOAT || GraphValueType(graph, gy) != PIXEL_FLOAT)
+		throw cl::Error(CL_INVALID_VALUE, "AddMagnitude: the inputs have to be float values");
+	GraphNode node;
+	node.op = GRAPH_MAGNITUDE;
+	node.inputs.push_back(gx);
+	node.inputs.push_back(gy);
+	node.outputs.push_back(AddGraphValue(graph, PIXEL_UCHAR));
+	AddGraphNode(graph, node);
+	return node.outputs[0];
+}
+
+void MarkOutput(FilterGraph& graph, int value) {
+	graph.values[value].output = true;
+}
+
+//assigns the values to as few buffers as their lifetimes allow: walking the nodes in order, the outputs of a
+//node take a free buffer that is large enough (or a new one), and the inputs whose last reader is this node
+//release theirs afterwards, so a node never writes a buffer it reads; outputs are never released
+void PlanGraph(FilterGraph& graph) {
+	for (size_t n = 0; n < graph.nodes.size(); n++)
+		for (int input : graph.nodes[n].inputs)
+			graph.values[input].last_use = (int)n;
+
+	graph.pool.clear();
+	vector<int> free_buffers;
+	for (size_t n = 0; n < graph.nodes.size(); n++) {
+		for (int output : graph.nodes[n].outputs) {
+			GraphValue& value = graph.values[output];
+			//the smallest free buffer that fits
+			int best = -1;
+			for (size_t f = 0; f < free_buffers.size(); f++)
+				if (graph.pool[free_buffers[f]] >= value.bytes && (best < 0 || graph.pool[free_buffers[f]] < graph.pool[free_buffers[best]]))
+					best = (int)f;
+			if (best >= 0) {
+				value.buffer = free_buffers[best];
+				free_buffers.erase(free_buffers.begin() + best);
+			}
+			else {
+				value.buffer = (int)graph.pool.size();
+				graph.pool.push_back(value.bytes);
+			}
+		}
+		for (int input : graph.nodes[n].inputs) {
+			const GraphValue& value = graph.values[input];
+			if (value.last_use == (int)n && !value.output && value.buffer >= 0)
+				free_buffers.push_back(value.buffer);
+		}
+		//a value nobody reads is dead after its node unless it is an output
+		for (int output : graph.nodes[n].outputs)
+			if (graph.values[output].last_use < 0 && !graph.values[output].output)
+				free_buffers.push_back(graph.values[output].buffer);
+	}
+}
+
+//device buffers for a planned graph, can be reused for every image of the same size
+vector<cl::Buffer> AllocateGraph(const cl::Context& context, const FilterGraph& graph) {
+	vector<cl::Buffer> buffers;
+	for (size_t bytes : graph.pool)
+		buffers.push_back(cl::Buffer(context, CL_MEM_READ_WRITE, bytes));
+	return buffers;
+}
+
+//enqueues every node and reads back the output values; returns the events of the kernels
+vector<cl::Event> RunGraph(cl::CommandQueue& queue, cl::Program& program, const FilterGraph& graph, const cl::Buffer& input,
+			vector<cl::Buffer>& buffers, std::map<int, vector<unsigned char> >& outputs) {
+	//the graph input is the only value without a pooled buffer and is never written
+	auto in = [&](int value) -> const cl::Buffer& { return graph.values[value].buffer < 0 ? input : buffers[graph.values[value].buffer]; };
+	auto out = [&](int value) -> cl::Buffer& { return buffers[graph.values[value].buffer]; };
+	cl::NDRange global(graph.width, graph.height, graph.channels);
+	vector<cl::Event> events;
+
+	for (const GraphNode& node : graph.nodes) {
+		cl::Event prof_event;
+		PixelType type = graph.values[node.inputs[0]].type;
+		if (node.op == GRAPH_FILTER && type == PIXEL_UCHAR)
+			prof_event = FilterBuffer(queue, program, node.filter, in(node.inputs[0]), out(node.outputs[0]),
+				graph.width, graph.height, graph.channels, node.params);
+		else if (node.op == GRAPH_FILTER)
+			prof_event = FilterTyped(queue, program, node.filter, type, in(node.inputs[0]), out(node.outputs[0]),
+				graph.width, graph.height, graph.channels, node.params);
+		else if (node.op == GRAPH_CONVERT)
+			prof_event = ConvertPixels(queue, program, type, graph.values[node.outputs[0]].type, in(node.inputs[0]), out(node.outputs[0]),
+				(size_t)graph.width * graph.height * graph.channels);
+		else {
+			cl::Kernel kernel(program, node.op == GRAPH_SOBEL ? "sobel_xy" : "gradient_magnitude");
+			int arg = 0;
+			for (int value : node.inputs)
+				kernel.setArg(arg++, in(value));
+			for (int value : node.outputs)
+				kernel.setArg(arg++, out(value));
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NullRange, NULL, &prof_event);
+		}
+		events.push_back(prof_event);
+	}
+
+	for (size_t v = 0; v < graph.values.size(); v++)
+		if (graph.values[v].output) {
+			vector<unsigned char>& data = outputs[(int)v];
+			data.resize(graph.values[v].bytes);
+			queue.enqueueReadBuffer(in((int)v), CL_TRUE, 0, data.size(), &data[0]);
+		}
+	return events;
+}
+
+//builds a graph with a chain, a multi-output node and a branch; runs it with the planned buffers and
+//compares the outputs with running every node on its own buffer with a readback after each step
+void BenchmarkGraph(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	if (channels != 3) {
+		std::cout << "The graph benchmark expects an RGB image" << std::endl;
+		return;
+	}
+
+	FilterParams params;
+	params.gamma = 1.5f;
+	params.range = 4;
+	params.mask_size = 5;
+	vector<float> mask = GaussianMask(params.mask_size);
+	params.mask = cl::Buffer(context, CL_MEM_READ_ONLY, mask.size() * sizeof(float));
+	queue.enqueueWriteBuffer(params.mask, CL_TRUE, 0, mask.size() * sizeof(float), &mask[0]);
+
+	//input -> rgb2gray -> gamma -> convolution          (output)
+	//             `-> sobel -> Gx, Gy -> magnitude       (output)
+	//input -> invert -> average                          (output)
+	FilterGraph graph = CreateGraph(width, height, channels);
+	int gray = AddFilter(graph, FILTER_GRAY, 0);
+	int gamma = AddFilter(graph, FILTER_GAMMA, gray, params);
+	int smooth = AddFilter(graph, FILTER_CONVOLUTION, gamma, params);
+	std::pair<int, int> gradient = AddSobel(graph, gray);
+	int edges = AddMagnitude(graph, gradient.first, gradient.second);
+	int inverted = AddFilter(graph, FILTER_INVERT, 0);
+	int average = AddFilter(graph, FILTER_AVERAGE, inverted, params);
+	MarkOutput(graph, smooth);
+	MarkOutput(graph, edges);
+	MarkOutput(graph, average);
+	PlanGraph(graph);
+
+	size_t planned = 0, naive = 0;
+	for (size_t bytes : graph.pool)
+		planned += bytes;
+	for (size_t v = 1; v < graph.values.size(); v++)
+		naive += graph.values[v].bytes;
+
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image.size());
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image.size(), image.data());
+	vector<cl::Buffer> buffers = AllocateGraph(context, graph);
+
+	std::map<int, vector<unsigned char> > outputs;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	vector<cl::Event> events = RunGraph(queue, program, graph, dev_input, buffers, outputs);
+	double graph_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+	//reference: one buffer per value and a readback after every node
+	FilterGraph unplanned = graph;
+	unplanned.pool.clear();
+	for (size_t v = 1; v < unplanned.values.size(); v++) {
+		unplanned.values[v].buffer = (int)unplanned.pool.size();
+		unplanned.pool.push_back(unplanned.values[v].bytes);
+	}
+	vector<cl::Buffer> unplanned_buffers = AllocateGraph(context, unplanned);
+	std::map<int, vector<unsigned char> > reference;
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t n = 0; n < unplanned.nodes.size(); n++) {
+		FilterGraph step = unplanned;
+		step.nodes.assign(1, unplanned.nodes[n]);
+		for (GraphValue& value : step.values)
+			value.output = false;
+		for (int output : unplanned.nodes[n].outputs)
+			step.values[output].output = true;
+		RunGraph(queue, program, step, dev_input, unplanned_buffers, reference);
+	}
+	double step_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+	bool correct = true;
+	for (const std::pair<const int, vector<unsigned char> >& output : outputs)
+		correct = correct && output.second == reference[output.first];
+
+	std::cout << "Filter graph on a " << width << "x" << height << "x" << channels << " image: " << graph.nodes.size() << " nodes, "
+		<< graph.values.size() - 1 << " values" << std::endl;
+	std::cout << "buffers: " << graph.pool.size() << " (" << planned / 1024 / 1024 << " MB) instead of " << graph.values.size() - 1
+		<< " (" << naive / 1024 / 1024 << " MB)" << std::endl;
+	std::cout << std::setw(12) << "node" << std::setw(14) << "time [us]" << std::endl;
+	for (size_t n = 0; n < graph.nodes.size(); n++) {
+		const GraphNode& node = graph.nodes[n];
+		string name = node.op == GRAPH_FILTER ? ImageFilterName(node.filter) : node.op == GRAPH_SOBEL ? "sobel" : node.op == GRAPH_CONVERT ? "convert" : "magnitude";
+		std::cout << std::setw(12) << name << std::setw(14) << std::fixed << std::setprecision(0) << GetExecutionTime(events[n], PROF_US) << std::endl;
+	}
+	std::cout << "graph " << graph_time << " us, node by node with readbacks " << step_time << " us, outputs "
+		<< (correct ? "match" : "DO NOT MATCH") << std::endl;
+
+	//gamma 2.2, 5x5 Gaussian and gamma 1/2.2 with uchar intermediates and with float intermediates quantised
+	//only at the end, against the same chain in double precision on the host
+	FilterParams forward = params, inverse = params;
+	forward.gamma = 2.2f;
+	inverse.gamma = 1.0f / 2.2f;
+	FilterGraph chains[2] = { CreateGraph(width, height, channels), CreateGraph(width, height, channels) };
+	int chain_outputs[2];
+	for (int f = 0; f < 2; f++) {
+		int value = f ? AddConvert(chains[f], 0, PIXEL_FLOAT) : 0;
+		value = AddFilter(chains[f], FILTER_GAMMA, value, forward);
+		value = AddFilter(chains[f], FILTER_CONVOLUTION, value, forward);
+		value = AddFilter(chains[f], FILTER_GAMMA, value, inverse);
+		chain_outputs[f] = f ? AddConvert(chains[f], value, PIXEL_UCHAR) : value;
+		MarkOutput(chains[f], chain_outputs[f]);
+		PlanGraph(chains[f]);
+	}
+
+	int image_size = width * height, offset = params.mask_size / 2;
+	vector<double> linear(image.size()), exact(image.size());
+	for (size_t i = 0; i < image.size(); i++)
+		linear[i] = pow(image.data()[i] / 255.0, 2.2);
+	for (int c = 0; c < channels; c++)
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++) {
+				double sum = 0;
+				for (int j = -offset; j <= offset; j++)
+					for (int i = -offset; i <= offset; i++)
+						if (x + i >= 0 && x + i < width && y + j >= 0 && y + j < height)
+							sum += linear[c * image_size + (x + i) + (y + j) * width] * mask[(i + offset) + (j + offset) * params.mask_size];
+				exact[c * image_size + x + y * width] = pow(std::max(sum, 0.0), 1 / 2.2) * 255.0;
+			}
+
+	for (int f = 0; f < 2; f++) {
+		vector<cl::Buffer> chain_buffers = AllocateGraph(context, chains[f]);
+		std::map<int, vector<unsigned char> > chain_result;
+		vector<cl::Event> chain_events = RunGraph(queue, program, chains[f], dev_input, chain_buffers, chain_result);
+		const vector<unsigned char>& result = chain_result[chain_outputs[f]];
+		double max_error = 0, mean_error = 0;
+		for (size_t i = 0; i < result.size(); i++) {
+			double error = std::fabs(result[i] - exact[i]);
+			max_error = std::max(max_error, error);
+			mean_error += error / result.size();
+		}
+		std::cout << (f ? "float" : "uchar") << " intermediates: " << std::setprecision(0) << GetExecutionTime(chain_events, PROF_US) << " us, error max "
+			<< std::setprecision(2) << max_error << " mean " << mean_error << std::endl;
+	}
+}
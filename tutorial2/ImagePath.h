@@ -0,0 +1,197 @@
+#pragma once
+
+#include <array>
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Layout.h"
+#include "Sliding.h"
+
+//the filters of kernels/my_kernels.cl, available on both the buffer and the image path
+enum ImageFilter { FILTER_IDENTITY, FILTER_R, FILTER_INVERT, FILTER_GRAY, FILTER_GAMMA, FILTER_AVERAGE, FILTER_CONVOLUTION };
+
+const char* ImageFilterName(ImageFilter filter) {
+	static const char* names[] = { "identity", "filter_r", "invert", "rgb2gray", "gamma", "average", "convolution" };
+	return names[filter];
+}
+
+//parameters used by some of the filters
+struct FilterParams {
+	float gamma;
+	int range;		//average filter
+	cl::Buffer mask;	//convolution, mask_size^2 floats
+	int mask_size;
+};
+
+//neighbourhood radius of a filter, the image path clamps at the edges and the buffer path pads with zeros
+//so their results only agree further than this from the border
+int FilterRadius(ImageFilter filter, const FilterParams& params) {
+	if (filter == FILTER_AVERAGE) return params.range;
+	if (filter == FILTER_CONVOLUTION) return params.mask_size / 2;
+	return 0;
+}
+
+//RGBA8 for colour images, R8 for single channel ones
+cl::Image2D CreateImage2D(const cl::Context& context, cl_mem_flags flags, int width, int height, int channels) {
+	return cl::Image2D(context, flags, cl::ImageFormat(channels == 1 ? CL_R : CL_RGBA, CL_UNORM_INT8), width, height);
+}
+
+//planar image in a buffer -> image object; colour images go through an interleaved RGBA scratch buffer of 4*width*height bytes
+void PlanarToImage2D(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& planar, cl::Buffer& scratch,
+			cl::Image2D& image, int width, int height, int channels) {
+	std::array<size_t, 3> origin = { 0, 0, 0 }, region = { (size_t)width, (size_t)height, 1 };
+	if (channels == 1) {
+		queue.enqueueCopyBufferToImage(planar, image, 0, origin, region);
+		return;
+	}
+	PlanarToInterleaved(queue, program, planar, scratch, width * height, channels, 4);
+	queue.enqueueCopyBufferToImage(scratch, image, 0, origin, region);
+}
+
+//image object -> planar image in a buffer, the alpha channel is dropped
+void Image2DToPlanar(cl::CommandQueue& queue, cl::Program& program, const cl::Image2D& image, cl::Buffer& scratch,
+			cl::Buffer& planar, int width, int height, int channels) {
+	std::array<size_t, 3> origin = { 0, 0, 0 }, region = { (size_t)width, (size_t)height, 1 };
+	if (channels == 1) {
+		queue.enqueueCopyImageToBuffer(image, planar, origin, region, 0);
+		return;
+	}
+	queue.enqueueCopyImageToBuffer(image, scratch, origin, region, 0);
+	InterleavedToPlanar(queue, program, scratch, planar, width * height, 4, channels);
+}
+
+//runs a filter on image objects, one work-item per pixel
+cl::Event FilterImage2D(cl::CommandQueue& queue, cl::Program& program, ImageFilter filter, const cl::Image2D& A, cl::Image2D& B,
+			int width, int height, const FilterParams& params) {
+	static const char* kernels[] = { "image_identity", "image_filter_r", "image_invert", "image_rgb2gray", "image_gamma",
+		"image_avg_filter", "image_convolution" };
+	cl::Kernel kernel(program, kernels[filter]);
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	if (filter == FILTER_GAMMA)
+		kernel.setArg(2, params.gamma);
+	else if (filter == FILTER_AVERAGE)
+		kernel.setArg(2, params.range);
+	else if (filter == FILTER_CONVOLUTION) {
+		kernel.setArg(2, params.mask);
+		kernel.setArg(3, params.mask_size);
+	}
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(width, height), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//runs the original buffer kernel of a filter with the global size it reads its dimensions from
+//(large-radius averages go through the sliding-window filter instead, with identical results)
+cl::Event FilterBuffer(cl::CommandQueue& queue, cl::Program& program, ImageFilter filter, const cl::Buffer& A, cl::Buffer& B,
+			int width, int height, int channels, const FilterParams& params) {
+	if (filter == FILTER_AVERAGE && UseSlidingAverage(params.range, channels))
+		return AverageFilterSliding(queue, program, A, B, width, height, channels, params.range, false);
+	static const char* kernels[] = { "identity", "filter_r", "invert", "rgb2gray", "gamma_transform", "avg_filterND", "convolutionND" };
+	cl::Kernel kernel(program, kernels[filter]);
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	cl::NDRange global(width, height, channels);
+	if (filter == FILTER_IDENTITY || filter == FILTER_R)
+		global = cl::NDRange(width * height * channels);
+	else if (filter == FILTER_GRAY)
+		global = cl::NDRange(width, height);
+	else if (filter == FILTER_GAMMA) {
+		kernel.setArg(2, params.gamma);
+		global = cl::NDRange(width, height);
+	}
+	else if (filter == FILTER_AVERAGE)
+		kernel.setArg(2, params.range);
+	else if (filter == FILTER_CONVOLUTION) {
+		kernel.setArg(2, params.mask);
+		kernel.setArg(3, params.mask_size);
+	}
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//times every filter on the buffer and on the image path; the results are compared away from the border,
+//allowing 1 for the rounding of the normalised image values
+void BenchmarkImagePath(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	int image_size = width * height;
+
+	if (!context.getInfo<CL_CONTEXT_DEVICES>()[0].getInfo<CL_DEVICE_IMAGE_SUPPORT>()) {
+		std::cout << "The device does not support images" << std::endl;
+		return;
+	}
+	if (channels != 3) {
+		std::cout << "The buffer kernels expect an RGB image" << std::endl;
+		return;
+	}
+
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image.size());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_back(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_scratch(context, CL_MEM_READ_WRITE, image_size * 4);
+	cl::Image2D image_input = CreateImage2D(context, CL_MEM_READ_ONLY, width, height, channels);
+	cl::Image2D image_output = CreateImage2D(context, CL_MEM_READ_WRITE, width, height, channels);
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image.size(), image.data());
+	PlanarToImage2D(queue, program, dev_input, dev_scratch, image_input, width, height, channels);
+
+	FilterParams params;
+	params.gamma = 1.5f;
+	params.range = 4;
+	params.mask_size = 5;
+	vector<float> mask(params.mask_size * params.mask_size, 1.0f / (params.mask_size * params.mask_size));
+	params.mask = cl::Buffer(context, CL_MEM_READ_ONLY, mask.size() * sizeof(float));
+	queue.enqueueWriteBuffer(params.mask, CL_TRUE, 0, mask.size() * sizeof(float), &mask[0]);
+
+	vector<unsigned char> buffer_result(image.size()), image_result(image.size());
+
+	std::cout << "Buffer and image path on a " << width << "x" << height << "x" << channels << " image" << std::endl;
+	std::cout << std::setw(14) << std::left << "filter" << std::right << std::setw(14) << "buffer [us]" << std::setw(14) << "image [us]"
+		<< std::setw(10) << "speedup" << std::setw(10) << "max diff" << std::setw(8) << "check" << std::endl;
+
+	for (ImageFilter filter : { FILTER_IDENTITY, FILTER_R, FILTER_INVERT, FILTER_GRAY, FILTER_GAMMA, FILTER_AVERAGE, FILTER_CONVOLUTION }) {
+		cl::Event buffer_event = FilterBuffer(queue, program, filter, dev_input, dev_output, width, height, channels, params);
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &buffer_result[0]);
+
+		cl::Event image_event = FilterImage2D(queue, program, filter, image_input, image_output, width, height, params);
+		Image2DToPlanar(queue, program, image_output, dev_scratch, dev_back, width, height, channels);
+		queue.enqueueReadBuffer(dev_back, CL_TRUE, 0, image.size(), &image_result[0]);
+
+		int radius = FilterRadius(filter, params), max_diff = 0;
+		for (int c = 0; c < channels; c++)
+			for (int y = radius; y < height - radius; y++)
+				for (int x = radius; x < width - radius; x++) {
+					int i = c * image_size + y * width + x;
+					max_diff = std::max(max_diff, abs((int)buffer_result[i] - (int)image_result[i]));
+				}
+
+		double buffer_time = GetExecutionTime(buffer_event, PROF_US);
+		double image_time = GetExecutionTime(image_event, PROF_US);
+		std::cout << std::setw(14) << std::left << ImageFilterName(filter) << std::right << std::setw(14) << std::fixed << std::setprecision(0) << buffer_time
+			<< std::setw(14) << image_time << std::setw(10) << std::setprecision(2) << buffer_time / image_time
+			<< std::setw(10) << max_diff << std::setw(8) << (max_diff <= 1 ? "OK" : "FAILED") << std::endl;
+	}
+
+	//the conversion between the two paths is the price of using images in a buffer pipeline
+	cl::Event upload_event;
+	std::array<size_t, 3> origin = { 0, 0, 0 }, region = { (size_t)width, (size_t)height, 1 };
+	PlanarToInterleaved(queue, program, dev_input, dev_scratch, image_size, channels, 4);
+	queue.enqueueCopyBufferToImage(dev_scratch, image_input, 0, origin, region, NULL, &upload_event);
+	queue.finish();
+	std::cout << std::setw(14) << std::left << "buffer->image" << std::right << std::setw(14) << "-" << std::setw(14) << std::setprecision(0)
+		<< GetExecutionTime(upload_event, PROF_US) << std::endl;
+
+	//interpolation comes for free with the linear sampler
+	cl::Image2D image_half = CreateImage2D(context, CL_MEM_READ_WRITE, width / 2, height / 2, channels);
+	cl::Kernel resize(program, "image_resize");
+	resize.setArg(0, image_input);
+	resize.setArg(1, image_half);
+	cl::Event resize_event;
+	queue.enqueueNDRangeKernel(resize, cl::NullRange, cl::NDRange(width / 2, height / 2), cl::NullRange, NULL, &resize_event);
+	queue.finish();
+	std::cout << std::setw(14) << std::left << "resize 1/2" << std::right << std::setw(14) << "-" << std::setw(14)
+		<< GetExecutionTime(resize_event, PROF_US) << std::endl;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdlib>
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+
+//summed-area tables (kernels/integral.cl): built once in three launches, after which the sum of any
+//rectangle costs 4 reads, so a box filter costs the same for every radius where avg_filterND loops over
+//(2*range+1)^2 pixels per output
+
+struct IntegralImage {
+	int width, height, channels;
+	bool wide;		//ulong entries instead of uint, needed for rectangle sums of 2^32 or more
+	int block_size;		//pixels per work-group of the row scans
+	cl::Buffer sums;	//(width + 1) * (height + 1) entries per channel
+	cl::Buffer block_sums;
+};
+
+size_t IntegralEntrySize(const IntegralImage& integral) {
+	return integral.wide ? sizeof(cl_ulong) : sizeof(cl_uint);
+}
+
+string IntegralKernel(const string& name, const IntegralImage& integral) {
+	return name + (integral.wide ? "_ulong" : "_uint");
+}
+
+//allocates the table for an image, block_size is the work-group size of the row scans
+IntegralImage CreateIntegral(const cl::Context& context, int width, int height, int channels, bool wide = false, int block_size = 256) {
+	IntegralImage integral;
+	integral.width = width;
+	integral.height = height;
+	integral.channels = channels;
+	integral.wide = wide;
+	integral.block_size = block_size;
+	size_t blocks = (width + block_size - 1) / block_size;
+	integral.sums = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)(width + 1) * (height + 1) * channels * IntegralEntrySize(integral));
+	integral.block_sums = cl::Buffer(context, CL_MEM_READ_WRITE, blocks * height * channels * IntegralEntrySize(integral));
+	return integral;
+}
+
+//fills the table from the planar image A: scans of row blocks, scan of the block sums of every row,
+//then the block offsets are added while summing down the columns
+vector<cl::Event> ComputeIntegral(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, IntegralImage& integral) {
+	int width = integral.width, height = integral.height, channels = integral.channels, block_size = integral.block_size;
+	int blocks = (width + block_size - 1) / block_size;
+	vector<cl::Event> events(3);
+
+	cl::Kernel rows(program, IntegralKernel("integral_rows", integral).c_str());
+	rows.setArg(0, A);
+	rows.setArg(1, integral.sums);
+	rows.setArg(2, integral.block_sums);
+	rows.setArg(3, width);
+	rows.setArg(4, height);
+	rows.setArg(5, cl::Local(block_size * IntegralEntrySize(integral)));
+	rows.setArg(6, cl::Local(block_size * IntegralEntrySize(integral)));
+	queue.enqueueNDRangeKernel(rows, cl::NullRange, cl::NDRange(blocks * block_size, height, channels), cl::NDRange(block_size, 1, 1), NULL, &events[0]);
+
+	cl::Kernel block_scan(program, IntegralKernel("integral_block_scan", integral).c_str());
+	block_scan.setArg(0, integral.block_sums);
+	block_scan.setArg(1, blocks);
+	queue.enqueueNDRangeKernel(block_scan, cl::NullRange, cl::NDRange(height * channels), cl::NullRange, NULL, &events[1]);
+
+	cl::Kernel columns(program, IntegralKernel("integral_columns", integral).c_str());
+	columns.setArg(0, integral.sums);
+	columns.setArg(1, integral.block_sums);
+	columns.setArg(2, width);
+	columns.setArg(3, height);
+	columns.setArg(4, block_size);
+	queue.enqueueNDRangeKernel(columns, cl::NullRange, cl::NDRange(width + 1, channels), cl::NullRange, NULL, &events[2]);
+	return events;
+}
+
+//mean over a (2*range+1)^2 window, identical to avg_filterND with the same range
+cl::Event BoxFilterIntegral(cl::CommandQueue& queue, cl::Program& program, const IntegralImage& integral, cl::Buffer& B, int range) {
+	cl::Kernel kernel(program, IntegralKernel("box_filter_integral", integral).c_str());
+	kernel.setArg(0, integral.sums);
+	kernel.setArg(1, B);
+	kernel.setArg(2, range);
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(integral.width, integral.height, integral.channels), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//sums of count rectangles given as 4 ints (x, y, width, height) each, for every channel:
+//sums holds count * channels entries of the table's type, channel by channel
+cl::Event RectangleSums(cl::CommandQueue& queue, cl::Program& program, const IntegralImage& integral, const cl::Buffer& rects,
+			cl::Buffer& sums, int count) {
+	cl::Kernel kernel(program, IntegralKernel("integral_rect_sums", integral).c_str());
+	kernel.setArg(0, integral.sums);
+	kernel.setArg(1, rects);
+	kernel.setArg(2, sums);
+	kernel.setArg(3, integral.width);
+	kernel.setArg(4, integral.height);
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(count, integral.channels), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//builds the tables with both accumulator sizes, runs the box filter against avg_filterND over a range of
+//radii (identical output expected) and checks random rectangle sums against the host
+void BenchmarkIntegral(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image.size());
+	cl::Buffer dev_reference(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image.size());
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image.size(), image.data());
+	vector<unsigned char> reference(image.size()), output(image.size());
+
+	IntegralImage integral[2] = { CreateIntegral(context, width, height, channels, false), CreateIntegral(context, width, height, channels, true) };
+	std::cout << "Summed-area tables of a " << width << "x" << height << "x" << channels << " image" << std::endl;
+	for (IntegralImage& table : integral) {
+		vector<cl::Event> events = ComputeIntegral(queue, program, dev_input, table);
+		queue.finish();
+		std::cout << "  build (" << (table.wide ? "64" : "32") << "-bit): " << std::fixed << std::setprecision(0)
+			<< GetExecutionTime(events, PROF_US) << " us" << std::endl;
+	}
+
+	std::cout << std::setw(8) << "range" << std::setw(18) << "avg_filterND [us]" << std::setw(16) << "integral [us]" << std::setw(10) << "speedup"
+		<< std::setw(8) << "check" << std::endl;
+	for (int range : { 1, 2, 4, 8, 16, 32 }) {
+		cl::Kernel kernel(program, "avg_filterND");
+		kernel.setArg(0, dev_input);
+		kernel.setArg(1, dev_reference);
+		kernel.setArg(2, range);
+		cl::Event reference_event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &reference_event);
+		queue.enqueueReadBuffer(dev_reference, CL_TRUE, 0, image.size(), &reference[0]);
+
+		cl::Event prof_event = BoxFilterIntegral(queue, program, integral[0], dev_output, range);
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &output[0]);
+
+		double direct = GetExecutionTime(reference_event, PROF_US), table = GetExecutionTime(prof_event, PROF_US);
+		std::cout << std::setw(8) << range << std::setw(18) << std::setprecision(0) << direct << std::setw(16) << table
+			<< std::setw(10) << std::setprecision(2) << direct / table << std::setw(8) << (output == reference ? "OK" : "FAILED") << std::endl;
+	}
+
+	//random rectangles, including the whole image
+	int count = 4096;
+	vector<int> rects(4 * count);
+	srand(1);
+	for (int r = 0; r < count; r++) {
+		rects[4 * r] = r ? rand() % width : 0;
+		rects[4 * r + 1] = r ? rand() % height : 0;
+		rects[4 * r + 2] = r ? rand() % (width - rects[4 * r]) + 1 : width;
+		rects[4 * r + 3] = r ? rand() % (height - rects[4 * r + 1]) + 1 : height;
+	}
+	//reference sums from a table built on the host
+	vector<cl_ulong> host_sums((size_t)(width + 1) * (height + 1)), expected(count * channels);
+	for (int c = 0; c < channels; c++) {
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				host_sums[(x + 1) + (y + 1) * (width + 1)] = image(x, y, 0, c) + host_sums[x + (y + 1) * (width + 1)]
+					+ host_sums[(x + 1) + y * (width + 1)] - host_sums[x + y * (width + 1)];
+		for (int r = 0; r < count; r++) {
+			int x0 = rects[4 * r], y0 = rects[4 * r + 1], x1 = x0 + rects[4 * r + 2], y1 = y0 + rects[4 * r + 3];
+			expected[r + c * count] = host_sums[x1 + y1 * (width + 1)] - host_sums[x0 + y1 * (width + 1)]
+				- host_sums[x1 + y0 * (width + 1)] + host_sums[x0 + y0 * (width + 1)];
+		}
+	}
+
+	cl::Buffer dev_rects(context, CL_MEM_READ_ONLY, rects.size() * sizeof(int));
+	cl::Buffer dev_sums(context, CL_MEM_READ_WRITE, count * channels * sizeof(cl_ulong));
+	queue.enqueueWriteBuffer(dev_rects, CL_TRUE, 0, rects.size() * sizeof(int), &rects[0]);
+	for (IntegralImage& table : integral) {
+		cl::Event prof_event = RectangleSums(queue, program, table, dev_rects, dev_sums, count);
+		bool check = true;
+		if (table.wide) {
+			vector<cl_ulong> sums(count * channels);
+			queue.enqueueReadBuffer(dev_sums, CL_TRUE, 0, sums.size() * sizeof(cl_ulong), &sums[0]);
+			check = sums == expected;
+		}
+		else {
+			//32-bit sums are right modulo 2^32
+			vector<cl_uint> sums(count * channels);
+			queue.enqueueReadBuffer(dev_sums, CL_TRUE, 0, sums.size() * sizeof(cl_uint), &sums[0]);
+			for (size_t i = 0; i < sums.size(); i++)
+				check = check && sums[i] == (cl_uint)expected[i];
+		}
+		std::cout << "  " << count << " rectangle sums (" << (table.wide ? "64" : "32") << "-bit): " << std::setprecision(0)
+			<< GetExecutionTime(prof_event, PROF_US) << " us " << (check ? "OK" : "FAILED") << std::endl;
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "ImagePath.h"
+#include "Ppm.h"
+
+//the kernel of a filter on interleaved pixels of 3 (packed RGB) or 4 (RGBA) bytes with all its arguments set,
+//ready to be enqueued with global size (width, height) as often as needed
+cl::Kernel InterleavedKernel(cl::Program& program, ImageFilter filter, const cl::Buffer& A, cl::Buffer& B, int channels, const FilterParams& params) {
+	static const char* kernels[] = { "identity", "filter_r", "invert", "rgb2gray", "gamma_transform", "avg_filter", "convolution" };
+	cl::Kernel kernel(program, (string(kernels[filter]) + (channels == 4 ? "_uchar4" : "_uchar3")).c_str());
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	if (filter == FILTER_GAMMA)
+		kernel.setArg(2, params.gamma);
+	else if (filter == FILTER_AVERAGE)
+		kernel.setArg(2, params.range);
+	else if (filter == FILTER_CONVOLUTION) {
+		kernel.setArg(2, params.mask);
+		kernel.setArg(3, params.mask_size);
+	}
+	return kernel;
+}
+
+//runs a filter on interleaved pixels of 3 (packed RGB) or 4 (RGBA) bytes; large-radius averages of packed RGB
+//go through the sliding-window filter, which the stream and batch modes thereby use too
+cl::Event FilterInterleaved(cl::CommandQueue& queue, cl::Program& program, ImageFilter filter, const cl::Buffer& A, cl::Buffer& B,
+			int width, int height, int channels, const FilterParams& params) {
+	if (filter == FILTER_AVERAGE && UseSlidingAverage(params.range, channels))
+		return AverageFilterSliding(queue, program, A, B, width, height, channels, params.range, true);
+	cl::Kernel kernel = InterleavedKernel(program, filter, A, B, channels, params);
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(width, height), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//packed RGB -> RGBA on the device
+cl::Event RgbToRgba(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B, int image_size, unsigned char alpha = 255) {
+	cl::Kernel kernel(program, "rgb_to_rgba");
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, alpha);
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(image_size), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//every filter on the planar (CImg), packed RGB and RGBA layouts; the PPM file is uploaded as it is stored,
+//and the interleaved results are compared with the planar ones (allowing 1 for the float rounding of gamma)
+void BenchmarkInterleaved(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const string& image_filename,
+			const cimg_library::CImg<unsigned char>& image) {
+	PpmImage ppm = ReadPPM(image_filename);
+	int width = ppm.width, height = ppm.height, image_size = width * height;
+	if (ppm.channels != 3 || image.spectrum() != 3) {
+		std::cout << "The layout benchmark expects an RGB image" << std::endl;
+		return;
+	}
+
+	//the PPM payload is CImg's image with the channels interleaved
+	bool same = true;
+	for (int i = 0; i < image_size; i++)
+		for (int c = 0; c < 3; c++)
+			same = same && (ppm.data[i * 3 + c] == image.data()[c * image_size + i]);
+	std::cout << "PPM reader " << (same ? "matches" : "DOES NOT MATCH") << " CImg" << std::endl;
+
+	cl::Buffer dev_planar(context, CL_MEM_READ_ONLY, image.size());
+	cl::Buffer dev_rgb(context, CL_MEM_READ_ONLY, ppm.data.size());
+	cl::Buffer dev_rgba(context, CL_MEM_READ_ONLY, image_size * 4);
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image_size * 4);
+	queue.enqueueWriteBuffer(dev_planar, CL_TRUE, 0, image.size(), image.data());
+	queue.enqueueWriteBuffer(dev_rgb, CL_TRUE, 0, ppm.data.size(), &ppm.data[0]);
+	RgbToRgba(queue, program, dev_rgb, dev_rgba, image_size);
+
+	FilterParams params;
+	params.gamma = 1.5f;
+	params.range = 4;
+	params.mask_size = 5;
+	vector<float> mask(params.mask_size * params.mask_size, 1.0f / (params.mask_size * params.mask_size));
+	params.mask = cl::Buffer(context, CL_MEM_READ_ONLY, mask.size() * sizeof(float));
+	queue.enqueueWriteBuffer(params.mask, CL_TRUE, 0, mask.size() * sizeof(float), &mask[0]);
+
+	vector<unsigned char> planar(image.size()), interleaved(image_size * 4);
+
+	std::cout << "Pixel layouts on a " << width << "x" << height << " image" << std::endl;
+	std::cout << std::setw(14) << std::left << "filter" << std::right << std::setw(14) << "planar [us]" << std::setw(12) << "rgb [us]"
+		<< std::setw(12) << "rgba [us]" << std::setw(10) << "check" << std::endl;
+
+	for (ImageFilter filter : { FILTER_IDENTITY, FILTER_R, FILTER_INVERT, FILTER_GRAY, FILTER_GAMMA, FILTER_AVERAGE, FILTER_CONVOLUTION }) {
+		cl::Event planar_event = FilterBuffer(queue, program, filter, dev_planar, dev_output, width, height, 3, params);
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &planar[0]);
+		std::cout << std::setw(14) << std::left << ImageFilterName(filter) << std::right << std::setw(14) << std::fixed << std::setprecision(0)
+			<< GetExecutionTime(planar_event, PROF_US);
+
+		bool correct = true;
+		for (int channels : { 3, 4 }) {
+			cl::Event prof_event = FilterInterleaved(queue, program, filter, channels == 3 ? dev_rgb : dev_rgba, dev_output, width, height, channels, params);
+			queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image_size * channels, &interleaved[0]);
+			for (int i = 0; i < image_size; i++) {
+				for (int c = 0; c < 3; c++)
+					correct = correct && abs((int)interleaved[i * channels + c] - (int)planar[c * image_size + i]) <= 1;
+				if (channels == 4)
+					correct = correct && (interleaved[i * 4 + 3] == 255);
+			}
+			std::cout << std::setw(12) << GetExecutionTime(prof_event, PROF_US);
+		}
+		std::cout << std::setw(10) << (correct ? "OK" : "FAILED") << std::endl;
+	}
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+
+//pixel arrangements used by the image code: CImg keeps every channel in its own plane, PPM files
+//and most other libraries store the channels of a pixel next to each other
+enum ImageLayout {
+	LAYOUT_PLANAR,		//c*image_size + x + y*width
+	LAYOUT_INTERLEAVED	//(x + y*width)*channels + c
+};
+
+//suffix of the typed kernels in kernels/layout.cl
+template <typename T> const char* LayoutTypeName();
+template <> const char* LayoutTypeName<unsigned char>() { return "uchar"; }
+template <> const char* LayoutTypeName<float>() { return "float"; }
+
+//transpose planes of width x height elements (e.g. each channel of a planar image) into height x width planes
+template <typename T>
+cl::Event Transpose2D(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B,
+			int width, int height, int planes = 1, int tile = 16) {
+	cl::Kernel kernel(program, (string("transpose_") + LayoutTypeName<T>()).c_str());
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, width);
+	kernel.setArg(3, height);
+	kernel.setArg(4, cl::Local(tile * (tile + 1) * sizeof(T)));
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange,
+		cl::NDRange((width + tile - 1) / tile * tile, (height + tile - 1) / tile * tile, planes),
+		cl::NDRange(tile, tile, 1), NULL, &prof_event);
+	return prof_event;
+}
+
+//planar image of channels_in planes into interleaved pixels of channels_out values (1 to 4)
+//extra output channels are set to fill, e.g. an opaque alpha for RGB -> RGBA
+cl::Event PlanarToInterleaved(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B,
+			int image_size, int channels_in, int channels_out, unsigned char fill = 255) {
+	cl::Kernel kernel(program, "planar_to_interleaved");
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, channels_in);
+	kernel.setArg(3, channels_out);
+	kernel.setArg(4, fill);
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(image_size), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//interleaved pixels of channels_in values into channels_out planes, surplus input channels are dropped
+cl::Event InterleavedToPlanar(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B,
+			int image_size, int channels_in, int channels_out, unsigned char fill = 255) {
+	cl::Kernel kernel(program, "interleaved_to_planar");
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, channels_in);
+	kernel.setArg(3, channels_out);
+	kernel.setArg(4, fill);
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(image_size), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//permute the axes of a row-major array of up to 8 dimensions: output axis d is input axis perm[d]
+//e.g. dims = {channels, height, width} with perm = {1, 2, 0} turns a planar image into an interleaved one
+template <typename T>
+cl::Event PermuteAxes(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B,
+			const vector<int>& dims, const vector<int>& perm) {
+	int ndims = (int)dims.size();
+	if (ndims < 1 || ndims > 8 || (int)perm.size() != ndims)
+		throw cl::Error(CL_INVALID_VALUE, "PermuteAxes: 1 to 8 axes with a matching permutation expected");
+	//every axis exactly once, a repeated axis would read past the input
+	vector<bool> used(ndims, false);
+	for (int axis : perm) {
+		if (axis < 0 || axis >= ndims || used[axis])
+			throw cl::Error(CL_INVALID_VALUE, "PermuteAxes: perm has to be a permutation of 0..ndims-1");
+		used[axis] = true;
+	}
+
+	cl_int in_strides[8], out_dims[8] = { 1, 1, 1, 1, 1, 1, 1, 1 }, perm_strides[8] = { 0 };
+	int elements = 1;
+	for (int d = ndims - 1; d >= 0; d--) {
+		in_strides[d] = elements;
+		elements *= dims[d];
+	}
+	for (int d = 0; d < ndims; d++) {
+		out_dims[d] = dims[perm[d]];
+		perm_strides[d] = in_strides[perm[d]];
+	}
+
+	//the shape travels as two int8 arguments, so there is no extra buffer to keep alive
+	cl::Kernel kernel(program, (string("permute_") + LayoutTypeName<T>()).c_str());
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, sizeof(out_dims), out_dims);
+	kernel.setArg(3, sizeof(perm_strides), perm_strides);
+	kernel.setArg(4, ndims);
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(elements), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+void PrintLayoutResult(const string& name, const cl::Event& prof_event, size_t bytes, bool correct) {
+	double seconds = GetExecutionTime(prof_event, PROF_NS) / 1e9;
+	std::cout << std::setw(34) << std::left << name << std::right << std::setw(12) << (int)(seconds * 1e6)
+		<< std::setw(10) << std::fixed << std::setprecision(2) << (2.0 * bytes / seconds / 1e9) << std::setw(8) << (correct ? "OK" : "FAILED") << std::endl;
+}
+
+//times every layout kernel on the input image (and a square float matrix) and checks the results on the host
+void BenchmarkLayout(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width();
+	int height = image.height();
+	int channels = image.spectrum();
+	int image_size = width * height;
+	size_t max_group = context.getInfo<CL_CONTEXT_DEVICES>()[0].getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+
+	vector<unsigned char> planar(image.data(), image.data() + image.size());
+	vector<unsigned char> result(image_size * 4);
+
+	cl::Buffer dev_planar(context, CL_MEM_READ_WRITE, image_size * 4);
+	cl::Buffer dev_result(context, CL_MEM_READ_WRITE, image_size * 4);
+	cl::Buffer dev_back(context, CL_MEM_READ_WRITE, image_size * 4);
+	queue.enqueueWriteBuffer(dev_planar, CL_TRUE, 0, planar.size(), &planar[0]);
+
+	std::cout << "Layout conversions on a " << width << "x" << height << "x" << channels << " image" << std::endl;
+	std::cout << std::setw(34) << std::left << "kernel" << std::right << std::setw(12) << "time [us]" << std::setw(10) << "GB/s" << std::setw(8) << "check" << std::endl;
+
+	//per-channel transpose with different tile sizes
+	for (int tile : { 8, 16, 32 }) {
+		if ((size_t)(tile * tile) > max_group)
+			continue;
+		cl::Event prof_event = Transpose2D<unsigned char>(queue, program, dev_planar, dev_result, width, height, channels, tile);
+		queue.enqueueReadBuffer(dev_result, CL_TRUE, 0, planar.size(), &result[0]);
+
+		bool correct = true;
+		for (int c = 0; c < channels; c++)
+			for (int y = 0; y < height; y++)
+				for (int x = 0; x < width; x++)
+					if (result[c * image_size + x * height + y] != planar[c * image_size + y * width + x])
+						correct = false;
+
+		PrintLayoutResult("transpose_uchar tile " + std::to_string(tile), prof_event, planar.size(), correct);
+	}
+
+	//planar -> interleaved with the same and with an added alpha channel, and back
+	for (int channels_out : { channels, 4 }) {
+		if (channels_out < channels)
+			continue;
+		cl::Event prof_event = PlanarToInterleaved(queue, program, dev_planar, dev_result, image_size, channels, channels_out);
+		queue.enqueueReadBuffer(dev_result, CL_TRUE, 0, image_size * channels_out, &result[0]);
+
+		bool correct = true;
+		for (int i = 0; i < image_size; i++)
+			for (int c = 0; c < channels_out; c++)
+				if (result[i * channels_out + c] != (c < channels ? planar[c * image_size + i] : 255))
+					correct = false;
+		PrintLayoutResult("planar_to_interleaved " + std::to_string(channels) + "->" + std::to_string(channels_out),
+			prof_event, image_size * (channels + channels_out) / 2, correct);
+
+		prof_event = InterleavedToPlanar(queue, program, dev_result, dev_back, image_size, channels_out, channels);
+		queue.enqueueReadBuffer(dev_back, CL_TRUE, 0, planar.size(), &result[0]);
+		correct = std::equal(planar.begin(), planar.end(), result.begin());
+		PrintLayoutResult("interleaved_to_planar " + std::to_string(channels_out) + "->" + std::to_string(channels),
+			prof_event, image_size * (channels + channels_out) / 2, correct);
+	}
+
+	//the same planar -> interleaved conversion expressed as an axis permutation (C,H,W) -> (H,W,C)
+	{
+		cl::Event prof_event = PermuteAxes<unsigned char>(queue, program, dev_planar, dev_result, { channels, height, width }, { 1, 2, 0 });
+		queue.enqueueReadBuffer(dev_result, CL_TRUE, 0, planar.size(), &result[0]);
+		bool correct = true;
+		for (int i = 0; i < image_size; i++)
+			for (int c = 0; c < channels; c++)
+				if (result[i * channels + c] != planar[c * image_size + i])
+					correct = false;
+		PrintLayoutResult("permute_uchar (C,H,W)->(H,W,C)", prof_event, planar.size(), correct);
+	}
+
+	//numeric data: a square float matrix
+	int n = 4096;
+	vector<float> matrix(n * n), transposed(n * n);
+	for (size_t i = 0; i < matrix.size(); i++)
+		matrix[i] = (float)i;
+	cl::Buffer dev_matrix(context, CL_MEM_READ_ONLY, matrix.size() * sizeof(float));
+	cl::Buffer dev_transposed(context, CL_MEM_READ_WRITE, matrix.size() * sizeof(float));
+	queue.enqueueWriteBuffer(dev_matrix, CL_TRUE, 0, matrix.size() * sizeof(float), &matrix[0]);
+
+	for (int tile : { 8, 16, 32 }) {
+		if ((size_t)(tile * tile) > max_group)
+			continue;
+		cl::Event prof_event = Transpose2D<float>(queue, program, dev_matrix, dev_transposed, n, n, 1, tile);
+		queue.enqueueReadBuffer(dev_transposed, CL_TRUE, 0, transposed.size() * sizeof(float), &transposed[0]);
+		bool correct = true;
+		for (int y = 0; y < n; y++)
+			for (int x = 0; x < n; x++)
+				if (transposed[x * n + y] != matrix[y * n + x])
+					correct = false;
+		PrintLayoutResult("transpose_float 4096^2 tile " + std::to_string(tile), prof_event, matrix.size() * sizeof(float), correct);
+	}
+
+	{
+		cl::Event prof_event = PermuteAxes<float>(queue, program, dev_matrix, dev_transposed, { n, n }, { 1, 0 });
+		queue.enqueueReadBuffer(dev_transposed, CL_TRUE, 0, transposed.size() * sizeof(float), &transposed[0]);
+		bool correct = true;
+		for (int y = 0; y < n; y++)
+			for (int x = 0; x < n; x++)
+				if (transposed[x * n + y] != matrix[y * n + x])
+					correct = false;
+		PrintLayoutResult("permute_float 4096^2 (1,0)", prof_event, matrix.size() * sizeof(float), correct);
+	}
+}
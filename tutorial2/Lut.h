@@ -0,0 +1,225 @@
+#pragma once
+
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+#include "ImagePath.h"
+
+//tone curves as lookup tables: gamma_transform evaluates pow() for every channel of every pixel although an
+//8-bit sample has only 256 different values; a table is built once on the device (256 entries for 8-bit,
+//65536 for 16-bit samples) and applied with one gather per sample
+//tables compose, so a chain of tone operations costs a single pass over the image
+
+//the operations of lut_build in kernels/lut.cl
+enum LutOp { LUT_GAMMA, LUT_CONTRAST, LUT_BRIGHTNESS, LUT_LEVELS, LUT_CURVE };
+
+const char* LutOpName(LutOp op) {
+	static const char* names[] = { "gamma", "contrast", "brightness", "levels", "curve" };
+	return names[op];
+}
+
+//one tone operation on values normalised to 0..1, see lut_build for the meaning of the parameters
+struct ToneOp {
+	LutOp op;
+	float a, b, c, d, e;
+	vector<float> points;	//curve: x0, y0, x1, y1, ... with increasing x
+};
+
+ToneOp GammaOp(float gamma) {
+	return ToneOp{ LUT_GAMMA, gamma, 0, 0, 0, 0, {} };
+}
+
+//scales the distance from mid grey
+ToneOp ContrastOp(float contrast) {
+	return ToneOp{ LUT_CONTRAST, contrast, 0, 0, 0, 0, {} };
+}
+
+//adds an offset, e.g. 0.1 is +25.5 for 8-bit samples
+ToneOp BrightnessOp(float offset) {
+	return ToneOp{ LUT_BRIGHTNESS, offset, 0, 0, 0, 0, {} };
+}
+
+//maps in_black..in_white to out_black..out_white through a midtone gamma, like the levels tool of image editors
+ToneOp LevelsOp(float in_black, float in_white, float gamma = 1.0f, float out_black = 0.0f, float out_white = 1.0f) {
+	if (in_white == in_black || gamma <= 0.0f)
+		throw cl::Error(CL_INVALID_VALUE, "LevelsOp: the input range has to be non-empty and the gamma positive");
+	return ToneOp{ LUT_LEVELS, in_black, in_white, gamma, out_black, out_white, {} };
+}
+
+//piecewise linear curve through control points
+ToneOp CurveOp(const vector<float>& points) {
+	if (points.size() < 4 || points.size() % 2)
+		throw cl::Error(CL_INVALID_VALUE, "CurveOp: at least two (x, y) points are needed");
+	return ToneOp{ LUT_CURVE, 0, 0, 0, 0, 0, points };
+}
+
+//a table on the device: 256 uchar entries or 65536 ushort entries
+struct DeviceLut {
+	int entries;
+	cl::Buffer table;
+};
+
+const char* LutType(int entries) {
+	if (entries != 256 && entries != 65536)
+		throw cl::Error(CL_INVALID_VALUE, "LUTs have 256 or 65536 entries");
+	return entries == 256 ? "uchar" : "ushort";
+}
+
+size_t LutBytes(int entries) {
+	return entries == 256 ? 256 : 65536 * sizeof(cl_ushort);
+}
+
+//evaluates a tone operation into a new table
+DeviceLut BuildLut(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const ToneOp& tone, int entries = 256) {
+	DeviceLut lut{ entries, cl::Buffer(context, CL_MEM_READ_WRITE, LutBytes(entries)) };
+
+	//the curve points are always passed, a single dummy point for the other operations
+	vector<float> points = tone.points.empty() ? vector<float>(2, 0.0f) : tone.points;
+	cl::Buffer dev_points(context, CL_MEM_READ_ONLY, points.size() * sizeof(float));
+	//blocking, points goes out of scope before the kernel has run
+	queue.enqueueWriteBuffer(dev_points, CL_TRUE, 0, points.size() * sizeof(float), &points[0]);
+
+	cl::Kernel kernel(program, (string("lut_build_") + LutType(entries)).c_str());
+	kernel.setArg(0, lut.table);
+	kernel.setArg(1, (int)tone.op);
+	kernel.setArg(2, tone.a);
+	kernel.setArg(3, tone.b);
+	kernel.setArg(4, tone.c);
+	kernel.setArg(5, tone.d);
+	kernel.setArg(6, tone.e);
+	kernel.setArg(7, dev_points);
+	kernel.setArg(8, (int)points.size() / 2);
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(entries), cl::NullRange);
+	return lut;
+}
+
+//the table applying first and then second
+DeviceLut ComposeLut(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const DeviceLut& first, const DeviceLut& second) {
+	if (first.entries != second.entries)
+		throw cl::Error(CL_INVALID_VALUE, "ComposeLut: the tables have different sizes");
+	DeviceLut lut{ first.entries, cl::Buffer(context, CL_MEM_READ_WRITE, LutBytes(first.entries)) };
+
+	cl::Kernel kernel(program, (string("lut_compose_") + LutType(first.entries)).c_str());
+	kernel.setArg(0, first.table);
+	kernel.setArg(1, second.table);
+	kernel.setArg(2, lut.table);
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(first.entries), cl::NullRange);
+	return lut;
+}
+
+//one table for a chain of tone operations applied in order
+DeviceLut BuildLut(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const vector<ToneOp>& tones, int entries = 256) {
+	if (tones.empty())
+		throw cl::Error(CL_INVALID_VALUE, "BuildLut: no tone operations");
+	DeviceLut lut = BuildLut(context, queue, program, tones[0], entries);
+	for (size_t t = 1; t < tones.size(); t++)
+		lut = ComposeLut(context, queue, program, lut, BuildLut(context, queue, program, tones[t], entries));
+	return lut;
+}
+
+//where the work-items read a 256-entry table from
+enum LutMemory { LUT_MEMORY_CONSTANT, LUT_MEMORY_LOCAL };
+
+//applies the table to samples values of A (any layout and number of channels), the result goes to B
+//16-bit tables are read from global memory whatever memory is requested
+cl::Event ApplyLut(cl::CommandQueue& queue, cl::Program& program, const DeviceLut& lut, const cl::Buffer& A, cl::Buffer& B,
+			size_t samples, LutMemory memory = LUT_MEMORY_CONSTANT) {
+	cl::Kernel kernel;
+	if (lut.entries == 65536)
+		kernel = cl::Kernel(program, "lut_apply_ushort");
+	else if (memory == LUT_MEMORY_LOCAL)
+		kernel = cl::Kernel(program, "lut_apply_local");
+	else
+		kernel = cl::Kernel(program, "lut_apply_constant");
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, lut.table);
+	if (lut.entries == 256 && memory == LUT_MEMORY_LOCAL)
+		kernel.setArg(3, cl::Local(256));
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(samples), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//the table of gamma_transform, applying it gives exactly the same image
+DeviceLut GammaLut(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, float gamma) {
+	return BuildLut(context, queue, program, GammaOp(gamma));
+}
+
+//gamma_transform against its table, a chain of tone operations one table at a time against the composed
+//table, and a 16-bit table against the same table applied on the host
+void BenchmarkLut(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width(), height = image.height();
+	if (image.spectrum() != 3) {
+		std::cout << "The LUT benchmark expects an RGB image" << std::endl;
+		return;
+	}
+
+	FilterParams params;
+	params.gamma = 1.5f;
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image.size());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_temp[2] = { cl::Buffer(context, CL_MEM_READ_WRITE, image.size()), cl::Buffer(context, CL_MEM_READ_WRITE, image.size()) };
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image.size(), image.data());
+	vector<unsigned char> reference(image.size()), output(image.size());
+
+	std::cout << "Tone curves as lookup tables on a " << width << "x" << height << " image" << std::endl;
+	std::cout << std::setw(40) << std::left << "method" << std::right << std::setw(10) << "launches" << std::setw(14) << "time [us]"
+		<< std::setw(8) << "check" << std::endl;
+	auto report = [&](const string& name, const vector<cl::Event>& events, bool check) {
+		std::cout << std::setw(40) << std::left << name << std::right << std::setw(10) << events.size() << std::setw(14) << std::fixed
+			<< std::setprecision(0) << GetExecutionTime(events, PROF_US) << std::setw(8) << (check ? "OK" : "FAILED") << std::endl;
+	};
+
+	//gamma: pow() per sample against the table in constant and local memory
+	cl::Event prof_event = FilterBuffer(queue, program, FILTER_GAMMA, dev_input, dev_output, width, height, 3, params);
+	queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &reference[0]);
+	report("gamma_transform", { prof_event }, true);
+
+	DeviceLut gamma = GammaLut(context, queue, program, params.gamma);
+	const LutMemory memories[] = { LUT_MEMORY_CONSTANT, LUT_MEMORY_LOCAL };
+	const char* memory_names[] = { "gamma LUT (constant)", "gamma LUT (local)" };
+	for (int m = 0; m < 2; m++) {
+		prof_event = ApplyLut(queue, program, gamma, dev_input, dev_output, image.size(), memories[m]);
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &output[0]);
+		report(memory_names[m], { prof_event }, output == reference);
+	}
+
+	//a chain of tone operations, one table per operation against the composed table
+	vector<ToneOp> tones = { LevelsOp(0.05f, 0.95f, 1.2f), ContrastOp(1.3f), BrightnessOp(-0.05f), GammaOp(0.8f),
+		CurveOp({ 0.0f, 0.0f, 0.25f, 0.2f, 0.75f, 0.85f, 1.0f, 1.0f }) };
+	vector<cl::Event> separate_events;
+	const cl::Buffer* input = &dev_input;
+	for (size_t t = 0; t < tones.size(); t++) {
+		DeviceLut lut = BuildLut(context, queue, program, tones[t]);
+		separate_events.push_back(ApplyLut(queue, program, lut, *input, dev_temp[t % 2], image.size()));
+		input = &dev_temp[t % 2];
+	}
+	queue.enqueueReadBuffer(*input, CL_TRUE, 0, image.size(), &reference[0]);
+	report("levels,contrast,brightness,gamma,curve", separate_events, true);
+
+	DeviceLut chain = BuildLut(context, queue, program, tones);
+	prof_event = ApplyLut(queue, program, chain, dev_input, dev_output, image.size());
+	queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &output[0]);
+	report("composed", { prof_event }, output == reference);
+
+	//16-bit samples: the image scaled to 0..65535 through a 65536-entry table
+	vector<cl_ushort> samples(image.size()), samples_output(image.size()), table(65536);
+	for (size_t i = 0; i < samples.size(); i++)
+		samples[i] = image.data()[i] * 257;
+	cl::Buffer dev_samples(context, CL_MEM_READ_ONLY, samples.size() * sizeof(cl_ushort));
+	cl::Buffer dev_samples_output(context, CL_MEM_READ_WRITE, samples.size() * sizeof(cl_ushort));
+	queue.enqueueWriteBuffer(dev_samples, CL_TRUE, 0, samples.size() * sizeof(cl_ushort), &samples[0]);
+
+	DeviceLut chain16 = BuildLut(context, queue, program, tones, 65536);
+	prof_event = ApplyLut(queue, program, chain16, dev_samples, dev_samples_output, samples.size());
+	queue.enqueueReadBuffer(dev_samples_output, CL_TRUE, 0, samples.size() * sizeof(cl_ushort), &samples_output[0]);
+	queue.enqueueReadBuffer(chain16.table, CL_TRUE, 0, table.size() * sizeof(cl_ushort), &table[0]);
+	bool check = true;
+	for (size_t i = 0; i < samples.size(); i++)
+		check = check && samples_output[i] == table[samples[i]];
+	report("composed, 16-bit", { prof_event }, check);
+}
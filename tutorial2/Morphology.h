@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+
+//non-linear filters (kernels/morphology.cl): median and rank filters for denoising, and erosion, dilation,
+//opening and closing with rectangular structuring elements
+
+//work-items per work-group of the sliding histogram, each one keeps a 256 bin histogram in local memory
+const int RANK_LOCAL_SIZE = 32;
+const int RANK_SEGMENT = 64;
+
+//value of the given rank in the (2*range+1)^2 window of every pixel (0 is the minimum), edges replicated
+cl::Event RankFilter(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B,
+			int width, int height, int channels, int range, int rank) {
+	int window = 2 * range + 1;
+	if (range < 0 || range > 127 || rank < 0 || rank >= window * window)
+		throw cl::Error(CL_INVALID_VALUE, "RankFilter: the range has to be at most 127 and the rank inside the window");
+
+	int segments = (width + RANK_SEGMENT - 1) / RANK_SEGMENT;
+	cl::Kernel kernel(program, "rank_histogram");
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, range);
+	kernel.setArg(3, rank);
+	kernel.setArg(4, width);
+	kernel.setArg(5, height);
+	kernel.setArg(6, RANK_SEGMENT);
+	kernel.setArg(7, cl::Local(RANK_LOCAL_SIZE * 256 * sizeof(cl_ushort)));
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange((segments + RANK_LOCAL_SIZE - 1) / RANK_LOCAL_SIZE * RANK_LOCAL_SIZE, height, channels),
+		cl::NDRange(RANK_LOCAL_SIZE, 1, 1), NULL, &prof_event);
+	return prof_event;
+}
+
+//median over a (2*range+1)^2 window: selection networks for 3x3 and 5x5, the sliding histogram otherwise
+//or if histogram is set
+cl::Event MedianFilter(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B,
+			int width, int height, int channels, int range, bool histogram = false) {
+	if (histogram || (range != 1 && range != 2)) {
+		int window = 2 * range + 1;
+		return RankFilter(queue, program, A, B, width, height, channels, range, window * window / 2);
+	}
+
+	cl::Kernel kernel(program, range == 1 ? "median3x3" : "median5x5");
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+enum MorphOp { MORPH_ERODE, MORPH_DILATE, MORPH_OPEN, MORPH_CLOSE };
+
+const char* MorphOpName(MorphOp op) {
+	static const char* names[] = { "erode", "dilate", "open", "close" };
+	return names[op];
+}
+
+//erosion or dilation as a row pass from A into temp and a column pass from temp into B
+void EnqueueMorph(cl::CommandQueue& queue, cl::Program& program, bool erode, const cl::Buffer& A, cl::Buffer& temp, cl::Buffer& B,
+			int width, int height, int channels, int range_x, int range_y, vector<cl::Event>& events) {
+	cl::Kernel rows(program, "morph_rows");
+	rows.setArg(0, A);
+	rows.setArg(1, temp);
+	rows.setArg(2, range_x);
+	rows.setArg(3, width);
+	rows.setArg(4, height);
+	rows.setArg(5, (int)erode);
+	events.push_back(cl::Event());
+	queue.enqueueNDRangeKernel(rows, cl::NullRange, cl::NDRange((width + 2 * range_x) / (2 * range_x + 1), height, channels), cl::NullRange, NULL, &events.back());
+
+	cl::Kernel columns(program, "morph_columns");
+	columns.setArg(0, temp);
+	columns.setArg(1, B);
+	columns.setArg(2, range_y);
+	columns.setArg(3, width);
+	columns.setArg(4, height);
+	columns.setArg(5, (int)erode);
+	events.push_back(cl::Event());
+	queue.enqueueNDRangeKernel(columns, cl::NullRange, cl::NDRange(width, (height + 2 * range_y) / (2 * range_y + 1), channels), cl::NullRange, NULL, &events.back());
+}
+
+//morphological operation with a (2*range_x+1)x(2*range_y+1) rectangle, pixels outside the image are ignored
+//the cost per pixel does not depend on the size of the rectangle; temp is a buffer of the image size
+vector<cl::Event> Morphology(cl::CommandQueue& queue, cl::Program& program, MorphOp op, const cl::Buffer& A, cl::Buffer& temp, cl::Buffer& B,
+			int width, int height, int channels, int range_x, int range_y) {
+	vector<cl::Event> events;
+	bool erode_first = op == MORPH_ERODE || op == MORPH_OPEN;
+	EnqueueMorph(queue, program, erode_first, A, temp, B, width, height, channels, range_x, range_y, events);
+	if (op == MORPH_OPEN || op == MORPH_CLOSE)
+		EnqueueMorph(queue, program, !erode_first, B, temp, B, width, height, channels, range_x, range_y, events);
+	return events;
+}
+
+//the selection networks against the host and the sliding histogram, and van Herk/Gil-Werman against the
+//direct window for growing rectangles
+void BenchmarkMorphology(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image.size());
+	cl::Buffer dev_reference(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_temp(context, CL_MEM_READ_WRITE, image.size());
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image.size(), image.data());
+	vector<unsigned char> reference(image.size()), output(image.size());
+
+	std::cout << "Median filter on a " << width << "x" << height << "x" << channels << " image" << std::endl;
+	std::cout << std::setw(8) << "window" << std::setw(16) << "network [us]" << std::setw(18) << "histogram [us]" << std::setw(8) << "check" << std::endl;
+	for (int range : { 1, 2, 4, 8, 16 }) {
+		int window = 2 * range + 1;
+		bool check = true;
+		double network = 0;
+		if (range <= 2) {
+			//exact median of the clamped window on the host
+			cl::Event prof_event = MedianFilter(queue, program, dev_input, dev_reference, width, height, channels, range);
+			queue.enqueueReadBuffer(dev_reference, CL_TRUE, 0, image.size(), &reference[0]);
+			network = GetExecutionTime(prof_event, PROF_US);
+			vector<unsigned char> values(window * window);
+			for (int c = 0; c < channels && check; c++)
+				for (int y = 0; y < height && check; y++)
+					for (int x = 0; x < width && check; x++) {
+						for (int j = -range; j <= range; j++)
+							for (int i = -range; i <= range; i++)
+								values[(i + range) + (j + range) * window] = image(std::min(std::max(x + i, 0), width - 1), std::min(std::max(y + j, 0), height - 1), 0, c);
+						std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+						check = reference[x + y * width + c * width * height] == values[values.size() / 2];
+					}
+		}
+
+		cl::Event prof_event = MedianFilter(queue, program, dev_input, dev_output, width, height, channels, range, true);
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &output[0]);
+		if (range <= 2)
+			check = check && output == reference;
+
+		std::cout << std::setw(8) << (std::to_string(window) + "x" + std::to_string(window)) << std::setw(16) << std::fixed << std::setprecision(0);
+		if (range <= 2)
+			std::cout << network;
+		else
+			std::cout << "-";
+		std::cout << std::setw(18) << GetExecutionTime(prof_event, PROF_US) << std::setw(8) << (range <= 2 ? (check ? "OK" : "FAILED") : "-") << std::endl;
+	}
+
+	std::cout << "Morphology" << std::endl;
+	std::cout << std::setw(8) << "op" << std::setw(10) << "window" << std::setw(14) << "direct [us]" << std::setw(16) << "vHGW [us]"
+		<< std::setw(10) << "speedup" << std::setw(8) << "check" << std::endl;
+	for (MorphOp op : { MORPH_ERODE, MORPH_DILATE }) {
+		for (int range : { 1, 3, 7, 15, 31 }) {
+			cl::Kernel kernel(program, "morph_direct");
+			kernel.setArg(0, dev_input);
+			kernel.setArg(1, dev_reference);
+			kernel.setArg(2, range);
+			kernel.setArg(3, range);
+			kernel.setArg(4, (int)(op == MORPH_ERODE));
+			cl::Event reference_event;
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &reference_event);
+			queue.enqueueReadBuffer(dev_reference, CL_TRUE, 0, image.size(), &reference[0]);
+
+			vector<cl::Event> events = Morphology(queue, program, op, dev_input, dev_temp, dev_output, width, height, channels, range, range);
+			queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &output[0]);
+
+			double direct = GetExecutionTime(reference_event, PROF_US), vhgw = GetExecutionTime(events, PROF_US);
+			std::cout << std::setw(8) << MorphOpName(op) << std::setw(10) << (std::to_string(2 * range + 1) + "x" + std::to_string(2 * range + 1))
+				<< std::setw(14) << std::setprecision(0) << direct << std::setw(16) << vhgw << std::setw(10) << std::setprecision(2)
+				<< direct / vhgw << std::setw(8) << (output == reference ? "OK" : "FAILED") << std::endl;
+		}
+	}
+
+	//opening and closing are idempotent, applying them twice must not change the result
+	for (MorphOp op : { MORPH_OPEN, MORPH_CLOSE }) {
+		vector<cl::Event> events = Morphology(queue, program, op, dev_input, dev_temp, dev_reference, width, height, channels, 7, 3);
+		Morphology(queue, program, op, dev_reference, dev_temp, dev_output, width, height, channels, 7, 3);
+		queue.enqueueReadBuffer(dev_reference, CL_TRUE, 0, image.size(), &reference[0]);
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &output[0]);
+		std::cout << std::setw(8) << MorphOpName(op) << std::setw(10) << "15x7" << std::setw(14) << "-" << std::setw(16) << std::setprecision(0)
+			<< GetExecutionTime(events, PROF_US) << std::setw(10) << "-" << std::setw(8) << (output == reference ? "OK" : "FAILED") << std::endl;
+	}
+}
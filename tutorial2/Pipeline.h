@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "Utils.h"
+#include "Interleaved.h"
+#include "Ppm.h"
+
+//headless batch processing: every image passes through
+//  read (disk -> pinned host memory) -> upload -> kernel chain -> download -> write (pinned host memory -> disk)
+//with a bounded queue between consecutive stages, so all stages work on different images at the same time
+//images travel as indices of slots, each slot owns a pinned host buffer and two device buffers that are
+//reused for every image it carries; the number of slots bounds the images in flight
+
+//FIFO with a fixed capacity: Push blocks while it is full, Pop blocks while it is empty and returns
+//false once the queue is closed and drained
+template <typename T>
+class BoundedQueue {
+public:
+	BoundedQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+	void Push(const T& item) {
+		std::unique_lock<std::mutex> lock(mutex);
+		not_full.wait(lock, [this]() { return items.size() < capacity; });
+		items.push_back(item);
+		not_empty.notify_one();
+	}
+
+	bool Pop(T& item) {
+		std::unique_lock<std::mutex> lock(mutex);
+		not_empty.wait(lock, [this]() { return !items.empty() || closed; });
+		if (items.empty())
+			return false;
+		item = items.front();
+		items.pop_front();
+		not_full.notify_one();
+		return true;
+	}
+
+	void Close() {
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		not_empty.notify_all();
+	}
+
+private:
+	size_t capacity;
+	bool closed;
+	std::deque<T> items;
+	std::mutex mutex;
+	std::condition_variable not_empty, not_full;
+};
+
+//concurrency limits: reader and writer threads for the disk, slots for the images in flight
+struct PipelineConfig {
+	int readers = 2;
+	int writers = 2;
+	int slots = 4;
+	vector<ImageFilter> filters = { FILTER_GAMMA, FILTER_CONVOLUTION };
+	FilterParams params;
+};
+
+//buffers reused by every image that passes through the slot
+struct PipelineSlot {
+	string input, output;
+	PpmHeader header;
+	bool valid;			//false if the input could not be read, the later stages pass it on untouched
+	size_t capacity;		//bytes of the buffers below
+	cl::Buffer host;		//pinned staging memory, mapped for the lifetime of the pipeline
+	unsigned char* pixels;
+	cl::Buffer device[2];		//ping-pong buffers of the kernel chain
+	int result;			//device buffer holding the output
+};
+
+//time a stage spent working (not waiting on its queues), summed over its threads
+struct StageStats {
+	string name;
+	int threads;
+	std::atomic<long long> busy_us;
+	std::atomic<int> items;
+
+	StageStats(const string& name, int threads) : name(name), threads(threads), busy_us(0), items(0) {}
+};
+
+//RAII timer adding the lifetime of a scope to a stage
+struct BusyTimer {
+	StageStats& stats;
+	std::chrono::high_resolution_clock::time_point start;
+
+	BusyTimer(StageStats& stats) : stats(stats), start(std::chrono::high_resolution_clock::now()) {}
+	~BusyTimer() {
+		stats.busy_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		stats.items++;
+	}
+};
+
+//the .ppm/.pgm files of a directory, or the lines of a list file
+vector<string> ListImages(const string& input) {
+	vector<string> files;
+	struct stat info;
+	if (stat(input.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+		DIR* dir = opendir(input.c_str());
+		if (!dir)
+			throw std::runtime_error("cannot open " + input);
+		while (dirent* entry = readdir(dir)) {
+			string name = entry->d_name;
+			if (name.size() > 4 && (name.substr(name.size() - 4) == ".ppm" || name.substr(name.size() - 4) == ".pgm"))
+				files.push_back(input + "/" + name);
+		}
+		closedir(dir);
+		std::sort(files.begin(), files.end());
+	}
+	else {
+		std::ifstream list(input.c_str());
+		if (!list)
+			throw std::runtime_error("cannot open " + input);
+		string line;
+		while (std::getline(list, line))
+			if (!line.empty())
+				files.push_back(line);
+	}
+	return files;
+}
+
+//grows the buffers of a slot to hold at least bytes
+void ReserveSlot(const cl::Context& context, cl::CommandQueue& queue, PipelineSlot& slot, size_t bytes) {
+	if (slot.capacity >= bytes)
+		return;
+	if (slot.capacity)
+		queue.enqueueUnmapMemObject(slot.host, slot.pixels);
+	slot.capacity = bytes;
+	slot.host = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, bytes);
+	slot.pixels = (unsigned char*)queue.enqueueMapBuffer(slot.host, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, bytes);
+	slot.device[0] = cl::Buffer(context, CL_MEM_READ_WRITE, bytes);
+	slot.device[1] = cl::Buffer(context, CL_MEM_READ_WRITE, bytes);
+}
+
+//reads slot.input into the pinned buffer of the slot, files the interleaved kernels cannot process are marked invalid
+void ReadIntoSlot(const cl::Context& context, cl::CommandQueue& queue, PipelineSlot& slot) {
+	slot.valid = false;
+	try {
+		MappedPpm mapped = MapPPM(slot.input);
+		slot.header = mapped;
+		if (mapped.channels == 3 && mapped.bytes_per_sample == 1) {
+			ReserveSlot(context, queue, slot, mapped.payload);
+			memcpy(slot.pixels, mapped.pixels, mapped.payload);
+			slot.valid = true;
+		}
+		else
+			std::cerr << slot.input << ": only 8-bit RGB images are supported" << std::endl;
+		UnmapPPM(mapped);
+	}
+	catch (const std::exception& err) {
+		std::cerr << err.what() << std::endl;
+	}
+}
+
+//runs the filter chain over every image of input (a directory or a list file) and writes the results to output_dir
+void RunPipeline(const cl::Context& context, cl::Program& program, const string& input, const string& output_dir, const PipelineConfig& config) {
+	vector<string> files = ListImages(input);
+	mkdir(output_dir.c_str(), 0755);
+
+	vector<PipelineSlot> slots(config.slots);
+	BoundedQueue<int> free_slots(config.slots), to_upload(config.slots), to_compute(config.slots), to_download(config.slots), to_write(config.slots);
+	for (int i = 0; i < config.slots; i++) {
+		slots[i].capacity = 0;
+		free_slots.Push(i);
+	}
+
+	StageStats read("read", config.readers), upload("upload", 1), compute("compute", 1), download("download", 1), write("write", config.writers);
+	std::atomic<int> next_file(0), readers_left(config.readers);
+	std::atomic<size_t> bytes(0);
+
+	//disk -> pinned memory
+	auto reader = [&]() {
+		cl::CommandQueue queue(context);
+		int i;
+		while ((i = next_file++) < (int)files.size()) {
+			int s;
+			free_slots.Pop(s);
+			slots[s].input = files[i];
+			slots[s].output = output_dir + "/" + files[i].substr(files[i].find_last_of('/') + 1);
+			{
+				BusyTimer timer(read);
+				ReadIntoSlot(context, queue, slots[s]);
+			}
+			if (slots[s].valid)
+				bytes += slots[s].header.payload;
+			to_upload.Push(s);
+		}
+		if (--readers_left == 0)
+			to_upload.Close();
+	};
+
+	//the device stages have a queue each, so transfers in both directions overlap with the kernels
+	auto uploader = [&]() {
+		cl::CommandQueue queue(context);
+		int s;
+		while (to_upload.Pop(s)) {
+			if (slots[s].valid) {
+				BusyTimer timer(upload);
+				queue.enqueueWriteBuffer(slots[s].device[0], CL_TRUE, 0, slots[s].header.payload, slots[s].pixels);
+			}
+			to_compute.Push(s);
+		}
+		to_compute.Close();
+	};
+
+	auto computer = [&]() {
+		cl::CommandQueue queue(context);
+		int s;
+		while (to_compute.Pop(s)) {
+			PipelineSlot& slot = slots[s];
+			slot.result = 0;
+			if (slot.valid) {
+				BusyTimer timer(compute);
+				for (ImageFilter filter : config.filters) {
+					FilterInterleaved(queue, program, filter, slot.device[slot.result], slot.device[1 - slot.result],
+						slot.header.width, slot.header.height, 3, config.params);
+					slot.result = 1 - slot.result;
+				}
+				queue.finish();
+			}
+			to_download.Push(s);
+		}
+		to_download.Close();
+	};
+
+	auto downloader = [&]() {
+		cl::CommandQueue queue(context);
+		int s;
+		while (to_download.Pop(s)) {
+			if (slots[s].valid) {
+				BusyTimer timer(download);
+				queue.enqueueReadBuffer(slots[s].device[slots[s].result], CL_TRUE, 0, slots[s].header.payload, slots[s].pixels);
+			}
+			to_write.Push(s);
+		}
+		to_write.Close();
+	};
+
+	//pinned memory -> disk, then the slot is free for the next image
+	auto writer = [&]() {
+		int s;
+		while (to_write.Pop(s)) {
+			if (slots[s].valid) {
+				BusyTimer timer(write);
+				try {
+					WritePPM(slots[s].output, slots[s].header, slots[s].pixels);
+				}
+				catch (const std::exception& err) {
+					std::cerr << err.what() << std::endl;
+				}
+			}
+			free_slots.Push(s);
+		}
+	};
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	vector<std::thread> threads;
+	for (int i = 0; i < config.readers; i++)
+		threads.push_back(std::thread(reader));
+	threads.push_back(std::thread(uploader));
+	threads.push_back(std::thread(computer));
+	threads.push_back(std::thread(downloader));
+	for (int i = 0; i < config.writers; i++)
+		threads.push_back(std::thread(writer));
+	for (std::thread& thread : threads)
+		thread.join();
+	double seconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count() / 1e6;
+
+	cl::CommandQueue queue(context);
+	for (PipelineSlot& slot : slots)
+		if (slot.capacity)
+			queue.enqueueUnmapMemObject(slot.host, slot.pixels);
+	queue.finish();
+
+	std::cout << files.size() << " images in " << std::fixed << std::setprecision(2) << seconds << " s: "
+		<< files.size() / seconds << " images/s, " << bytes / seconds / 1e6 << " MB/s" << std::endl;
+	std::cout << std::setw(10) << "stage" << std::setw(10) << "threads" << std::setw(10) << "images" << std::setw(14) << "busy [ms]"
+		<< std::setw(14) << "utilisation" << std::endl;
+	for (StageStats* stats : { &read, &upload, &compute, &download, &write })
+		std::cout << std::setw(10) << stats->name << std::setw(10) << stats->threads << std::setw(10) << stats->items
+			<< std::setw(14) << std::setprecision(1) << stats->busy_us / 1000.0
+			<< std::setw(13) << 100.0 * stats->busy_us / 1e6 / seconds / stats->threads << "%" << std::endl;
+}
+
+//parses a comma separated list of filter names, e.g. "rgb2gray,gamma"
+vector<ImageFilter> ParseFilters(const string& list) {
+	vector<ImageFilter> filters;
+	size_t start = 0;
+	while (start <= list.size()) {
+		size_t end = std::min(list.find(',', start), list.size());
+		string name = list.substr(start, end - start);
+		bool found = false;
+		for (int f = FILTER_IDENTITY; f <= FILTER_CONVOLUTION; f++)
+			if (name == ImageFilterName((ImageFilter)f)) {
+				filters.push_back((ImageFilter)f);
+				found = true;
+			}
+		if (!found)
+			throw std::runtime_error("unknown filter " + name);
+		start = end + 1;
+	}
+	return filters;
+}
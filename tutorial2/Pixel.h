@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cmath>
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+#include "ImagePath.h"
+#include "Ppm.h"
+
+//pixel types of the planar buffer path (kernels/pixel.cl): 16-bit images keep the precision of HDR and raw
+//sources, float and half images keep intermediate results unquantised; every filter of ImageFilter exists for
+//every type as <kernel>_<type>
+
+enum PixelType { PIXEL_UCHAR, PIXEL_USHORT, PIXEL_FLOAT, PIXEL_HALF };
+
+const char* PixelTypeName(PixelType type) {
+	static const char* names[] = { "uchar", "ushort", "float", "half" };
+	return names[type];
+}
+
+size_t PixelBytes(PixelType type) {
+	static const size_t bytes[] = { 1, 2, 4, 2 };
+	return bytes[type];
+}
+
+//FilterBuffer for images of any pixel type; FILTER_AVERAGE and FILTER_CONVOLUTION round to the nearest
+//instead of truncating like the uchar kernels of my_kernels.cl
+cl::Event FilterTyped(cl::CommandQueue& queue, cl::Program& program, ImageFilter filter, PixelType type, const cl::Buffer& A, cl::Buffer& B,
+			int width, int height, int channels, const FilterParams& params) {
+	static const char* kernels[] = { "identity", "filter_r", "invert", "gray", "gamma", "average", "convolution" };
+	cl::Kernel kernel(program, (string(kernels[filter]) + "_" + PixelTypeName(type)).c_str());
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	cl::NDRange global(width, height, channels);
+	if (filter == FILTER_GRAY)
+		global = cl::NDRange(width, height);
+	else if (filter == FILTER_GAMMA)
+		kernel.setArg(2, params.gamma);
+	else if (filter == FILTER_AVERAGE)
+		kernel.setArg(2, params.range);
+	else if (filter == FILTER_CONVOLUTION) {
+		kernel.setArg(2, params.mask);
+		kernel.setArg(3, params.mask_size);
+	}
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//converts count samples between types, one of them has to be float (normalised to 0..1); converting to an
+//integer type rounds to the nearest and saturates
+cl::Event ConvertPixels(cl::CommandQueue& queue, cl::Program& program, PixelType from, PixelType to, const cl::Buffer& A, cl::Buffer& B, size_t count) {
+	cl::Event prof_event;
+	if (from == to) {
+		queue.enqueueCopyBuffer(A, B, 0, 0, count * PixelBytes(from), NULL, &prof_event);
+		return prof_event;
+	}
+	if (from != PIXEL_FLOAT && to != PIXEL_FLOAT)
+		throw cl::Error(CL_INVALID_VALUE, "ConvertPixels: one of the types has to be float");
+
+	cl::Kernel kernel(program, (to == PIXEL_FLOAT ? string("to_float_") + PixelTypeName(from) : string("from_float_") + PixelTypeName(to)).c_str());
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(count), cl::NullRange, NULL, &prof_event);
+	return prof_event;
+}
+
+//planar 16-bit samples of a PPM/PGM file in host byte order, c*width*height + x + y*width like CImg;
+//8-bit files are widened without scaling, header.max_value tells the range
+vector<cl_ushort> ReadPlanar16(const string& file_name, PpmHeader& header) {
+	MappedPpm mapped = MapPPM(file_name);
+	header = mapped;
+	size_t image_size = (size_t)mapped.width * mapped.height;
+	vector<cl_ushort> pixels(image_size * mapped.channels);
+	for (size_t i = 0; i < image_size; i++)
+		for (int c = 0; c < mapped.channels; c++) {
+			size_t sample = i * mapped.channels + c;
+			pixels[c * image_size + i] = mapped.bytes_per_sample == 1 ? mapped.pixels[sample] :
+				(cl_ushort)((mapped.pixels[2 * sample] << 8) | mapped.pixels[2 * sample + 1]);
+		}
+	UnmapPPM(mapped);
+	return pixels;
+}
+
+//writes planar 16-bit samples as a big-endian PPM/PGM file
+void WritePlanar16(const string& file_name, const vector<cl_ushort>& pixels, int width, int height, int channels, int max_value = 65535) {
+	PpmHeader header = MakePpmHeader(width, height, channels, std::max(max_value, 256));
+	size_t image_size = (size_t)width * height;
+	vector<unsigned char> data(header.payload);
+	for (size_t i = 0; i < image_size; i++)
+		for (int c = 0; c < channels; c++) {
+			size_t sample = i * channels + c;
+			cl_ushort value = pixels[c * image_size + i];
+			data[2 * sample] = (unsigned char)(value >> 8);
+			data[2 * sample + 1] = (unsigned char)(value & 0xff);
+		}
+	WritePPM(file_name, header, &data[0]);
+}
+
+//time and bandwidth of the filters for every pixel type, the precision lost by a gamma round trip, and a
+//16-bit PPM round trip
+void BenchmarkPixel(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	size_t samples = image.size();
+	const PixelType types[] = { PIXEL_UCHAR, PIXEL_USHORT, PIXEL_FLOAT, PIXEL_HALF };
+
+	FilterParams params;
+	params.gamma = 2.2f;
+	params.range = 2;
+	params.mask_size = 5;
+	vector<float> mask = GaussianMask(params.mask_size);
+	params.mask = cl::Buffer(context, CL_MEM_READ_ONLY, mask.size() * sizeof(float));
+	queue.enqueueWriteBuffer(params.mask, CL_TRUE, 0, mask.size() * sizeof(float), &mask[0]);
+
+	//the input in every type, converted on the device through float
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, samples);
+	cl::Buffer dev_float(context, CL_MEM_READ_WRITE, samples * sizeof(float));
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, samples, image.data());
+	ConvertPixels(queue, program, PIXEL_UCHAR, PIXEL_FLOAT, dev_input, dev_float, samples);
+	cl::Buffer inputs[4], outputs[4], temps[4];
+	for (PixelType type : types) {
+		inputs[type] = cl::Buffer(context, CL_MEM_READ_WRITE, samples * PixelBytes(type));
+		outputs[type] = cl::Buffer(context, CL_MEM_READ_WRITE, samples * PixelBytes(type));
+		temps[type] = cl::Buffer(context, CL_MEM_READ_WRITE, samples * PixelBytes(type));
+		ConvertPixels(queue, program, PIXEL_FLOAT, type, dev_float, inputs[type], samples);
+	}
+	queue.finish();
+
+	std::cout << "Pixel types on a " << width << "x" << height << "x" << channels << " image, time [us] and GB/s of one read and one write per sample" << std::endl;
+	std::cout << std::setw(14) << "filter";
+	for (PixelType type : types)
+		std::cout << std::setw(12) << PixelTypeName(type) << std::setw(8) << "GB/s";
+	std::cout << std::endl;
+	for (ImageFilter filter : { FILTER_IDENTITY, FILTER_INVERT, FILTER_GAMMA, FILTER_AVERAGE, FILTER_CONVOLUTION }) {
+		std::cout << std::setw(14) << ImageFilterName(filter);
+		for (PixelType type : types) {
+			//the first launch builds the kernel on some platforms
+			FilterTyped(queue, program, filter, type, inputs[type], outputs[type], width, height, channels, params);
+			cl::Event event = FilterTyped(queue, program, filter, type, inputs[type], outputs[type], width, height, channels, params);
+			queue.finish();
+			double time = GetExecutionTime(event, PROF_US);
+			std::cout << std::setw(12) << std::fixed << std::setprecision(0) << time << std::setw(8) << std::setprecision(1)
+				<< 2.0 * samples * PixelBytes(type) / time / 1000.0;
+		}
+		std::cout << std::endl;
+	}
+
+	//gamma 2.2 and back in each type, against the unquantised input in units of an 8-bit step
+	vector<float> reference(samples), result(samples);
+	queue.enqueueReadBuffer(dev_float, CL_TRUE, 0, samples * sizeof(float), &reference[0]);
+	std::cout << "gamma 2.2 and back, largest error in 8-bit steps:";
+	for (PixelType type : types) {
+		FilterParams inverse = params;
+		inverse.gamma = 1.0f / params.gamma;
+		FilterTyped(queue, program, FILTER_GAMMA, type, inputs[type], temps[type], width, height, channels, params);
+		FilterTyped(queue, program, FILTER_GAMMA, type, temps[type], outputs[type], width, height, channels, inverse);
+		ConvertPixels(queue, program, type, PIXEL_FLOAT, outputs[type], dev_float, samples);
+		queue.enqueueReadBuffer(dev_float, CL_TRUE, 0, samples * sizeof(float), &result[0]);
+		double max_error = 0;
+		for (size_t i = 0; i < samples; i++)
+			max_error = std::max(max_error, std::fabs((double)result[i] - reference[i]) * 255.0);
+		std::cout << " " << PixelTypeName(type) << " " << std::setprecision(3) << max_error;
+	}
+	std::cout << std::endl;
+
+	//16-bit file round trip, the samples are the input widened to 16 bits
+	vector<cl_ushort> pixels(samples);
+	queue.enqueueReadBuffer(inputs[PIXEL_USHORT], CL_TRUE, 0, samples * sizeof(cl_ushort), &pixels[0]);
+	WritePlanar16("pixel16.ppm", pixels, width, height, channels);
+	PpmHeader header;
+	vector<cl_ushort> loaded = ReadPlanar16("pixel16.ppm", header);
+	cimg_library::CImg<unsigned short> cimg_loaded("pixel16.ppm");
+	remove("pixel16.ppm");
+	bool correct = header.bytes_per_sample == 2 && loaded == pixels && cimg_loaded.size() == samples
+		&& std::equal(pixels.begin(), pixels.end(), cimg_loaded.data());
+	for (size_t i = 0; correct && i < samples; i++)
+		correct = pixels[i] == image.data()[i] * 257;
+	std::cout << "16-bit PPM round trip: " << (correct ? "OK" : "FAILED") << std::endl;
+}
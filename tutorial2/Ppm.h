@@ -0,0 +1,285 @@
+#pragma once
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Utils.h"
+#include "CImg.h"
+
+//header of a binary PPM (P6, RGB) or PGM (P5, gray) image
+//samples are 8-bit for max_value < 256 and 16-bit big-endian otherwise, pixels are interleaved
+struct PpmHeader {
+	int width, height;
+	int channels;		//3 for P6, 1 for P5
+	int max_value;
+	int bytes_per_sample;	//1 or 2
+	size_t payload;		//bytes of pixel data following the header
+};
+
+//whole image in host memory, (x + y*width)*channels + c as on disk
+struct PpmImage : PpmHeader {
+	vector<unsigned char> data;
+};
+
+//read-only memory map of a PPM file, pixels points at the payload inside the mapping
+struct MappedPpm : PpmHeader {
+	const unsigned char* pixels;
+	void* map;
+	size_t map_size;
+};
+
+//reads the next header number at data[pos], skipping whitespace and # comments
+int ParsePpmNumber(const unsigned char* data, size_t size, size_t& pos) {
+	while (pos < size && (data[pos] == '#' || isspace(data[pos]))) {
+		if (data[pos] == '#')
+			while (pos < size && data[pos] != '\n')
+				pos++;
+		pos++;
+	}
+	if (pos >= size || !isdigit(data[pos]))
+		throw std::runtime_error("malformed PPM header");
+	int value = 0;
+	while (pos < size && isdigit(data[pos]))
+		value = value * 10 + (data[pos++] - '0');
+	return value;
+}
+
+//parses the header at the start of data and returns the offset of the pixel data
+size_t ParsePpmHeader(const unsigned char* data, size_t size, PpmHeader& header) {
+	if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6'))
+		throw std::runtime_error("not a binary PPM/PGM file");
+	header.channels = (data[1] == '6') ? 3 : 1;
+
+	size_t pos = 2;
+	header.width = ParsePpmNumber(data, size, pos);
+	header.height = ParsePpmNumber(data, size, pos);
+	header.max_value = ParsePpmNumber(data, size, pos);
+	if (header.max_value < 1 || header.max_value > 65535)
+		throw std::runtime_error("unsupported PPM max value");
+	header.bytes_per_sample = (header.max_value < 256) ? 1 : 2;
+	header.payload = (size_t)header.width * header.height * header.channels * header.bytes_per_sample;
+
+	pos++; //the single whitespace character that ends the header
+	if (pos + header.payload > size)
+		throw std::runtime_error("truncated PPM file");
+	return pos;
+}
+
+//maps the file into memory without reading it, the pages are loaded on first access
+MappedPpm MapPPM(const string& file_name) {
+	int file = open(file_name.c_str(), O_RDONLY);
+	if (file < 0)
+		throw std::runtime_error("cannot open " + file_name);
+
+	struct stat info;
+	if (fstat(file, &info) != 0) {
+		close(file);
+		throw std::runtime_error("cannot stat " + file_name);
+	}
+	MappedPpm image;
+	image.map_size = info.st_size;
+	image.map = mmap(NULL, image.map_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (image.map == MAP_FAILED)
+		throw std::runtime_error("cannot map " + file_name);
+
+	//the payload is read front to back once
+	madvise(image.map, image.map_size, MADV_SEQUENTIAL);
+
+	try {
+		image.pixels = (const unsigned char*)image.map + ParsePpmHeader((const unsigned char*)image.map, image.map_size, image);
+	}
+	catch (const std::runtime_error& err) {
+		munmap(image.map, image.map_size);
+		throw std::runtime_error(file_name + ": " + err.what());
+	}
+	return image;
+}
+
+void UnmapPPM(MappedPpm& image) {
+	munmap(image.map, image.map_size);
+	image.map = NULL;
+	image.pixels = NULL;
+}
+
+//loads the pixels without converting them to CImg's planar layout
+PpmImage ReadPPM(const string& file_name) {
+	MappedPpm mapped = MapPPM(file_name);
+	PpmImage image;
+	(PpmHeader&)image = mapped;
+	image.data.assign(mapped.pixels, mapped.pixels + mapped.payload);
+	UnmapPPM(mapped);
+	return image;
+}
+
+//writes header and payload, pixels holds header.payload bytes
+void WritePPM(const string& file_name, const PpmHeader& header, const void* pixels) {
+	FILE* file = fopen(file_name.c_str(), "wb");
+	if (!file)
+		throw std::runtime_error("cannot create " + file_name);
+	fprintf(file, "P%c\n%d %d\n%d\n", header.channels == 3 ? '6' : '5', header.width, header.height, header.max_value);
+	size_t written = fwrite(pixels, 1, header.payload, file);
+	fclose(file);
+	if (written != header.payload)
+		throw std::runtime_error("cannot write " + file_name);
+}
+
+void WritePPM(const string& file_name, const PpmImage& image) {
+	WritePPM(file_name, image, &image.data[0]);
+}
+
+//header for an image of the given size, 16-bit samples for max_value > 255
+PpmHeader MakePpmHeader(int width, int height, int channels, int max_value = 255) {
+	PpmHeader header;
+	header.width = width;
+	header.height = height;
+	header.channels = channels;
+	header.max_value = max_value;
+	header.bytes_per_sample = (max_value < 256) ? 1 : 2;
+	header.payload = (size_t)width * height * channels * header.bytes_per_sample;
+	return header;
+}
+
+//uploads the pixel data of a file to a new device buffer straight from the file mapping, without a
+//host-side copy of the image; with pinned the buffer is allocated in host-accessible memory and filled
+//through a map, which avoids the staging copy of enqueueWriteBuffer on devices that share memory with the host
+cl::Buffer LoadPPMToDevice(const cl::Context& context, cl::CommandQueue& queue, const string& file_name, PpmHeader& header,
+			bool pinned = false, cl_mem_flags flags = CL_MEM_READ_WRITE) {
+	MappedPpm mapped = MapPPM(file_name);
+	header = mapped;
+
+	cl::Buffer buffer;
+	if (!pinned) {
+		buffer = cl::Buffer(context, flags, mapped.payload);
+		queue.enqueueWriteBuffer(buffer, CL_TRUE, 0, mapped.payload, mapped.pixels);
+	}
+	else {
+		buffer = cl::Buffer(context, flags | CL_MEM_ALLOC_HOST_PTR, mapped.payload);
+		void* pointer = queue.enqueueMapBuffer(buffer, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, mapped.payload);
+		memcpy(pointer, mapped.pixels, mapped.payload);
+		queue.enqueueUnmapMemObject(buffer, pointer);
+		queue.finish();
+	}
+
+	UnmapPPM(mapped);
+	return buffer;
+}
+
+//writes a device buffer holding header.payload bytes of interleaved pixels straight from a mapping of the buffer
+void StorePPMFromDevice(cl::CommandQueue& queue, const cl::Buffer& buffer, const PpmHeader& header, const string& file_name) {
+	void* pointer = queue.enqueueMapBuffer(buffer, CL_TRUE, CL_MAP_READ, 0, header.payload);
+	try {
+		WritePPM(file_name, header, pointer);
+	}
+	catch (...) {
+		queue.enqueueUnmapMemObject(buffer, pointer);
+		throw;
+	}
+	queue.enqueueUnmapMemObject(buffer, pointer);
+	queue.finish();
+}
+
+//load and store times of the mapped codec against CImg, in milliseconds of wall-clock time
+void BenchmarkPpmFile(const cl::Context& context, cl::CommandQueue& queue, const string& file_name) {
+	typedef std::chrono::high_resolution_clock clock;
+	auto ms = [](clock::time_point start) { return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count() / 1000.0; };
+	string output_name = file_name + ".out.ppm";
+
+	//CImg: parse and de-interleave on the host, then upload the planar image
+	clock::time_point start = clock::now();
+	cimg_library::CImg<unsigned char> image(file_name.c_str());
+	double cimg_load = ms(start);
+	cl::Buffer dev_planar(context, CL_MEM_READ_WRITE, image.size());
+	queue.enqueueWriteBuffer(dev_planar, CL_TRUE, 0, image.size(), image.data());
+	double cimg_upload = ms(start);
+
+	start = clock::now();
+	queue.enqueueReadBuffer(dev_planar, CL_TRUE, 0, image.size(), image.data());
+	image.save(output_name.c_str());
+	double cimg_store = ms(start);
+
+	//mapped codec: the payload goes to the device as it is stored in the file
+	PpmHeader header;
+	start = clock::now();
+	cl::Buffer dev_image = LoadPPMToDevice(context, queue, file_name, header);
+	double mapped_upload = ms(start);
+
+	start = clock::now();
+	cl::Buffer dev_pinned = LoadPPMToDevice(context, queue, file_name, header, true);
+	double pinned_upload = ms(start);
+
+	start = clock::now();
+	StorePPMFromDevice(queue, dev_image, header, output_name);
+	double mapped_store = ms(start);
+
+	//the files stored from both buffers have to be identical to the input payload
+	MappedPpm input = MapPPM(file_name);
+	bool correct = true;
+	for (const cl::Buffer& buffer : { dev_image, dev_pinned }) {
+		StorePPMFromDevice(queue, buffer, header, output_name);
+		MappedPpm output = MapPPM(output_name);
+		correct = correct && input.payload == output.payload && memcmp(input.pixels, output.pixels, input.payload) == 0;
+		UnmapPPM(output);
+	}
+	UnmapPPM(input);
+	remove(output_name.c_str());
+
+	std::cout << std::setw(24) << std::left << file_name << std::right << std::setw(8) << std::fixed << std::setprecision(1)
+		<< header.width * (double)header.height / 1e6 << std::setw(12) << cimg_load << std::setw(14) << cimg_upload
+		<< std::setw(14) << mapped_upload << std::setw(14) << pinned_upload << std::setw(12) << cimg_store
+		<< std::setw(14) << mapped_store << std::setw(8) << (correct ? "OK" : "FAILED") << std::endl;
+}
+
+//the bundled images, the input image and a synthetic file of megapixels million pixels
+void BenchmarkPpm(const cl::Context& context, cl::CommandQueue& queue, const string& image_filename, int megapixels = 200) {
+	std::cout << std::setw(24) << std::left << "file" << std::right << std::setw(8) << "MP" << std::setw(12) << "CImg load"
+		<< std::setw(14) << "+upload" << std::setw(14) << "mapped load" << std::setw(14) << "pinned load" << std::setw(12) << "CImg store"
+		<< std::setw(14) << "mapped store" << std::setw(8) << "check" << std::endl;
+	std::cout << std::setw(24) << "" << std::setw(8) << "" << std::setw(12) << "[ms]" << std::setw(14) << "[ms]" << std::setw(14) << "[ms]"
+		<< std::setw(14) << "[ms]" << std::setw(12) << "[ms]" << std::setw(14) << "[ms]" << std::endl;
+
+	//16-bit samples are stored big-endian, CImg has to read back what was written
+	{
+		PpmHeader header = MakePpmHeader(64, 48, 3, 65535);
+		vector<unsigned char> pixels(header.payload);
+		for (size_t i = 0; i < pixels.size(); i++)
+			pixels[i] = (unsigned char)(i * 7);
+		WritePPM("synthetic16.ppm", header, &pixels[0]);
+		cimg_library::CImg<unsigned short> image("synthetic16.ppm");
+		int image_size = header.width * header.height;
+		bool correct = image.width() == header.width && image.height() == header.height && image.spectrum() == 3;
+		for (int i = 0; correct && i < image_size; i++)
+			for (int c = 0; c < 3; c++)
+				correct = correct && image.data()[c * image_size + i] == ((pixels[(i * 3 + c) * 2] << 8) | pixels[(i * 3 + c) * 2 + 1]);
+		remove("synthetic16.ppm");
+		std::cout << "16-bit round trip through CImg: " << (correct ? "OK" : "FAILED") << std::endl;
+	}
+
+	vector<string> files = { "test.ppm", "test_large.ppm" };
+	if (image_filename != files[0] && image_filename != files[1])
+		files.push_back(image_filename);
+	for (const string& file_name : files)
+		BenchmarkPpmFile(context, queue, file_name);
+
+	//a large random image, only if it fits into a single device allocation
+	int width = 16384, height = megapixels * 1000000 / width;
+	PpmHeader header = MakePpmHeader(width, height, 3);
+	if (header.payload > context.getInfo<CL_CONTEXT_DEVICES>()[0].getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>())
+		return;
+	vector<unsigned char> pixels(header.payload);
+	for (size_t i = 0; i < pixels.size(); i++)
+		pixels[i] = (unsigned char)(i * 2654435761u >> 24);
+	WritePPM("synthetic.ppm", header, &pixels[0]);
+	pixels = vector<unsigned char>();
+	BenchmarkPpmFile(context, queue, "synthetic.ppm");
+	remove("synthetic.ppm");
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cmath>
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+
+//resampling to any size (kernels/resample.cl) as a horizontal and a vertical pass, and Gaussian/Laplacian
+//pyramids with one launch per level, so multi-scale processing stays on the device
+
+//the filters of resample_weight
+enum ResampleFilter { RESAMPLE_BILINEAR, RESAMPLE_BICUBIC, RESAMPLE_LANCZOS, RESAMPLE_AREA };
+
+const char* ResampleFilterName(ResampleFilter filter) {
+	static const char* names[] = { "bilinear", "bicubic", "lanczos3", "area" };
+	return names[filter];
+}
+
+//bytes of the float image between the two passes
+size_t ResampleTempBytes(int src_height, int dst_width, int channels) {
+	return (size_t)dst_width * src_height * channels * sizeof(float);
+}
+
+//resizes the planar image A to dst_width x dst_height into B; filters are stretched when downscaling,
+//RESAMPLE_AREA averages the source pixels covered by each output pixel (thumbnails)
+vector<cl::Event> Resample(cl::CommandQueue& queue, cl::Program& program, ResampleFilter filter, const cl::Buffer& A, cl::Buffer& temp, cl::Buffer& B,
+			int src_width, int src_height, int dst_width, int dst_height, int channels) {
+	vector<cl::Event> events(2);
+
+	cl::Kernel rows(program, "resample_rows");
+	rows.setArg(0, A);
+	rows.setArg(1, temp);
+	rows.setArg(2, src_width);
+	rows.setArg(3, (int)filter);
+	queue.enqueueNDRangeKernel(rows, cl::NullRange, cl::NDRange(dst_width, src_height, channels), cl::NullRange, NULL, &events[0]);
+
+	cl::Kernel columns(program, "resample_columns");
+	columns.setArg(0, temp);
+	columns.setArg(1, B);
+	columns.setArg(2, src_height);
+	columns.setArg(3, (int)filter);
+	queue.enqueueNDRangeKernel(columns, cl::NullRange, cl::NDRange(dst_width, dst_height, channels), cl::NullRange, NULL, &events[1]);
+	return events;
+}
+
+//levels of a pyramid, level 0 is the full size image and every level is half the size of the one below
+//(rounded up); laplacian has one level less, the top of the Laplacian pyramid is the top Gaussian level
+struct Pyramid {
+	int channels;
+	vector<int> widths, heights;
+	vector<cl::Buffer> gaussian;	//uchar
+	vector<cl::Buffer> laplacian;	//short
+};
+
+//allocates levels until the smaller side would drop below min_size, or max_levels
+Pyramid CreatePyramid(const cl::Context& context, int width, int height, int channels, int min_size = 16, int max_levels = 16) {
+	Pyramid pyramid;
+	pyramid.channels = channels;
+	while ((int)pyramid.widths.size() < max_levels) {
+		pyramid.widths.push_back(width);
+		pyramid.heights.push_back(height);
+		if (std::min(width, height) / 2 < min_size)
+			break;
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+	for (size_t l = 0; l < pyramid.widths.size(); l++) {
+		size_t pixels = (size_t)pyramid.widths[l] * pyramid.heights[l] * channels;
+		//level 0 of the Gaussian pyramid is the input image, set by BuildGaussianPyramid
+		pyramid.gaussian.push_back(l ? cl::Buffer(context, CL_MEM_READ_WRITE, pixels) : cl::Buffer());
+		if (l + 1 < pyramid.widths.size())
+			pyramid.laplacian.push_back(cl::Buffer(context, CL_MEM_READ_WRITE, pixels * sizeof(cl_short)));
+	}
+	return pyramid;
+}
+
+//Gaussian levels of the planar image A (which becomes level 0), one launch per level
+vector<cl::Event> BuildGaussianPyramid(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, Pyramid& pyramid) {
+	vector<cl::Event> events(pyramid.widths.size() - 1);
+	pyramid.gaussian[0] = A;
+	for (size_t l = 1; l < pyramid.widths.size(); l++) {
+		cl::Kernel kernel(program, "pyramid_down");
+		kernel.setArg(0, pyramid.gaussian[l - 1]);
+		kernel.setArg(1, pyramid.gaussian[l]);
+		kernel.setArg(2, pyramid.widths[l - 1]);
+		kernel.setArg(3, pyramid.heights[l - 1]);
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(pyramid.widths[l], pyramid.heights[l], pyramid.channels), cl::NullRange, NULL, &events[l - 1]);
+	}
+	return events;
+}
+
+//Laplacian levels from the Gaussian ones, one launch per level
+vector<cl::Event> BuildLaplacianPyramid(cl::CommandQueue& queue, cl::Program& program, Pyramid& pyramid) {
+	vector<cl::Event> events(pyramid.laplacian.size());
+	for (size_t l = 0; l < pyramid.laplacian.size(); l++) {
+		cl::Kernel kernel(program, "pyramid_laplacian");
+		kernel.setArg(0, pyramid.gaussian[l]);
+		kernel.setArg(1, pyramid.gaussian[l + 1]);
+		kernel.setArg(2, pyramid.laplacian[l]);
+		kernel.setArg(3, pyramid.widths[l + 1]);
+		kernel.setArg(4, pyramid.heights[l + 1]);
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(pyramid.widths[l], pyramid.heights[l], pyramid.channels), cl::NullRange, NULL, &events[l]);
+	}
+	return events;
+}
+
+//reconstructs the full size image into B from the Laplacian levels and the top Gaussian level, exact if
+//the levels were not modified; the intermediate levels are written into the Gaussian levels 1..n-2;
+//a single level pyramid has no Laplacian levels and is copied, the only event is then the copy
+vector<cl::Event> CollapsePyramid(cl::CommandQueue& queue, cl::Program& program, Pyramid& pyramid, cl::Buffer& B) {
+	if (pyramid.laplacian.empty()) {
+		vector<cl::Event> events(1);
+		queue.enqueueCopyBuffer(pyramid.gaussian[0], B, 0, 0, (size_t)pyramid.widths[0] * pyramid.heights[0] * pyramid.channels, NULL, &events[0]);
+		return events;
+	}
+	vector<cl::Event> events(pyramid.laplacian.size());
+	for (int l = (int)pyramid.laplacian.size() - 1; l >= 0; l--) {
+		cl::Kernel kernel(program, "pyramid_collapse");
+		kernel.setArg(0, pyramid.laplacian[l]);
+		kernel.setArg(1, pyramid.gaussian[l + 1]);
+		kernel.setArg(2, l ? pyramid.gaussian[l] : B);
+		kernel.setArg(3, pyramid.widths[l + 1]);
+		kernel.setArg(4, pyramid.heights[l + 1]);
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(pyramid.widths[l], pyramid.heights[l], pyramid.channels), cl::NullRange, NULL, &events[l]);
+	}
+	return events;
+}
+
+//every filter at a few scales, same size resampling (identity), area downscale by 2 against the host,
+//and pyramids whose collapse has to give back the input exactly
+void BenchmarkResample(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	//even size, so that halving is exact
+	cimg_library::CImg<unsigned char> input = image.get_crop(0, 0, 0, 0, (image.width() & ~1) - 1, (image.height() & ~1) - 1, 0, image.spectrum() - 1);
+	int width = input.width(), height = input.height(), channels = input.spectrum();
+	int max_width = 2 * width, max_height = 2 * height;
+
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, input.size());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, (size_t)max_width * max_height * channels);
+	cl::Buffer dev_temp(context, CL_MEM_READ_WRITE, ResampleTempBytes(height, max_width, channels));
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, input.size(), input.data());
+	vector<unsigned char> output(input.size());
+
+	std::cout << "Resampling a " << width << "x" << height << "x" << channels << " image" << std::endl;
+	const float scales[] = { 2.0f, 1.0f, 0.5f, 0.27f, 0.1f };
+	std::cout << std::setw(10) << "filter";
+	for (float scale : scales)
+		std::cout << std::setw(12) << std::fixed << std::setprecision(2) << scale << "x";
+	std::cout << std::setw(10) << "identity" << std::endl;
+
+	for (ResampleFilter filter : { RESAMPLE_BILINEAR, RESAMPLE_BICUBIC, RESAMPLE_LANCZOS, RESAMPLE_AREA }) {
+		std::cout << std::setw(10) << ResampleFilterName(filter);
+		bool identity = true;
+		for (float scale : scales) {
+			int dst_width = std::max(1, (int)(width * scale)), dst_height = std::max(1, (int)(height * scale));
+			vector<cl::Event> events = Resample(queue, program, filter, dev_input, dev_temp, dev_output, width, height, dst_width, dst_height, channels);
+			if (scale == 1.0f) {
+				queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, input.size(), &output[0]);
+				identity = std::equal(output.begin(), output.end(), input.data());
+			}
+			queue.finish();
+			std::cout << std::setw(10) << std::setprecision(0) << GetExecutionTime(events, PROF_US) << " us";
+		}
+		std::cout << std::setw(10) << (identity ? "OK" : "FAILED") << std::endl;
+	}
+
+	//area downscale by 2 is the rounded mean of 2x2 blocks
+	Resample(queue, program, RESAMPLE_AREA, dev_input, dev_temp, dev_output, width, height, width / 2, height / 2, channels);
+	queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, input.size() / 4, &output[0]);
+	bool check = true;
+	for (int c = 0; c < channels; c++)
+		for (int y = 0; y < height / 2; y++)
+			for (int x = 0; x < width / 2; x++) {
+				double mean = (input(2 * x, 2 * y, 0, c) + input(2 * x + 1, 2 * y, 0, c) + input(2 * x, 2 * y + 1, 0, c) + input(2 * x + 1, 2 * y + 1, 0, c)) / 4.0;
+				check = check && output[x + y * (width / 2) + c * (width / 2) * (height / 2)] == std::lrint(mean);
+			}
+	std::cout << "area 1/2 against the host: " << (check ? "OK" : "FAILED") << std::endl;
+
+	//pyramids
+	Pyramid pyramid = CreatePyramid(context, width, height, channels);
+	vector<cl::Event> gaussian_events = BuildGaussianPyramid(queue, program, dev_input, pyramid);
+	vector<cl::Event> laplacian_events = BuildLaplacianPyramid(queue, program, pyramid);
+	vector<cl::Event> collapse_events = CollapsePyramid(queue, program, pyramid, dev_output);
+	queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, input.size(), &output[0]);
+
+	std::cout << std::setw(8) << "level" << std::setw(14) << "size" << std::setw(16) << "gaussian [us]" << std::setw(16) << "laplacian [us]"
+		<< std::setw(16) << "collapse [us]" << std::endl;
+	for (size_t l = 0; l < pyramid.widths.size(); l++) {
+		std::cout << std::setw(8) << l << std::setw(14) << (std::to_string(pyramid.widths[l]) + "x" + std::to_string(pyramid.heights[l]));
+		std::cout << std::setw(16);
+		if (l)
+			std::cout << GetExecutionTime(gaussian_events[l - 1], PROF_US);
+		else
+			std::cout << "-";
+		std::cout << std::setw(16);
+		if (l < pyramid.laplacian.size())
+			std::cout << GetExecutionTime(laplacian_events[l], PROF_US) << std::setw(16) << GetExecutionTime(collapse_events[l], PROF_US);
+		else
+			std::cout << "-" << std::setw(16) << "-";
+		std::cout << std::endl;
+	}
+	std::cout << "collapse of the Laplacian pyramid: " << (std::equal(output.begin(), output.end(), input.data()) ? "OK" : "FAILED") << std::endl;
+}
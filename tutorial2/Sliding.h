@@ -0,0 +1,125 @@
+#pragma once
+
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "Convolution.h"
+#include "Integral.h"
+
+//sliding-window box/mean filter (kernels/sliding.cl): window sums along the rows from a prefix sum of a local
+//tile, then a running sum per column; the cost does not depend on the radius like with a summed-area table,
+//but the only intermediate is a ushort image, which suits strips of images too large for a full-size table;
+//FilterBuffer and FilterInterleaved use it for FILTER_AVERAGE from SLIDING_MIN_RANGE on
+
+//largest radius whose row sums fit in the ushort intermediate
+const int SLIDING_MAX_RANGE = 128;
+
+//radius from which the two passes are faster than the (2*range+1)^2 reads of avg_filterND
+const int SLIDING_MIN_RANGE = 4;
+
+//work-group of box_rows: work-items along a row and rows per work-group
+const int SLIDING_ROW_LANES = 64, SLIDING_ROWS = 4;
+
+//bytes of the intermediate row sums
+size_t SlidingTempBytes(int width, int height, int channels) {
+	return (size_t)width * height * channels * sizeof(cl_ushort);
+}
+
+//mean over a (2*range+1)^2 window of the planar (or with interleaved, packed) image A into B, temp holds
+//SlidingTempBytes; pixels outside the image count as 0 (identical to avg_filterND), or with inside_only the
+//mean is taken over the pixels of the window inside the image; segment is the row pixels per work-group of the
+//row pass and the column pixels per work-item of the column pass
+vector<cl::Event> BoxFilterSliding(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& temp, cl::Buffer& B,
+			int width, int height, int channels, int range, bool inside_only = false, bool interleaved = false, int segment = 256) {
+	if (range < 0 || range > SLIDING_MAX_RANGE)
+		throw cl::Error(CL_INVALID_VALUE, "BoxFilterSliding: the range has to be between 0 and 128");
+	vector<cl::Event> events(2);
+	cl_int2 layout;
+	layout.s[0] = interleaved ? channels : 1;
+	layout.s[1] = interleaved ? 1 : width * height;
+
+	cl::Kernel rows(program, "box_rows");
+	rows.setArg(0, A);
+	rows.setArg(1, temp);
+	rows.setArg(2, range);
+	rows.setArg(3, width);
+	rows.setArg(4, height);
+	rows.setArg(5, segment);
+	rows.setArg(6, layout);
+	rows.setArg(7, cl::Local(SLIDING_ROWS * (segment + 2 * range) * sizeof(cl_uint)));
+	rows.setArg(8, cl::Local(SLIDING_ROWS * SLIDING_ROW_LANES * sizeof(cl_uint)));
+	queue.enqueueNDRangeKernel(rows, cl::NullRange, cl::NDRange((width + segment - 1) / segment * SLIDING_ROW_LANES,
+		(height + SLIDING_ROWS - 1) / SLIDING_ROWS * SLIDING_ROWS, channels), cl::NDRange(SLIDING_ROW_LANES, SLIDING_ROWS, 1), NULL, &events[0]);
+
+	cl::Kernel columns(program, "box_columns");
+	columns.setArg(0, temp);
+	columns.setArg(1, B);
+	columns.setArg(2, range);
+	columns.setArg(3, width);
+	columns.setArg(4, height);
+	columns.setArg(5, segment);
+	columns.setArg(6, (int)inside_only);
+	columns.setArg(7, layout);
+	queue.enqueueNDRangeKernel(columns, cl::NullRange, cl::NDRange(width, (height + segment - 1) / segment, channels), cl::NullRange, NULL, &events[1]);
+	return events;
+}
+
+//FILTER_AVERAGE as chosen by FilterBuffer and FilterInterleaved: whether the sliding-window filter is used
+bool UseSlidingAverage(int range, int channels) {
+	return range >= SLIDING_MIN_RANGE && range <= SLIDING_MAX_RANGE && channels != 4;
+}
+
+//the sliding-window average with its own intermediate, for callers without one; returns the event of the
+//column pass, which finishes the filter
+cl::Event AverageFilterSliding(cl::CommandQueue& queue, cl::Program& program, const cl::Buffer& A, cl::Buffer& B,
+			int width, int height, int channels, int range, bool interleaved) {
+	cl::Buffer temp(queue.getInfo<CL_QUEUE_CONTEXT>(), CL_MEM_READ_WRITE, SlidingTempBytes(width, height, channels));
+	return BoxFilterSliding(queue, program, A, temp, B, width, height, channels, range, false, interleaved).back();
+}
+
+//the sliding-window filter against avg_filterND (identical output expected) and the summed-area table
+//for radii 1 to 64, with the intermediate memory each of them needs
+void BenchmarkSliding(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image.size());
+	cl::Buffer dev_reference(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_temp(context, CL_MEM_READ_WRITE, SlidingTempBytes(width, height, channels));
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image.size(), image.data());
+	vector<unsigned char> reference(image.size()), output(image.size());
+
+	IntegralImage integral = CreateIntegral(context, width, height, channels);
+	vector<cl::Event> integral_events = ComputeIntegral(queue, program, dev_input, integral);
+	queue.finish();
+	double integral_build = GetExecutionTime(integral_events, PROF_US);
+
+	std::cout << "Sliding-window mean filter on a " << width << "x" << height << "x" << channels << " image" << std::endl;
+	std::cout << "  intermediate: " << SlidingTempBytes(width, height, channels) / 1024 << " kB, summed-area table: "
+		<< (size_t)(width + 1) * (height + 1) * channels * sizeof(cl_uint) / 1024 << " kB (built in " << std::fixed << std::setprecision(0)
+		<< integral_build << " us)" << std::endl;
+	std::cout << std::setw(8) << "range" << std::setw(18) << "avg_filterND [us]" << std::setw(16) << "sliding [us]" << std::setw(16)
+		<< "integral [us]" << std::setw(10) << "speedup" << std::setw(8) << "check" << std::endl;
+
+	for (int range : { 1, 2, 4, 8, 16, 32, 64 }) {
+		cl::Kernel kernel(program, "avg_filterND");
+		kernel.setArg(0, dev_input);
+		kernel.setArg(1, dev_reference);
+		kernel.setArg(2, range);
+		cl::Event reference_event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &reference_event);
+		queue.enqueueReadBuffer(dev_reference, CL_TRUE, 0, image.size(), &reference[0]);
+
+		vector<cl::Event> events = BoxFilterSliding(queue, program, dev_input, dev_temp, dev_output, width, height, channels, range);
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &output[0]);
+		bool check = output == reference;
+
+		cl::Event integral_event = BoxFilterIntegral(queue, program, integral, dev_output, range);
+		queue.finish();
+
+		double direct = GetExecutionTime(reference_event, PROF_US), sliding = GetExecutionTime(events, PROF_US);
+		std::cout << std::setw(8) << range << std::setw(18) << std::setprecision(0) << direct << std::setw(16) << sliding
+			<< std::setw(16) << integral_build + GetExecutionTime(integral_event, PROF_US) << std::setw(10) << std::setprecision(2)
+			<< direct / sliding << std::setw(8) << (check ? "OK" : "FAILED") << std::endl;
+	}
+}
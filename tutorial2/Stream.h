@@ -0,0 +1,214 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include "Utils.h"
+#include "ImagePath.h"
+#include "Interleaved.h"
+#include "Ppm.h"
+
+//streaming of images larger than host or device memory: the file is memory-mapped and processed in
+//horizontal strips, each strip is uploaded straight from the mapping together with the halo rows its
+//neighbourhood filters need, goes through the filter chain on the device and is appended to the output
+//file, after which its input pages are dropped again; memory use depends on the width and the strip
+//height, not on the height of the image
+
+struct StreamConfig {
+	int strip_rows = 256;
+	vector<ImageFilter> filters = { FILTER_GAMMA, FILTER_CONVOLUTION };
+	FilterParams params;
+};
+
+//what a run needed
+struct StreamStats {
+	int width, height;
+	int strips;
+	size_t device_bytes;	//both device buffers
+	size_t host_bytes;	//pinned output strip
+	double seconds;
+};
+
+//rows above and below a strip that the chain needs: every neighbourhood filter reads its radius beyond
+//the rows it has to produce, so the radii add up
+int ChainHalo(const vector<ImageFilter>& filters, const FilterParams& params) {
+	int halo = 0;
+	for (ImageFilter filter : filters)
+		halo += FilterRadius(filter, params);
+	return halo;
+}
+
+//releases the mapped input pages before byte end, they will not be read again
+void DropMappedPages(const MappedPpm& mapped, size_t end) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t bytes = ((const unsigned char*)mapped.pixels - (const unsigned char*)mapped.map + end) / page * page;
+	if (bytes)
+		madvise(mapped.map, bytes, MADV_DONTNEED);
+}
+
+//runs the filter chain of config over an 8-bit RGB PPM file strip by strip and writes the result to output
+//the rows of a strip are exact: the halo rows are filtered too but only the strip's own rows are written
+StreamStats StreamImage(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const string& input,
+			const string& output, const StreamConfig& config) {
+	MappedPpm mapped = MapPPM(input);
+	if (mapped.channels != 3 || mapped.bytes_per_sample != 1) {
+		UnmapPPM(mapped);
+		throw std::runtime_error(input + ": only 8-bit RGB images can be streamed");
+	}
+
+	int width = mapped.width, height = mapped.height;
+	int halo = ChainHalo(config.filters, config.params);
+	int strip_rows = std::min(config.strip_rows, height);
+	size_t row_bytes = (size_t)width * 3;
+
+	StreamStats stats;
+	stats.width = width;
+	stats.height = height;
+	stats.strips = 0;
+	stats.device_bytes = 2 * (strip_rows + 2 * halo) * row_bytes;
+	stats.host_bytes = strip_rows * row_bytes;
+	cl::Buffer device[2] = { cl::Buffer(context, CL_MEM_READ_WRITE, stats.device_bytes / 2), cl::Buffer(context, CL_MEM_READ_WRITE, stats.device_bytes / 2) };
+	cl::Buffer host(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, stats.host_bytes);
+	unsigned char* strip = (unsigned char*)queue.enqueueMapBuffer(host, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, stats.host_bytes);
+
+	FILE* file = fopen(output.c_str(), "wb");
+	if (!file) {
+		queue.enqueueUnmapMemObject(host, strip);
+		UnmapPPM(mapped);
+		throw std::runtime_error("cannot create " + output);
+	}
+	fprintf(file, "P6\n%d %d\n%d\n", width, height, mapped.max_value);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	bool written = true;
+	for (int y0 = 0; y0 < height && written; y0 += strip_rows) {
+		int y1 = std::min(y0 + strip_rows, height);
+		int top = std::max(y0 - halo, 0), bottom = std::min(y1 + halo, height);
+
+		queue.enqueueWriteBuffer(device[0], CL_TRUE, 0, (bottom - top) * row_bytes, mapped.pixels + top * row_bytes);
+		int result = 0;
+		for (ImageFilter filter : config.filters) {
+			FilterInterleaved(queue, program, filter, device[result], device[1 - result], width, bottom - top, 3, config.params);
+			result = 1 - result;
+		}
+		queue.enqueueReadBuffer(device[result], CL_TRUE, (y0 - top) * row_bytes, (y1 - y0) * row_bytes, strip);
+		written = fwrite(strip, 1, (y1 - y0) * row_bytes, file) == (y1 - y0) * row_bytes;
+
+		//the next strip starts reading at row y1 - halo
+		DropMappedPages(mapped, std::max(y1 - halo, 0) * row_bytes);
+		stats.strips++;
+	}
+	stats.seconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count() / 1e6;
+
+	fclose(file);
+	queue.enqueueUnmapMemObject(host, strip);
+	queue.finish();
+	UnmapPPM(mapped);
+	if (!written)
+		throw std::runtime_error("cannot write " + output);
+	return stats;
+}
+
+//peak resident memory of the process in kB (VmHWM), 0 if unknown
+long PeakResidentKB() {
+	std::ifstream status("/proc/self/status");
+	string line;
+	while (std::getline(status, line))
+		if (line.compare(0, 6, "VmHWM:") == 0)
+			return atol(line.c_str() + 6);
+	return 0;
+}
+
+void PrintStreamStats(const StreamStats& stats) {
+	size_t pixels = (size_t)stats.width * stats.height;
+	std::cout << stats.width << "x" << stats.height << " in " << stats.strips << " strips, " << std::fixed << std::setprecision(2) << stats.seconds << " s ("
+		<< pixels / 1e6 / stats.seconds << " MPixel/s), device buffers " << stats.device_bytes / 1024 << " kB, pinned strip "
+		<< stats.host_bytes / 1024 << " kB, image " << pixels * 3 / 1024 << " kB, peak resident " << PeakResidentKB() << " kB" << std::endl;
+}
+
+//streams input into output_dir under the same name, like a batch of one image
+void RunStream(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const string& input, const string& output_dir, const StreamConfig& config) {
+	mkdir(output_dir.c_str(), 0755);
+	string output = output_dir + "/" + input.substr(input.find_last_of('/') + 1);
+	PrintStreamStats(StreamImage(context, queue, program, input, output, config));
+}
+
+//streaming with short strips against the chain on the whole image (identical output expected), then a
+//synthetic image larger than a single device allocation that is written to disk strip by strip and streamed,
+//shrunk to what the disk can hold, skipped if that is less than min_megapixels million pixels
+void BenchmarkStream(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const string& image_filename, int min_megapixels = 100) {
+	StreamConfig config;
+	config.filters = { FILTER_GAMMA, FILTER_AVERAGE, FILTER_CONVOLUTION, FILTER_INVERT };
+	config.params.gamma = 1.5f;
+	config.params.range = 2;
+	config.params.mask_size = 5;
+	vector<float> mask = GaussianMask(config.params.mask_size);
+	config.params.mask = cl::Buffer(context, CL_MEM_READ_ONLY, mask.size() * sizeof(float));
+	queue.enqueueWriteBuffer(config.params.mask, CL_TRUE, 0, mask.size() * sizeof(float), &mask[0]);
+	config.strip_rows = 37; //not a divisor of the height, so the last strip is shorter
+	std::cout << "Streaming " << image_filename << " with a halo of " << ChainHalo(config.filters, config.params) << " rows" << std::endl;
+
+	PpmImage image = ReadPPM(image_filename);
+	if (image.channels != 3 || image.bytes_per_sample != 1) {
+		std::cout << "The stream benchmark expects an 8-bit RGB image" << std::endl;
+		return;
+	}
+	cl::Buffer device[2] = { cl::Buffer(context, CL_MEM_READ_WRITE, image.payload), cl::Buffer(context, CL_MEM_READ_WRITE, image.payload) };
+	queue.enqueueWriteBuffer(device[0], CL_TRUE, 0, image.payload, &image.data[0]);
+	int result = 0;
+	for (ImageFilter filter : config.filters) {
+		FilterInterleaved(queue, program, filter, device[result], device[1 - result], image.width, image.height, 3, config.params);
+		result = 1 - result;
+	}
+	vector<unsigned char> whole(image.payload);
+	queue.enqueueReadBuffer(device[result], CL_TRUE, 0, image.payload, &whole[0]);
+
+	StreamStats stats = StreamImage(context, queue, program, image_filename, "streamed.ppm", config);
+	PpmImage streamed = ReadPPM("streamed.ppm");
+	remove("streamed.ppm");
+	PrintStreamStats(stats);
+	std::cout << "strips against the whole image: " << (streamed.data == whole ? "OK" : "FAILED") << std::endl;
+
+	//a synthetic image one row larger than a single device allocation, so that it could not be filtered whole,
+	//generated strip by strip; as much of it as the disk can hold together with its streamed copy
+	int width = 16384;
+	cl_ulong max_alloc = context.getInfo<CL_CONTEXT_DEVICES>()[0].getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+	unsigned long long rows = max_alloc / (width * 3) + 1;
+	struct statvfs disk;
+	unsigned long long disk_rows = statvfs(".", &disk) != 0 ? 0 : (unsigned long long)disk.f_bavail * disk.f_frsize / (2ull * width * 3);
+	if (disk_rows < rows)
+		rows = disk_rows;
+	int height = (int)rows;
+	if ((long long)width * height < (long long)min_megapixels * 1000000) {
+		std::cout << "Skipping the synthetic image, the disk cannot hold " << min_megapixels << " MPixel and its streamed copy ("
+			<< 2ull * min_megapixels * 1000000 * 3 / (1 << 20) << " MB)" << std::endl;
+		return;
+	}
+	std::cout << "synthetic image of " << (long long)width * height / 1000000 << " MPixel, "
+		<< ((cl_ulong)width * height * 3 > max_alloc ? "larger" : "smaller (disk space)") << " than the "
+		<< max_alloc / (1 << 20) << " MB device allocation limit" << std::endl;
+	FILE* file = fopen("synthetic_stream.ppm", "wb");
+	if (!file)
+		throw std::runtime_error("cannot create synthetic_stream.ppm");
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	vector<unsigned char> row(width * 3);
+	for (int y = 0; y < height; y++) {
+		for (size_t i = 0; i < row.size(); i++)
+			row[i] = (unsigned char)(((size_t)y * row.size() + i) * 2654435761u >> 24);
+		fwrite(&row[0], 1, row.size(), file);
+	}
+	fclose(file);
+
+	config.strip_rows = 256;
+	stats = StreamImage(context, queue, program, "synthetic_stream.ppm", "synthetic_streamed.ppm", config);
+	PrintStreamStats(stats);
+	remove("synthetic_stream.ppm");
+	remove("synthetic_streamed.ppm");
+}
@@ -223,3 +223,27 @@ string GetFullProfilingInfo(const cl::Event& evnt, ProfilingResolution resolutio
 
 	return sstream.str();
 }
+
+//time a command spent executing on the device, in the given resolution
+double GetExecutionTime(const cl::Event& evnt, ProfilingResolution resolution = PROF_NS) {
+	return (double)(evnt.getProfilingInfo<CL_PROFILING_COMMAND_END>() - evnt.getProfilingInfo<CL_PROFILING_COMMAND_START>()) / resolution;
+}
+
+//builds a program from source code held in memory (e.g. generated on the fly), prints the build log on failure
+cl::Program BuildProgramSource(const cl::Context& context, const string& source, const string& options = "") {
+	cl::Program::Sources sources;
+	sources.push_back(source.c_str());
+	cl::Program program(context, sources);
+
+	try {
+		program.build(options.c_str());
+	}
+	catch (const cl::Error& err) {
+		std::cout << "Build Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
+		std::cout << "Build Options:\t" << program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
+		std::cout << "Build Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
+		throw err;
+	}
+
+	return program;
+}
@@ -0,0 +1,375 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <iomanip>
+
+#include "Utils.h"
+#include "CImg.h"
+#include "ImagePath.h"
+#include "Interleaved.h"
+#include "Ppm.h"
+
+//continuous processing of a stream of 8-bit RGB frames, raw frames of a fixed size or concatenated PPM images,
+//from a file or stdin to stdout: buffers and kernels are created once for the first frame and reused by all
+//others; with two buffers the next frame is read from the source while the previous one is still on the
+//device, uploads, kernels and readbacks have a queue each so they overlap across frames; temporal filters
+//keep their state (the last frames) on the device
+
+struct VideoConfig {
+	int width = 0, height = 0;	//size of raw frames, 0 for concatenated PPM frames
+	int buffers = 2;		//frames in flight, 1 finishes every frame before reading the next
+	int temporal = 0;		//frames of the running average after the filter chain, 0 for none
+	vector<ImageFilter> filters = { FILTER_GAMMA, FILTER_CONVOLUTION };
+	FilterParams params;
+};
+
+//everything one frame in flight needs, reused by every buffers-th frame
+struct VideoSlot {
+	cl::Buffer host_input, host_output;	//pinned, mapped for the whole run
+	unsigned char* input;
+	unsigned char* output;
+	cl::Buffer device[2];			//ping-pong buffers of the chain, the frame is uploaded into device[0]
+	vector<cl::Kernel> chain;		//the filters with their arguments set
+	cl::Kernel temporal;
+	int result;				//device buffer holding the output
+	cl::Event uploaded, computed, downloaded;
+	std::chrono::high_resolution_clock::time_point arrival;	//when the frame had been read from the source
+};
+
+struct VideoStats {
+	int width, height;
+	int frames;
+	double seconds;
+	vector<double> latency_ms;	//from reading a frame to writing its result, per frame
+};
+
+//reads the header of the next image of concatenated PPM files, false at the end of the stream; only the
+//header is consumed, the pixels follow
+bool ReadPpmStreamHeader(FILE* file, PpmHeader& header) {
+	int c;
+	while ((c = fgetc(file)) != EOF && isspace(c))
+		;
+	if (c == EOF)
+		return false;
+	if (c != 'P' || fgetc(file) != '6')
+		throw std::runtime_error("frames have to be binary RGB PPM images");
+
+	//the three numbers and their comments, up to the whitespace character after the last one
+	vector<unsigned char> text;
+	int numbers = 0;
+	bool digits = false;
+	while (numbers < 3 && (c = fgetc(file)) != EOF) {
+		if (c == '#')
+			while (c != '\n' && c != EOF)
+				c = fgetc(file);
+		if (c == EOF)
+			break;
+		text.push_back((unsigned char)c);
+		if (isdigit(c))
+			digits = true;
+		else if (digits) {
+			digits = false;
+			numbers++;
+		}
+	}
+	if (numbers < 3)
+		throw std::runtime_error("truncated PPM frame header");
+
+	size_t pos = 0;
+	header.width = ParsePpmNumber(&text[0], text.size(), pos);
+	header.height = ParsePpmNumber(&text[0], text.size(), pos);
+	header.max_value = ParsePpmNumber(&text[0], text.size(), pos);
+	if (header.max_value < 1 || header.max_value > 255)
+		throw std::runtime_error("frames have to be 8-bit PPM images");
+	header.channels = 3;
+	header.bytes_per_sample = 1;
+	header.payload = (size_t)header.width * header.height * 3;
+	return true;
+}
+
+//runs the filter chain and the temporal filter of config over every frame of source and writes the results to
+//sink in the format of the source; all frames need the size of the first
+VideoStats ProcessFrames(const cl::Context& context, cl::Program& program, FILE* source, FILE* sink, const VideoConfig& config) {
+	bool ppm = !config.width;
+	PpmHeader header;
+	VideoStats stats;
+	stats.frames = 0;
+	stats.seconds = 0;
+	if (ppm) {
+		if (!ReadPpmStreamHeader(source, header)) {
+			stats.width = stats.height = 0;
+			return stats;
+		}
+	}
+	else
+		header = MakePpmHeader(config.width, config.height, 3);
+	int width = header.width, height = header.height;
+	size_t bytes = header.payload;
+	stats.width = width;
+	stats.height = height;
+
+	cl::CommandQueue upload(context), compute(context), download(context);
+	vector<VideoSlot> slots(std::max(config.buffers, 1));
+	cl::Buffer ring, sums;
+	if (config.temporal) {
+		ring = cl::Buffer(context, CL_MEM_READ_WRITE, bytes * config.temporal);
+		sums = cl::Buffer(context, CL_MEM_READ_WRITE, bytes * sizeof(cl_uint));
+		compute.enqueueFillBuffer(ring, (cl_uchar)0, 0, bytes * config.temporal);
+		compute.enqueueFillBuffer(sums, (cl_uint)0, 0, bytes * sizeof(cl_uint));
+	}
+	for (VideoSlot& slot : slots) {
+		slot.host_input = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, bytes);
+		slot.host_output = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, bytes);
+		slot.input = (unsigned char*)upload.enqueueMapBuffer(slot.host_input, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, bytes);
+		slot.output = (unsigned char*)upload.enqueueMapBuffer(slot.host_output, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, bytes);
+		slot.device[0] = cl::Buffer(context, CL_MEM_READ_WRITE, bytes);
+		slot.device[1] = cl::Buffer(context, CL_MEM_READ_WRITE, bytes);
+		slot.result = 0;
+		for (ImageFilter filter : config.filters) {
+			slot.chain.push_back(InterleavedKernel(program, filter, slot.device[slot.result], slot.device[1 - slot.result], 3, config.params));
+			slot.result = 1 - slot.result;
+		}
+		if (config.temporal) {
+			slot.temporal = cl::Kernel(program, "temporal_average");
+			slot.temporal.setArg(0, slot.device[slot.result]);
+			slot.temporal.setArg(1, ring);
+			slot.temporal.setArg(2, sums);
+			slot.temporal.setArg(3, slot.device[1 - slot.result]);
+			slot.result = 1 - slot.result;
+		}
+	}
+	compute.finish();
+
+	bool written = true;
+	auto finish = [&](VideoSlot& slot) {
+		slot.downloaded.wait();
+		if (ppm)
+			fprintf(sink, "P6\n%d %d\n255\n", width, height);
+		written = fwrite(slot.output, 1, bytes, sink) == bytes && written;
+		//whoever reads the stream gets every frame as soon as it is done
+		fflush(sink);
+		stats.latency_ms.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - slot.arrival).count() / 1000.0);
+	};
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::deque<int> in_flight;
+	for (int frame = 0; written; frame++) {
+		int s = frame % (int)slots.size();
+		VideoSlot& slot = slots[s];
+		//the header of the first frame has been read already
+		PpmHeader next;
+		if (ppm && frame > 0) {
+			if (!ReadPpmStreamHeader(source, next))
+				break;
+			if (next.width != width || next.height != height)
+				throw std::runtime_error("all frames need the size of the first");
+		}
+		size_t got = fread(slot.input, 1, bytes, source);
+		if (got < bytes) {
+			if (got)
+				std::cerr << "the incomplete last frame is dropped" << std::endl;
+			break;
+		}
+		slot.arrival = std::chrono::high_resolution_clock::now();
+
+		//the slot's previous frame is finished, so its buffers are free
+		upload.enqueueWriteBuffer(slot.device[0], CL_FALSE, 0, bytes, slot.input, NULL, &slot.uploaded);
+		vector<cl::Event> wait = { slot.uploaded };
+		compute.enqueueBarrierWithWaitList(&wait);
+		for (cl::Kernel& kernel : slot.chain)
+			compute.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(width, height), cl::NullRange);
+		if (config.temporal) {
+			slot.temporal.setArg(4, frame % config.temporal);
+			slot.temporal.setArg(5, std::min(frame + 1, config.temporal));
+			compute.enqueueNDRangeKernel(slot.temporal, cl::NullRange, cl::NDRange(bytes), cl::NullRange);
+		}
+		compute.enqueueMarkerWithWaitList(NULL, &slot.computed);
+		wait = { slot.computed };
+		download.enqueueReadBuffer(slot.device[slot.result], CL_FALSE, 0, bytes, slot.output, &wait, &slot.downloaded);
+		upload.flush();
+		compute.flush();
+		download.flush();
+
+		in_flight.push_back(s);
+		if (in_flight.size() == slots.size()) {
+			finish(slots[in_flight.front()]);
+			in_flight.pop_front();
+		}
+		stats.frames++;
+	}
+	for (; !in_flight.empty(); in_flight.pop_front())
+		finish(slots[in_flight.front()]);
+	stats.seconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count() / 1e6;
+
+	for (VideoSlot& slot : slots) {
+		upload.enqueueUnmapMemObject(slot.host_input, slot.input);
+		upload.enqueueUnmapMemObject(slot.host_output, slot.output);
+	}
+	upload.finish();
+	if (!written)
+		throw std::runtime_error("cannot write the output frames");
+	return stats;
+}
+
+//the latency below which the given fraction of frames stayed
+double LatencyPercentile(vector<double> latency_ms, double fraction) {
+	if (latency_ms.empty())
+		return 0;
+	size_t i = std::min((size_t)(fraction * latency_ms.size()), latency_ms.size() - 1);
+	std::nth_element(latency_ms.begin(), latency_ms.begin() + i, latency_ms.end());
+	return latency_ms[i];
+}
+
+void PrintVideoStats(const VideoStats& stats, std::ostream& out) {
+	out << stats.frames << " frames of " << stats.width << "x" << stats.height << " in " << std::fixed << std::setprecision(2) << stats.seconds << " s, "
+		<< std::setprecision(1) << (stats.seconds > 0 ? stats.frames / stats.seconds : 0) << " frames/s, latency [ms] p50 "
+		<< LatencyPercentile(stats.latency_ms, 0.5) << ", p90 " << LatencyPercentile(stats.latency_ms, 0.9) << ", p99 "
+		<< LatencyPercentile(stats.latency_ms, 0.99) << ", max " << LatencyPercentile(stats.latency_ms, 1.0) << std::endl;
+}
+
+//frames from input ("-" for stdin) to stdout, the statistics go to stderr so they do not mix with the frames
+void RunVideo(const cl::Context& context, cl::Program& program, const string& input, const VideoConfig& config) {
+	FILE* source = input == "-" ? stdin : fopen(input.c_str(), "rb");
+	if (!source)
+		throw std::runtime_error("cannot open " + input);
+	VideoStats stats;
+	try {
+		stats = ProcessFrames(context, program, source, stdout, config);
+	}
+	catch (...) {
+		if (source != stdin)
+			fclose(source);
+		throw;
+	}
+	if (source != stdin)
+		fclose(source);
+	PrintVideoStats(stats, std::cerr);
+}
+
+//noisy frames of the input image: a single frame in flight against two, the running average against the
+//host and its effect on the noise, and concatenated PPM frames passing through unchanged
+void BenchmarkVideo(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program, const cimg_library::CImg<unsigned char>& image) {
+	if (image.spectrum() != 3) {
+		std::cout << "The video benchmark expects an RGB image" << std::endl;
+		return;
+	}
+	int width = image.width(), height = image.height();
+	size_t bytes = (size_t)width * height * 3;
+	int frames = (int)std::max((size_t)16, std::min((size_t)120, ((size_t)256 << 20) / bytes));
+
+	//the interleaved image with noise of up to +-24 that differs from frame to frame
+	vector<unsigned char> clean(bytes);
+	for (int c = 0; c < 3; c++)
+		for (size_t i = 0; i < (size_t)width * height; i++)
+			clean[i * 3 + c] = image.data()[c * (size_t)width * height + i];
+	vector<unsigned char> noisy((size_t)frames * bytes);
+	for (size_t i = 0; i < noisy.size(); i++) {
+		int noise = (int)((i * 2654435761u) >> 26) % 49 - 24;
+		noisy[i] = (unsigned char)std::min(std::max(clean[i % bytes] + noise, 0), 255);
+	}
+	FILE* file = fopen("video_input.raw", "wb");
+	if (!file)
+		throw std::runtime_error("cannot create video_input.raw");
+	fwrite(&noisy[0], 1, noisy.size(), file);
+	fclose(file);
+
+	auto run = [&](const VideoConfig& config, vector<unsigned char>& output) {
+		FILE* source = fopen("video_input.raw", "rb");
+		FILE* sink = fopen("video_output.raw", "wb");
+		if (!source || !sink)
+			throw std::runtime_error("cannot open the video benchmark files");
+		VideoStats stats = ProcessFrames(context, program, source, sink, config);
+		fclose(source);
+		fclose(sink);
+		output.resize(noisy.size());
+		sink = fopen("video_output.raw", "rb");
+		bool complete = fread(&output[0], 1, output.size(), sink) == output.size();
+		fclose(sink);
+		if (!complete)
+			throw std::runtime_error("video_output.raw is incomplete");
+		return stats;
+	};
+
+	VideoConfig config;
+	config.width = width;
+	config.height = height;
+	config.params.gamma = 1.5f;
+	config.params.range = 2;
+	config.params.mask_size = 5;
+	vector<float> mask = GaussianMask(config.params.mask_size);
+	config.params.mask = cl::Buffer(context, CL_MEM_READ_ONLY, mask.size() * sizeof(float));
+	queue.enqueueWriteBuffer(config.params.mask, CL_TRUE, 0, mask.size() * sizeof(float), &mask[0]);
+
+	std::cout << "gamma, convolution on " << frames << " raw frames" << std::endl;
+	vector<unsigned char> single, both;
+	config.buffers = 1;
+	std::cout << "1 buffer:  ";
+	PrintVideoStats(run(config, single), std::cout);
+	config.buffers = 2;
+	std::cout << "2 buffers: ";
+	PrintVideoStats(run(config, both), std::cout);
+	std::cout << "same frames: " << (single == both ? "OK" : "FAILED") << std::endl;
+
+	//running averages alone, the reference sums the same frames on the host
+	config.filters.clear();
+	std::cout << "running average, mean error against the clean image:";
+	for (int temporal : { 1, 4, 8 }) {
+		config.temporal = temporal;
+		vector<unsigned char> output;
+		run(config, output);
+		bool correct = true;
+		double error = 0;
+		for (int f = 0; f < frames; f++) {
+			int count = std::min(f + 1, temporal);
+			for (size_t i = 0; i < bytes; i++) {
+				unsigned int sum = 0;
+				for (int k = f - count + 1; k <= f; k++)
+					sum += noisy[k * bytes + i];
+				unsigned char value = output[f * bytes + i];
+				correct = correct && value == (sum + count / 2) / count;
+				if (f == frames - 1)
+					error += abs((int)value - (int)clean[i]);
+			}
+		}
+		std::cout << " " << temporal << " frames " << std::setprecision(2) << error / bytes << (correct ? " (OK)" : " (FAILED)");
+	}
+	std::cout << std::endl;
+
+	//the same frames as concatenated PPM images, with a comment in the first header
+	file = fopen("video_input.raw", "wb");
+	if (!file)
+		throw std::runtime_error("cannot create video_input.raw");
+	for (int f = 0; f < frames; f++) {
+		fprintf(file, f ? "P6\n%d %d\n255\n" : "P6\n# frames\n%d %d\n255\n", width, height);
+		fwrite(&noisy[f * bytes], 1, bytes, file);
+	}
+	fclose(file);
+	config.width = config.height = 0;
+	config.temporal = 0;
+	config.filters = { FILTER_IDENTITY };
+	FILE* source = fopen("video_input.raw", "rb");
+	FILE* sink = fopen("video_output.raw", "wb");
+	if (!source || !sink)
+		throw std::runtime_error("cannot open the video benchmark files");
+	VideoStats stats = ProcessFrames(context, program, source, sink, config);
+	fclose(source);
+	fclose(sink);
+	bool correct = stats.frames == frames;
+	sink = fopen("video_output.raw", "rb");
+	for (int f = 0; correct && f < frames; f++) {
+		PpmHeader header;
+		vector<unsigned char> frame(bytes);
+		correct = ReadPpmStreamHeader(sink, header) && header.width == width && header.height == height
+			&& fread(&frame[0], 1, bytes, sink) == bytes && std::equal(frame.begin(), frame.end(), noisy.begin() + f * bytes);
+	}
+	fclose(sink);
+	std::cout << "PPM frames: ";
+	PrintVideoStats(stats, std::cout);
+	std::cout << "PPM frames unchanged: " << (correct ? "OK" : "FAILED") << std::endl;
+	remove("video_input.raw");
+	remove("video_output.raw");
+}
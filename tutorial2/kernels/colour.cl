@@ -0,0 +1,180 @@
+//colour space conversions of 8-bit images in either layout: sample c of pixel id is at id*layout.x + c*layout.y,
+//i.e. layout (1, image_size) for planar and (channels, 1) for interleaved images; one work-item per pixel
+//the float versions round to the nearest, the fixed-point versions use integer weights with 16 fractional bits
+//8-bit encodings: gray and YCbCr full range (BT.709 luma for gray like rgb2gray, BT.601/JPEG for YCbCr),
+//HSV with the hue over the whole 0..255 range, Lab as L*255/100, a+128, b+128 (sRGB, D65)
+
+#define COLOUR_RGB_TO_GRAY 0
+#define COLOUR_RGB_TO_YCBCR 1
+#define COLOUR_YCBCR_TO_RGB 2
+#define COLOUR_RGB_TO_HSV 3
+#define COLOUR_HSV_TO_RGB 4
+#define COLOUR_RGB_TO_LAB 5
+#define COLOUR_LAB_TO_RGB 6
+
+int3 load_pixel(global const uchar* A, int id, int2 layout) {
+	int i = id*layout.x;
+	return (int3)(A[i], A[i + layout.y], A[i + 2*layout.y]);
+}
+
+void store_pixel(global uchar* B, int id, int2 layout, int3 p) {
+	int i = id*layout.x;
+	uchar3 v = convert_uchar3_sat(p);
+	B[i] = v.x;
+	B[i + layout.y] = v.y;
+	B[i + 2*layout.y] = v.z;
+}
+
+uchar rgb_to_gray(int3 p, int fixed_point) {
+	if (fixed_point)
+		return (13933*p.x + 46871*p.y + 4732*p.z + 32768) >> 16;
+	return convert_uchar_sat_rte(dot(convert_float3(p), (float3)(0.2126f, 0.7152f, 0.0722f)));
+}
+
+//the fixed-point chroma numerators are offset by 128 << 16 and can never be negative
+int3 rgb_to_ycbcr(int3 p, int fixed_point) {
+	if (fixed_point)
+		return (int3)((19595*p.x + 38470*p.y + 7471*p.z + 32768) >> 16,
+			(-11059*p.x - 21709*p.y + 32768*p.z + (128 << 16) + 32768) >> 16,
+			(32768*p.x - 27439*p.y - 5329*p.z + (128 << 16) + 32768) >> 16);
+	float3 f = convert_float3(p);
+	return convert_int3_rte((float3)(dot(f, (float3)(0.299f, 0.587f, 0.114f)),
+		128.0f + dot(f, (float3)(-0.168736f, -0.331264f, 0.5f)),
+		128.0f + dot(f, (float3)(0.5f, -0.418688f, -0.081312f))));
+}
+
+//the fixed-point sums are offset by 256 << 16 so that the shift never sees a negative value
+int3 ycbcr_to_rgb(int3 p, int fixed_point) {
+	int y = p.x, cb = p.y - 128, cr = p.z - 128;
+	if (fixed_point)
+		return (int3)(((y << 16) + 91881*cr + (256 << 16) + 32768) >> 16,
+			((y << 16) - 22554*cb - 46802*cr + (256 << 16) + 32768) >> 16,
+			((y << 16) + 116130*cb + (256 << 16) + 32768) >> 16) - 256;
+	return convert_int3_rte((float3)(y + 1.402f*cr, y - 0.344136f*cb - 0.714136f*cr, y + 1.772f*cb));
+}
+
+//hue in 1/256 turns, 0 for grays; the fixed-point version divides integers instead of floats
+int3 rgb_to_hsv(int3 p, int fixed_point) {
+	int v = max(max(p.x, p.y), p.z), d = v - min(min(p.x, p.y), p.z);
+	if (d == 0)
+		return (int3)(0, 0, v);
+	//position on the hue circle in units of d, sectors of 6 starting at red; 6*d is added to red's so it stays positive
+	int turn = (v == p.x) ? 6*d + p.y - p.z : (v == p.y) ? 2*d + p.z - p.x : 4*d + p.x - p.y;
+	if (fixed_point)
+		return (int3)(((turn*256 + 3*d) / (6*d)) & 255, (255*d + v/2) / v, v);
+	return (int3)(convert_int_rte(turn * 256.0f / (6*d)) & 255, convert_int_rte(255.0f * d / v), v);
+}
+
+int3 hsv_to_rgb(int3 hsv) {
+	float h = hsv.x * 6.0f / 256.0f, s = hsv.y / 255.0f, v = hsv.z;
+	int sector = (int)h;
+	float f = h - sector;
+	float p = v * (1.0f - s), q = v * (1.0f - s*f), t = v * (1.0f - s*(1.0f - f));
+	float3 rgb;
+	switch (sector) {
+		case 0: rgb = (float3)(v, t, p); break;
+		case 1: rgb = (float3)(q, v, p); break;
+		case 2: rgb = (float3)(p, v, t); break;
+		case 3: rgb = (float3)(p, q, v); break;
+		case 4: rgb = (float3)(t, p, v); break;
+		default: rgb = (float3)(v, p, q); break;
+	}
+	return convert_int3_rte(rgb);
+}
+
+float srgb_to_linear(float c) {
+	return c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+float linear_to_srgb(float c) {
+	return c <= 0.0031308f ? 12.92f * c : 1.055f * pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+float lab_f(float t) {
+	return t > 0.008856f ? cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+}
+
+float lab_f_inverse(float f) {
+	return f > 0.206893f ? f*f*f : (f - 16.0f / 116.0f) / 7.787f;
+}
+
+int3 rgb_to_lab(int3 p) {
+	float3 c = (float3)(srgb_to_linear(p.x / 255.0f), srgb_to_linear(p.y / 255.0f), srgb_to_linear(p.z / 255.0f));
+	//XYZ relative to the D65 white
+	float fx = lab_f(dot(c, (float3)(0.4124564f, 0.3575761f, 0.1804375f)) / 0.95047f);
+	float fy = lab_f(dot(c, (float3)(0.2126729f, 0.7151522f, 0.0721750f)));
+	float fz = lab_f(dot(c, (float3)(0.0193339f, 0.1191920f, 0.9503041f)) / 1.08883f);
+	return convert_int3_rte((float3)((116.0f*fy - 16.0f) * 2.55f, 500.0f*(fx - fy) + 128.0f, 200.0f*(fy - fz) + 128.0f));
+}
+
+int3 lab_to_rgb(int3 p) {
+	float fy = (p.x / 2.55f + 16.0f) / 116.0f;
+	float fx = fy + (p.y - 128.0f) / 500.0f, fz = fy - (p.z - 128.0f) / 200.0f;
+	float3 xyz = (float3)(lab_f_inverse(fx) * 0.95047f, lab_f_inverse(fy), lab_f_inverse(fz) * 1.08883f);
+	float3 c = (float3)(dot(xyz, (float3)(3.2404542f, -1.5371385f, -0.4985314f)),
+		dot(xyz, (float3)(-0.9692660f, 1.8760108f, 0.0415560f)),
+		dot(xyz, (float3)(0.0556434f, -0.2040259f, 1.0572252f)));
+	c = clamp(c, 0.0f, 1.0f);
+	return convert_int3_rte((float3)(linear_to_srgb(c.x), linear_to_srgb(c.y), linear_to_srgb(c.z)) * 255.0f);
+}
+
+//one conversion per launch, global size (image_size); gray writes a single channel at id*out_layout.x
+kernel void colour_convert(global const uchar* A, global uchar* B, const int conversion, const int fixed_point, const int2 in_layout, const int2 out_layout) {
+	int id = get_global_id(0);
+	int3 p = load_pixel(A, id, in_layout);
+	switch (conversion) {
+		case COLOUR_RGB_TO_GRAY: B[id*out_layout.x] = rgb_to_gray(p, fixed_point); return;
+		case COLOUR_RGB_TO_YCBCR: p = rgb_to_ycbcr(p, fixed_point); break;
+		case COLOUR_YCBCR_TO_RGB: p = ycbcr_to_rgb(p, fixed_point); break;
+		case COLOUR_RGB_TO_HSV: p = rgb_to_hsv(p, fixed_point); break;
+		case COLOUR_HSV_TO_RGB: p = hsv_to_rgb(p); break;
+		case COLOUR_RGB_TO_LAB: p = rgb_to_lab(p); break;
+		default: p = lab_to_rgb(p); break;
+	}
+	store_pixel(B, id, out_layout, p);
+}
+
+//RGB to planar Y, Cb and Cr with the chroma subsampled in the same pass: every work-item converts a block
+//of 2x1 (4:2:2) or 2x2 (4:2:0) pixels, writes their luma and the rounded mean of their chroma; blocks at odd
+//edges are smaller; global size (chroma_width, chroma_height)
+kernel void rgb_to_ycbcr_subsampled(global const uchar* A, global uchar* Y, global uchar* Cb, global uchar* Cr,
+			const int width, const int height, const int block_height, const int fixed_point, const int2 layout) {
+	int cx = get_global_id(0), cy = get_global_id(1);
+	int x0 = 2*cx, y0 = cy*block_height;
+	int x1 = min(x0 + 2, width), y1 = min(y0 + block_height, height);
+	int count = (x1 - x0) * (y1 - y0);
+
+	//fixed point: the 16.16 chroma numerators are summed and divided once
+	int2 sum = (int2)(0);
+	float2 fsum = (float2)(0.0f);
+	for (int y = y0; y < y1; y++)
+		for (int x = x0; x < x1; x++) {
+			int id = x + y*width;
+			int3 p = load_pixel(A, id, layout);
+			int3 ycc = rgb_to_ycbcr(p, fixed_point);
+			Y[id] = ycc.x;
+			if (fixed_point)
+				sum += (int2)(-11059*p.x - 21709*p.y + 32768*p.z, 32768*p.x - 27439*p.y - 5329*p.z) + (128 << 16);
+			else
+				fsum += 128.0f + (float2)(dot(convert_float3(p), (float3)(-0.168736f, -0.331264f, 0.5f)), dot(convert_float3(p), (float3)(0.5f, -0.418688f, -0.081312f)));
+		}
+
+	int chroma = cx + cy*get_global_size(0);
+	if (fixed_point) {
+		int2 c = (sum + count*32768) / (count << 16);
+		Cb[chroma] = min(c.x, 255);
+		Cr[chroma] = min(c.y, 255);
+	}
+	else {
+		Cb[chroma] = convert_uchar_sat_rte(fsum.x / count);
+		Cr[chroma] = convert_uchar_sat_rte(fsum.y / count);
+	}
+}
+
+//subsampled planar YCbCr back to RGB, the chroma of a block is used for all its pixels; global size (width, height)
+kernel void ycbcr_subsampled_to_rgb(global const uchar* Y, global const uchar* Cb, global const uchar* Cr, global uchar* B,
+			const int chroma_width, const int block_height, const int fixed_point, const int2 layout) {
+	int x = get_global_id(0), y = get_global_id(1);
+	int id = x + y*get_global_size(0), chroma = x/2 + (y/block_height)*chroma_width;
+	store_pixel(B, id, layout, ycbcr_to_rgb((int3)(Y[id], Cb[chroma], Cr[chroma]), fixed_point));
+}
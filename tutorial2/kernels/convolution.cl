@@ -0,0 +1,130 @@
+//separable convolution: a mask that is the outer product of a column and a row vector
+//(mask[x + y*mask_size] = column[y] * row[x], e.g. box and Gaussian masks) is applied as a
+//horizontal pass into a float intermediate followed by a vertical pass, so each pixel costs
+//2*mask_size instead of mask_size^2 multiply-adds
+//both passes use the same indexing and zero border as convolutionND, so the results match it
+//up to float rounding
+
+//horizontal pass: B(x, y, c) = sum_i row[i] * A(x + i - offset, y, c)
+kernel void convolution_rows(global const uchar* A, global float* B, constant float* row, const int mask_size) {
+	int width = get_global_size(0); //image width in pixels
+	int height = get_global_size(1); //image height in pixels
+	int image_size = width*height; //image size in pixels
+
+	int x = get_global_id(0); //current x coord.
+	int y = get_global_id(1); //current y coord.
+	int c = get_global_id(2); //current colour channel
+
+	int line = y*width + c*image_size; //start of the current row
+	int offset = mask_size / 2;
+
+	float result = 0;
+	for (int i = max(0, offset - x); i < min(mask_size, width + offset - x); i++)
+		result += A[line + x + i - offset] * row[i];
+
+	B[line + x] = result;
+}
+
+//vertical pass: B(x, y, c) = clamp(sum_j column[j] * A(x, y + j - offset, c))
+kernel void convolution_columns(global const float* A, global uchar* B, constant float* column, const int mask_size) {
+	int width = get_global_size(0); //image width in pixels
+	int height = get_global_size(1); //image height in pixels
+	int image_size = width*height; //image size in pixels
+
+	int x = get_global_id(0); //current x coord.
+	int y = get_global_id(1); //current y coord.
+	int c = get_global_id(2); //current colour channel
+
+	int plane = x + c*image_size; //current column of the current channel
+	int offset = mask_size / 2;
+
+	float result = 0;
+	for (int j = max(0, offset - y); j < min(mask_size, height + offset - y); j++)
+		result += A[plane + (y + j - offset)*width] * column[j];
+
+	B[plane + y*width] = (uchar)clamp(result, 0.0f, 255.0f);
+}
+
+//local-memory tiling: every work-group first copies the pixels its outputs need (the tile plus a halo
+//of offset pixels on each side, all channels) into local memory with coalesced reads, so each input
+//pixel is fetched from global memory once per work-group instead of up to mask_size^2 times
+//a work-group of TX x TY work-items produces TX x (TY*ppt) pixels: each work-item handles all channels
+//of ppt pixels spaced TY rows apart; the global size is (width, height/ppt) padded to the local size
+//pixels outside the image are stored as 0 which matches the skipped terms of the untiled kernels
+
+//tile holds channels planes of (TX + 2*offset) x (TY*ppt + 2*offset) pixels
+void load_tile(global const uchar* A, local uchar* tile, const int width, const int height, const int channels,
+			const int ppt, const int offset) {
+	int TX = get_local_size(0), TY = get_local_size(1);
+	int tile_width = TX + 2 * offset;
+	int tile_size = tile_width * (TY * ppt + 2 * offset);
+	int x0 = get_group_id(0) * TX - offset;
+	int y0 = get_group_id(1) * TY * ppt - offset;
+
+	for (int k = get_local_id(0) + get_local_id(1) * TX; k < tile_size * channels; k += TX * TY) {
+		int c = k / tile_size;
+		int x = x0 + (k % tile_size) % tile_width;
+		int y = y0 + (k % tile_size) / tile_width;
+		tile[k] = (x >= 0 && x < width && y >= 0 && y < height) ? A[x + y*width + c*width*height] : 0;
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+//tiled convolutionND, same accumulation order so the results are identical
+kernel void convolution_tiled(global const uchar* A, global uchar* B, constant float* mask, const int mask_size,
+			const int width, const int height, const int channels, const int ppt, local uchar* tile) {
+	int offset = mask_size / 2;
+	load_tile(A, tile, width, height, channels, ppt, offset);
+
+	int TX = get_local_size(0), TY = get_local_size(1);
+	int lx = get_local_id(0), ly = get_local_id(1);
+	int tile_width = TX + 2 * offset;
+	int tile_size = tile_width * (TY * ppt + 2 * offset);
+	int x = get_group_id(0) * TX + lx;
+
+	for (int p = 0; p < ppt; p++) {
+		int ty = ly + p * TY; //row of the output inside the tile
+		int y = get_group_id(1) * TY * ppt + ty;
+		if (x >= width || y >= height)
+			continue;
+
+		for (int c = 0; c < channels; c++) {
+			local const uchar* plane = tile + c * tile_size + lx + ty * tile_width;
+			float result = 0;
+			for (int i = 0; i < mask_size; i++)
+				for (int j = 0; j < mask_size; j++)
+					result += plane[i + j * tile_width] * mask[i + j * mask_size];
+			B[x + y*width + c*width*height] = (uchar)clamp(result, 0.0f, 255.0f);
+		}
+	}
+}
+
+//tiled average filter over a (2*range+1)^2 window, pixels outside the image count as 0 like in avg_filterND
+kernel void avg_filter_tiled(global const uchar* A, global uchar* B, const int range,
+			const int width, const int height, const int channels, const int ppt, local uchar* tile) {
+	load_tile(A, tile, width, height, channels, ppt, range);
+
+	int TX = get_local_size(0), TY = get_local_size(1);
+	int lx = get_local_id(0), ly = get_local_id(1);
+	int tile_width = TX + 2 * range;
+	int tile_size = tile_width * (TY * ppt + 2 * range);
+	int x = get_group_id(0) * TX + lx;
+	int window = 2 * range + 1;
+
+	for (int p = 0; p < ppt; p++) {
+		int ty = ly + p * TY;
+		int y = get_group_id(1) * TY * ppt + ty;
+		if (x >= width || y >= height)
+			continue;
+
+		for (int c = 0; c < channels; c++) {
+			local const uchar* plane = tile + c * tile_size + lx + ty * tile_width;
+			uint result = 0;
+			for (int j = 0; j < window; j++)
+				for (int i = 0; i < window; i++)
+					result += plane[i + j * tile_width];
+			B[x + y*width + c*width*height] = (uchar)(result / (window * window));
+		}
+	}
+}
@@ -0,0 +1,142 @@
+//histogram equalisation of planar uchar images, every channel separately, and CLAHE
+//the histograms are built like tutorial3's hist_simple but privatised: each work-group counts into its own
+//histogram in local memory and merges it into the global one once, so the global atomics are per bin and
+//work-group instead of per pixel; the CDF is a scan of the 256 bins (scan_add) by a single work-group
+
+//double-buffered Hillis-Steele inclusive scan of get_local_size(0) values (scan_add), returns the buffer holding the result
+local uint* scan_local(local uint* scratch_1, local uint* scratch_2) {
+	int lid = get_local_id(0);
+	int N = get_local_size(0);
+	local uint* scratch_3;
+	for (int i = 1; i < N; i *= 2) {
+		if (lid >= i)
+			scratch_2[lid] = scratch_1[lid] + scratch_1[lid - i];
+		else
+			scratch_2[lid] = scratch_1[lid];
+		barrier(CLK_LOCAL_MEM_FENCE);
+		scratch_3 = scratch_2;
+		scratch_2 = scratch_1;
+		scratch_1 = scratch_3;
+	}
+	return scratch_1;
+}
+
+//256 bins per channel into H (zeroed by the host), global size (work-groups * local size, channels)
+kernel void histogram_local(global const uchar* A, global uint* H, const int plane_size, local uint* local_hist) {
+	int lid = get_local_id(0), c = get_global_id(1);
+	for (int i = lid; i < 256; i += get_local_size(0))
+		local_hist[i] = 0;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	global const uchar* plane = A + c*plane_size;
+	for (int i = get_global_id(0); i < plane_size; i += get_global_size(0))
+		atomic_inc(&local_hist[plane[i]]);
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int i = lid; i < 256; i += get_local_size(0))
+		if (local_hist[i])
+			atomic_add(&H[i + c*256], local_hist[i]);
+}
+
+//equalisation table of every channel from its histogram: (cdf - cdf_min) * 255 / (pixels - cdf_min), rounded,
+//where cdf_min is the count of the darkest value present; one work-group of 256 per channel
+kernel void equalize_lut(global const uint* H, global uchar* luts, local uint* scratch_1, local uint* scratch_2) {
+	int lid = get_local_id(0), c = get_group_id(0);
+	local uint cdf_min;
+	if (lid == 0)
+		cdf_min = UINT_MAX;
+	scratch_1[lid] = H[lid + c*256];
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	local uint* cdf = scan_local(scratch_1, scratch_2);
+	if (H[lid + c*256])
+		atomic_min(&cdf_min, cdf[lid]);
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	ulong pixels = cdf[255], range = max(pixels - cdf_min, (ulong)1);
+	ulong value = cdf[lid] > cdf_min ? cdf[lid] - cdf_min : 0;
+	luts[lid + c*256] = (value * 255 + range / 2) / range;
+}
+
+//applies one table per channel, global size (plane_size, channels)
+kernel void equalize_apply(global const uchar* A, global uchar* B, constant uchar* luts) {
+	int id = get_global_id(0) + get_global_id(1)*get_global_size(0);
+	B[id] = luts[A[id] + get_global_id(1)*256];
+}
+
+//CLAHE: the image is cut into tiles_x x tiles_y tiles of ceil(width/tiles_x) x ceil(height/tiles_y) pixels
+//(smaller at the right and bottom edges), each with its own clipped equalisation table
+
+//histogram of every tile, one work-group per tile and channel: global size (tiles_x * local size, tiles_y, channels)
+kernel void clahe_histograms(global const uchar* A, global uint* H, const int width, const int height, local uint* local_hist) {
+	int lid = get_local_id(0);
+	int tile_x = get_group_id(0), tile_y = get_group_id(1), c = get_global_id(2);
+	int tiles_x = get_num_groups(0), tiles_y = get_num_groups(1);
+	int tile_width = (width + tiles_x - 1) / tiles_x, tile_height = (height + tiles_y - 1) / tiles_y;
+	int x0 = tile_x * tile_width, y0 = tile_y * tile_height;
+	int w = clamp(width - x0, 0, tile_width), h = clamp(height - y0, 0, tile_height);
+
+	for (int i = lid; i < 256; i += get_local_size(0))
+		local_hist[i] = 0;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	global const uchar* plane = A + c*width*height;
+	for (int i = lid; i < w*h; i += get_local_size(0))
+		atomic_inc(&local_hist[plane[(x0 + i % w) + (y0 + i / w)*width]]);
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	global uint* tile_hist = H + ((tile_x + tile_y*tiles_x) + c*tiles_x*tiles_y)*256;
+	for (int i = lid; i < 256; i += get_local_size(0))
+		tile_hist[i] = local_hist[i];
+}
+
+//clipped table of every tile: bins above clip_limit times the mean bin are cut and the excess is spread over all
+//bins, which limits the slope of the mapping and with it the amplification of noise; cdf * 255 / pixels, rounded
+//one work-group of 256 per tile and channel, the tables are in the same order as the histograms
+kernel void clahe_luts(global const uint* H, global uchar* luts, const float clip_limit, local uint* scratch_1, local uint* scratch_2) {
+	int lid = get_local_id(0), tile = get_group_id(0);
+	local uint pixels, excess;
+	if (lid == 0) {
+		pixels = 0;
+		excess = 0;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	uint count = H[lid + tile*256];
+	atomic_add(&pixels, count);
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	uint clip = max((uint)(clip_limit * pixels / 256), (uint)1);
+	if (count > clip)
+		atomic_add(&excess, count - clip);
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	scratch_1[lid] = min(count, clip) + excess / 256 + (lid < excess % 256 ? 1 : 0);
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	local uint* cdf = scan_local(scratch_1, scratch_2);
+	ulong total = max(pixels, (uint)1);
+	luts[lid + tile*256] = ((ulong)cdf[lid] * 255 + total / 2) / total;
+}
+
+//bilinear blend of the tables of the 4 tiles whose centres surround the pixel (nearest tiles at the borders)
+//global size (width, height, channels)
+kernel void clahe_apply(global const uchar* A, global uchar* B, global const uchar* luts, const int tiles_x, const int tiles_y) {
+	int width = get_global_size(0), height = get_global_size(1);
+	int x = get_global_id(0), y = get_global_id(1), c = get_global_id(2);
+	int tile_width = (width + tiles_x - 1) / tiles_x, tile_height = (height + tiles_y - 1) / tiles_y;
+	int id = x + y*width + c*width*height;
+	uchar value = A[id];
+
+	//position in tiles relative to the tile centres
+	float fx = (x + 0.5f) / tile_width - 0.5f, fy = (y + 0.5f) / tile_height - 0.5f;
+	int tx0 = clamp((int)floor(fx), 0, tiles_x - 1), ty0 = clamp((int)floor(fy), 0, tiles_y - 1);
+	int tx1 = min(tx0 + 1, tiles_x - 1), ty1 = min(ty0 + 1, tiles_y - 1);
+	float ax = clamp(fx - tx0, 0.0f, 1.0f), ay = clamp(fy - ty0, 0.0f, 1.0f);
+
+	global const uchar* plane_luts = luts + c*tiles_x*tiles_y*256;
+	float v00 = plane_luts[(tx0 + ty0*tiles_x)*256 + value], v10 = plane_luts[(tx1 + ty0*tiles_x)*256 + value];
+	float v01 = plane_luts[(tx0 + ty1*tiles_x)*256 + value], v11 = plane_luts[(tx1 + ty1*tiles_x)*256 + value];
+	float top = v00 + ax * (v10 - v00), bottom = v01 + ax * (v11 - v01);
+	B[id] = convert_uchar_sat_rte(top + ay * (bottom - top));
+}
@@ -0,0 +1,165 @@
+//fast Fourier transforms of complex (float2) rows or columns of power-of-two length, and FFT convolution
+//Stockham autosort: every pass reads the whole array and writes it reordered into a second one, so there is
+//no bit-reversal step; a pass of radix R (8, 4 or 2) does n/R butterflies of R points each, the radices are 8
+//while they divide what is left, then a single 4 or 2
+//direction is -1 for the forward and +1 for the inverse transform, which is not normalised
+
+//a batch of transforms: element i of transform b is at (b % batch.y)*batch.z + (b / batch.y)*batch.w + i*batch.x,
+//e.g. (1, rows, row length, 0) for rows and (row length, row length, 1, plane size) for the columns of planes
+
+float2 complex_mul(float2 a, float2 b) {
+	return (float2)(a.x*b.x - a.y*b.y, a.x*b.y + a.y*b.x);
+}
+
+//e^(i*angle)
+float2 twiddle(float angle) {
+	float c;
+	float s = sincos(angle, &c);
+	return (float2)(c, s);
+}
+
+//a times i*direction
+float2 rotate(float2 a, float direction) {
+	return (float2)(-a.y, a.x) * direction;
+}
+
+void fft2(float2* v) {
+	float2 a = v[0];
+	v[0] = a + v[1];
+	v[1] = a - v[1];
+}
+
+void fft4(float2* v, float direction) {
+	float2 b0 = v[0] + v[2], b1 = v[0] - v[2], b2 = v[1] + v[3], b3 = rotate(v[1] - v[3], direction);
+	v[0] = b0 + b2;
+	v[1] = b1 + b3;
+	v[2] = b0 - b2;
+	v[3] = b1 - b3;
+}
+
+//two radix-4 butterflies on the even and odd points, combined with the twiddles e^(i*direction*k*pi/4)
+void fft8(float2* v, float direction) {
+	float2 e[4] = { v[0], v[2], v[4], v[6] }, o[4] = { v[1], v[3], v[5], v[7] };
+	fft4(e, direction);
+	fft4(o, direction);
+	const float r = 0.70710678f;
+	o[1] = complex_mul(o[1], (float2)(r, direction*r));
+	o[2] = rotate(o[2], direction);
+	o[3] = complex_mul(o[3], (float2)(-r, direction*r));
+	for (int k = 0; k < 4; k++) {
+		v[k] = e[k] + o[k];
+		v[k + 4] = e[k] - o[k];
+	}
+}
+
+//butterfly j of a pass: ns is the product of the radices of the previous passes, X and Y are the transform
+//in global or local memory with its elements stride apart
+#define DEFINE_STOCKHAM(SPACE) \
+void stockham_##SPACE(SPACE const float2* X, SPACE float2* Y, int j, int n, int ns, int radix, int stride, float direction) { \
+	float2 v[8]; \
+	float angle = direction * 2.0f * M_PI_F * (j % ns) / (ns * radix); \
+	for (int r = 0; r < radix; r++) \
+		v[r] = complex_mul(X[(j + r*(n/radix))*stride], twiddle(r*angle)); \
+	if (radix == 8) \
+		fft8(v, direction); \
+	else if (radix == 4) \
+		fft4(v, direction); \
+	else \
+		fft2(v); \
+	int d = (j / ns)*ns*radix + j % ns; \
+	for (int r = 0; r < radix; r++) \
+		Y[(d + r*ns)*stride] = v[r]; \
+}
+
+DEFINE_STOCKHAM(global)
+DEFINE_STOCKHAM(local)
+
+//one pass of a multi-pass transform for sizes that do not fit in local memory, global size (n/radix, transforms);
+//transforms along columns (batch.x != 1) swap the dimensions, so neighbouring work-items read neighbouring columns
+kernel void fft_pass(global const float2* X, global float2* Y, const int n, const int ns, const int radix, const float direction, const int4 batch) {
+	int columns = batch.x != 1;
+	int j = get_global_id(columns), b = get_global_id(1 - columns);
+	int base = (b % batch.y)*batch.z + (b / batch.y)*batch.w;
+	stockham_global(X + base, Y + base, j, n, ns, radix, batch.x, direction);
+}
+
+//the whole transform in local memory, all passes between A and B (n values each) with a barrier in between;
+//one work-group per transform, global size (local size, transforms)
+kernel void fft_local(global const float2* X, global float2* Y, const int n, const float direction, const int max_radix, const int4 batch,
+			local float2* A, local float2* B) {
+	int lid = get_local_id(0), size = get_local_size(0), b = get_group_id(1);
+	int base = (b % batch.y)*batch.z + (b / batch.y)*batch.w;
+	for (int i = lid; i < n; i += size)
+		A[i] = X[base + i*batch.x];
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int ns = 1; ns < n;) {
+		int radix = max_radix;
+		while ((n / ns) % radix)
+			radix /= 2;
+		for (int j = lid; j < n / radix; j += size)
+			stockham_local(A, B, j, n, ns, radix, 1, direction);
+		barrier(CLK_LOCAL_MEM_FENCE);
+		local float2* swap = A;
+		A = B;
+		B = swap;
+		ns *= radix;
+	}
+
+	for (int i = lid; i < n; i += size)
+		Y[base + i*batch.x] = A[i];
+}
+
+//real rows of n values are transformed as n/2 complex values (even, odd) of the same memory; the halves are
+//separated afterwards: with E and O the transforms of the even and odd values, X[k] = E[k] + e^(-2*pi*i*k/n)*O[k]
+//for k = 0..n/2; global size (n/2 + 1, rows), rows of Z have n/2 values and rows of X n/2 + 1
+kernel void fft_r2c_post(global const float2* Z, global float2* X, const int n) {
+	int k = get_global_id(0), row = get_global_id(1), h = n / 2;
+	float2 a = Z[k % h + row*h], b = Z[(h - k) % h + row*h];
+	b.y = -b.y;
+	float2 e = 0.5f * (a + b), o = 0.5f * (a - b);
+	o = (float2)(o.y, -o.x); //divided by i
+	X[k + row*(h + 1)] = e + complex_mul(twiddle(-2.0f * M_PI_F * k / n), o);
+}
+
+//the inverse: Z[k] = E[k] + i*O[k] from the half spectrum, whose inverse transform gives the (even, odd) pairs
+//of the real rows times n/2; global size (n/2, rows)
+kernel void fft_c2r_pre(global const float2* X, global float2* Z, const int n) {
+	int k = get_global_id(0), row = get_global_id(1), h = n / 2;
+	float2 a = X[k + row*(h + 1)], b = X[h - k + row*(h + 1)];
+	b.y = -b.y;
+	float2 e = 0.5f * (a + b), o = complex_mul(0.5f * (a - b), twiddle(2.0f * M_PI_F * k / n));
+	Z[k + row*h] = e + rotate(o, 1.0f);
+}
+
+//FFT convolution with overlap-save: the image is cut into blocks, each block is transformed together with
+//offset pixels of its surroundings (zeros outside the image) as a tile of fw x fh values, multiplied by the
+//spectrum of the mask and transformed back; the values closer than offset to the tile edges are wrapped
+//around and dropped, the block in the centre is exact; one strip of tiles_x tiles of every channel at a time
+
+//the real tiles of the strip at row y0, tile t of channel c is stack c*tiles_x + t; global size (fw, fh, stacks)
+kernel void fft_load_tiles(global const uchar* A, global float* R, const int width, const int height, const int block_width, const int y0,
+			const int offset, const int tiles_x) {
+	int x = get_global_id(0), y = get_global_id(1), s = get_global_id(2);
+	int fw = get_global_size(0), fh = get_global_size(1);
+	int c = s / tiles_x, t = s % tiles_x;
+	int ix = t*block_width - offset + x, iy = y0 - offset + y;
+	R[x + y*fw + s*fw*fh] = (ix >= 0 && ix < width && iy >= 0 && iy < height) ? A[ix + iy*width + c*width*height] : 0.0f;
+}
+
+//pointwise product with the mask spectrum K shared by all stacks, and the scale of the inverse transforms;
+//global size (values per stack, stacks)
+kernel void fft_multiply(global float2* S, global const float2* K, const float scale) {
+	int i = get_global_id(0), id = i + get_global_id(1)*get_global_size(0);
+	S[id] = complex_mul(S[id], K[i]) * scale;
+}
+
+//the blocks back into the image, clamped and truncated like convolutionND; global size (block_width, block_height, stacks)
+kernel void fft_store_tiles(global const float* R, global uchar* B, const int width, const int height, const int fw, const int fh, const int y0,
+			const int offset, const int tiles_x) {
+	int x = get_global_id(0), y = get_global_id(1), s = get_global_id(2);
+	int c = s / tiles_x, t = s % tiles_x;
+	int ix = t*get_global_size(0) + x, iy = y0 + y;
+	if (ix < width && iy < height)
+		B[ix + iy*width + c*width*height] = (uchar)clamp(R[(x + offset) + (y + offset)*fw + s*fw*fh], 0.0f, 255.0f);
+}
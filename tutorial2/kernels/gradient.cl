@@ -0,0 +1,64 @@
+//fused image gradient: grayscale conversion, both 3x3 derivatives, magnitude and orientation in one pass
+//each work-group loads its block of gray values plus a 1 pixel apron into local memory once, and all
+//nine neighbours of every pixel are then read from there instead of from global memory twice per derivative
+//the global size is rounded up to a multiple of the work-group size, work-items outside the image only load
+
+#define PI_F 3.14159265f
+
+//gray value of a pixel of a planar image, rgb2gray's weights and rounding for 3 channels, 0 outside the image
+float gradient_gray(global const uchar* A, int x, int y, int width, int height, int channels) {
+	if (x < 0 || x >= width || y < 0 || y >= height)
+		return 0.0f;
+	int id = x + y*width;
+	if (channels == 1)
+		return A[id];
+	int image_size = width*height;
+	uchar r = A[id], g = A[id + image_size], b = A[id + 2*image_size];
+	uchar gray = (0.2126 * r) + (0.7152 * g) + (0.0722 * b);
+	return gray;
+}
+
+//magnitude and orientation outputs are single channel (width*height); pixels outside the image count as 0 like sobel_xy
+//scharr: weights 3, 10, 3 across the derivative instead of Sobel's 1, 2, 1
+//l1: |Gx| + |Gy| instead of sqrt(Gx^2 + Gy^2), the magnitude is multiplied by scale and clamped to 0..255
+//bins: if not 0 the direction of the gradient modulo 180 degrees is quantised into bins sectors centred on
+//0, 180/bins, ... degrees (0 is horizontal), e.g. 4 for the non-maximum suppression of an edge detector
+//tile: (get_local_size(0) + 2) * (get_local_size(1) + 2) floats
+kernel void gradient(global const uchar* A, global uchar* magnitude, global uchar* orientation, const int width, const int height,
+			const int channels, const int scharr, const int l1, const int bins, const float scale, local float* tile) {
+	int lx = get_local_id(0), ly = get_local_id(1);
+	int tile_width = get_local_size(0) + 2, tile_height = get_local_size(1) + 2;
+	int x0 = get_group_id(0) * get_local_size(0) - 1, y0 = get_group_id(1) * get_local_size(1) - 1;
+
+	//cooperative load of the block and its apron, converting to gray on the way
+	for (int ty = ly; ty < tile_height; ty += get_local_size(1))
+		for (int tx = lx; tx < tile_width; tx += get_local_size(0))
+			tile[tx + ty*tile_width] = gradient_gray(A, x0 + tx, y0 + ty, width, height, channels);
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	int x = get_global_id(0), y = get_global_id(1);
+	if (x >= width || y >= height)
+		return;
+
+	//same weights and sign convention as sobel_xy: Gx is right minus left, Gy is top minus bottom
+	float side = scharr ? 3.0f : 1.0f, centre = scharr ? 10.0f : 2.0f;
+	float gx = 0, gy = 0;
+	for (int j = -1; j <= 1; j++) {
+		for (int i = -1; i <= 1; i++) {
+			float value = tile[(lx + 1 + i) + (ly + 1 + j)*tile_width];
+			gx += value * (i * (j == 0 ? centre : side));
+			gy -= value * (j * (i == 0 ? centre : side));
+		}
+	}
+
+	int id = x + y*width;
+	float m = l1 ? fabs(gx) + fabs(gy) : hypot(gx, gy);
+	magnitude[id] = (uchar)clamp(m * scale, 0.0f, 255.0f);
+
+	if (bins) {
+		float angle = atan2(gy, gx); //-pi..pi
+		if (angle < 0)
+			angle += PI_F;
+		orientation[id] = (int)(angle * bins / PI_F + 0.5f) % bins;
+	}
+}
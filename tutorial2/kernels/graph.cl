@@ -0,0 +1,37 @@
+//kernels of the filter graph that have more than one input or output
+//like the other planar kernels the global size is (width, height, channels)
+
+//3x3 Sobel derivatives of every channel into two float images, pixels outside the image count as 0
+//Gx = [-1 0 1; -2 0 2; -1 0 1], Gy = [1 2 1; 0 0 0; -1 -2 -1] as sobel_Gx and sobel_Gy in tutorial2.cpp
+kernel void sobel_xy(global const uchar* A, global float* Gx, global float* Gy) {
+	int width = get_global_size(0); //image width in pixels
+	int height = get_global_size(1); //image height in pixels
+	int image_size = width*height; //image size in pixels
+
+	int x = get_global_id(0); //current x coord.
+	int y = get_global_id(1); //current y coord.
+	int c = get_global_id(2); //current colour channel
+
+	float gx = 0, gy = 0;
+	for (int j = -1; j <= 1; j++) {
+		for (int i = -1; i <= 1; i++) {
+			int xi = x + i;
+			int yi = y + j;
+			if (xi >= 0 && xi < width && yi >= 0 && yi < height) {
+				float value = A[xi + yi*width + c*image_size];
+				gx += value * (i * (2 - abs(j)));
+				gy -= value * (j * (2 - abs(i)));
+			}
+		}
+	}
+
+	int id = x + y*width + c*image_size;
+	Gx[id] = gx;
+	Gy[id] = gy;
+}
+
+//L2 gradient magnitude, clamped to 0..255
+kernel void gradient_magnitude(global const float* Gx, global const float* Gy, global uchar* B) {
+	int id = get_global_id(0) + get_global_id(1)*get_global_size(0) + get_global_id(2)*get_global_size(0)*get_global_size(1);
+	B[id] = (uchar)clamp(hypot(Gx[id], Gy[id]), 0.0f, 255.0f);
+}
@@ -0,0 +1,67 @@
+//the tutorial2 filters on image objects instead of raw buffers: pixels are read through the texture
+//cache with read_imagef, which returns the channels normalised to 0..1 as a float4, and the sampler
+//clamps coordinates outside the image to the nearest edge pixel, so there are no border branches
+//images are RGBA8 (or R8 for single channel images) and every work-item handles a whole pixel
+
+constant sampler_t clamp_sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+//bilinear interpolation in the texture unit, coordinates are normalised to 0..1
+constant sampler_t linear_sampler = CLK_NORMALIZED_COORDS_TRUE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+kernel void image_identity(read_only image2d_t A, write_only image2d_t B) {
+	int2 pos = (int2)(get_global_id(0), get_global_id(1));
+	write_imagef(B, pos, read_imagef(A, clamp_sampler, pos));
+}
+
+kernel void image_filter_r(read_only image2d_t A, write_only image2d_t B) {
+	int2 pos = (int2)(get_global_id(0), get_global_id(1));
+	float4 pixel = read_imagef(A, clamp_sampler, pos);
+	write_imagef(B, pos, (float4)(pixel.x, 0.0f, 0.0f, pixel.w));
+}
+
+kernel void image_invert(read_only image2d_t A, write_only image2d_t B) {
+	int2 pos = (int2)(get_global_id(0), get_global_id(1));
+	float4 pixel = read_imagef(A, clamp_sampler, pos);
+	write_imagef(B, pos, (float4)(1.0f - pixel.xyz, pixel.w));
+}
+
+kernel void image_rgb2gray(read_only image2d_t A, write_only image2d_t B) {
+	int2 pos = (int2)(get_global_id(0), get_global_id(1));
+	float4 pixel = read_imagef(A, clamp_sampler, pos);
+	float gray = dot(pixel.xyz, (float3)(0.2126f, 0.7152f, 0.0722f));
+	write_imagef(B, pos, (float4)(gray, gray, gray, pixel.w));
+}
+
+kernel void image_gamma(read_only image2d_t A, write_only image2d_t B, const float gamma) {
+	int2 pos = (int2)(get_global_id(0), get_global_id(1));
+	float4 pixel = read_imagef(A, clamp_sampler, pos);
+	write_imagef(B, pos, (float4)(pow(pixel.xyz, (float3)(gamma)), pixel.w));
+}
+
+//average over a (2*range+1)^2 window, edge pixels are repeated outside the image
+kernel void image_avg_filter(read_only image2d_t A, write_only image2d_t B, const int range) {
+	int2 pos = (int2)(get_global_id(0), get_global_id(1));
+	float4 result = 0.0f;
+	for (int j = -range; j <= range; j++)
+		for (int i = -range; i <= range; i++)
+			result += read_imagef(A, clamp_sampler, pos + (int2)(i, j));
+	write_imagef(B, pos, result / ((2 * range + 1) * (2 * range + 1)));
+}
+
+//convolution with the same mask layout as convolutionND (mask[x + y*mask_size])
+kernel void image_convolution(read_only image2d_t A, write_only image2d_t B, constant float* mask, const int mask_size) {
+	int2 pos = (int2)(get_global_id(0), get_global_id(1));
+	int offset = mask_size / 2;
+	float4 result = 0.0f;
+	for (int j = 0; j < mask_size; j++)
+		for (int i = 0; i < mask_size; i++)
+			result += read_imagef(A, clamp_sampler, pos + (int2)(i - offset, j - offset)) * mask[i + j * mask_size];
+	write_imagef(B, pos, (float4)(clamp(result.xyz, 0.0f, 1.0f), read_imagef(A, clamp_sampler, pos).w));
+}
+
+//resize to the size of B with hardware bilinear interpolation
+kernel void image_resize(read_only image2d_t A, write_only image2d_t B) {
+	int2 pos = (int2)(get_global_id(0), get_global_id(1));
+	float2 coord = ((float2)(pos.x, pos.y) + 0.5f) / (float2)(get_image_width(B), get_image_height(B));
+	write_imagef(B, pos, read_imagef(A, linear_sampler, coord));
+}
@@ -0,0 +1,92 @@
+//summed-area tables (integral images) of planar uchar images
+//S has (width + 1) x (height + 1) entries per channel with a zero first row and column, so that
+//S[x + y*(width + 1)] is the sum of all pixels left of x and above y and any rectangle sum takes 4 reads
+//the row scans reuse the three steps of tutorial3's scan: scan_add within a work-group, a scan of the
+//block sums and an adjustment by the block offsets (done while walking down the columns here)
+//32-bit accumulators wrap around for large images, but the differences of 4 entries are still right as
+//long as the rectangle sum itself fits, so uint is enough for box filters and ulong is for large rectangles
+
+#define DEFINE_INTEGRAL(T) \
+/* double-buffered Hillis-Steele scan (scan_add) of blocks of get_local_size(0) pixels of every row, \
+   the global size is (width rounded up to the local size, height, channels) */ \
+kernel void integral_rows_##T(global const uchar* A, global T* S, global T* block_sums, const int width, const int height, \
+			local T* scratch_1, local T* scratch_2) { \
+	int x = get_global_id(0), y = get_global_id(1), c = get_global_id(2); \
+	int lid = get_local_id(0); \
+	int N = get_local_size(0); \
+	local T* scratch_3; \
+\
+	scratch_1[lid] = x < width ? A[x + y*width + c*width*height] : 0; \
+	barrier(CLK_LOCAL_MEM_FENCE); \
+\
+	for (int i = 1; i < N; i *= 2) { \
+		if (lid >= i) \
+			scratch_2[lid] = scratch_1[lid] + scratch_1[lid - i]; \
+		else \
+			scratch_2[lid] = scratch_1[lid]; \
+		barrier(CLK_LOCAL_MEM_FENCE); \
+		scratch_3 = scratch_2; \
+		scratch_2 = scratch_1; \
+		scratch_1 = scratch_3; \
+	} \
+\
+	if (x < width) \
+		S[(x + 1) + (y + 1)*(width + 1) + c*(width + 1)*(height + 1)] = scratch_1[lid]; \
+	if (lid == N - 1) \
+		block_sums[get_group_id(0) + (y + c*height)*get_num_groups(0)] = scratch_1[lid]; \
+} \
+\
+/* exclusive scan of the block sums of every row, one work-item per row and channel; \
+   a row has only width/local size blocks so a serial loop is enough (cf. scan_add_atomic) */ \
+kernel void integral_block_scan_##T(global T* block_sums, const int blocks) { \
+	global T* sums = block_sums + get_global_id(0)*blocks; \
+	T total = 0; \
+	for (int b = 0; b < blocks; b++) { \
+		T sum = sums[b]; \
+		sums[b] = total; \
+		total += sum; \
+	} \
+} \
+\
+/* adds the block offsets to the row scans and sums them down the columns, one work-item per column \
+   of S so that neighbouring work-items access neighbouring entries; global size (width + 1, channels) */ \
+kernel void integral_columns_##T(global T* S, global const T* block_sums, const int width, const int height, const int block_size) { \
+	int x = get_global_id(0), c = get_global_id(1); \
+	int blocks = (width + block_size - 1) / block_size; \
+	global T* column = S + x + c*(width + 1)*(height + 1); \
+	T sum = 0; \
+	column[0] = 0; \
+	for (int y = 1; y <= height; y++) { \
+		if (x > 0) \
+			sum += column[y*(width + 1)] + block_sums[(x - 1) / block_size + (y - 1 + c*height)*blocks]; \
+		column[y*(width + 1)] = sum; \
+	} \
+} \
+\
+/* mean over a (2*range+1)^2 window in constant time per pixel, pixels outside the image count as 0 \
+   like in avg_filterND so the result is identical; global size (width, height, channels) */ \
+kernel void box_filter_integral_##T(global const T* S, global uchar* B, const int range) { \
+	int width = get_global_size(0), height = get_global_size(1); \
+	int x = get_global_id(0), y = get_global_id(1), c = get_global_id(2); \
+	global const T* plane = S + c*(width + 1)*(height + 1); \
+\
+	int x0 = max(x - range, 0), x1 = min(x + range, width - 1) + 1; \
+	int y0 = max(y - range, 0), y1 = min(y + range, height - 1) + 1; \
+	T sum = plane[x1 + y1*(width + 1)] - plane[x0 + y1*(width + 1)] - plane[x1 + y0*(width + 1)] + plane[x0 + y0*(width + 1)]; \
+\
+	int window = 2 * range + 1; \
+	B[x + y*width + c*width*height] = (uchar)(sum / (window * window)); \
+} \
+\
+/* sums of rectangles (x, y, width, height) inside the image, e.g. for Haar-like features; \
+   global size (rectangles, channels), the sum of rectangle r in channel c goes to sums[r + c*rectangles] */ \
+kernel void integral_rect_sums_##T(global const T* S, global const int4* rects, global T* sums, const int width, const int height) { \
+	int r = get_global_id(0), c = get_global_id(1); \
+	global const T* plane = S + c*(width + 1)*(height + 1); \
+	int4 rect = rects[r]; \
+	int x0 = rect.x, y0 = rect.y, x1 = rect.x + rect.z, y1 = rect.y + rect.w; \
+	sums[r + c*get_global_size(0)] = plane[x1 + y1*(width + 1)] - plane[x0 + y1*(width + 1)] - plane[x1 + y0*(width + 1)] + plane[x0 + y0*(width + 1)]; \
+}
+
+DEFINE_INTEGRAL(uint)
+DEFINE_INTEGRAL(ulong)
@@ -0,0 +1,90 @@
+//the tutorial2 filters on interleaved pixels ((x + y*width)*N + c) as stored in PPM files: every
+//work-item loads and stores a whole pixel with one vector access instead of N accesses image_size apart
+//N = 3 is packed RGB, N = 4 is RGBA with the alpha channel passed through
+//the global size is (width, height) and pixels outside the image count as 0, like in the planar kernels,
+//so the results match them
+
+#define DEFINE_INTERLEAVED(N) \
+kernel void identity_uchar##N(global const uchar* A, global uchar* B) { \
+	int id = get_global_id(0) + get_global_id(1) * get_global_size(0); \
+	vstore##N(vload##N(id, A), id, B); \
+} \
+\
+kernel void filter_r_uchar##N(global const uchar* A, global uchar* B) { \
+	int id = get_global_id(0) + get_global_id(1) * get_global_size(0); \
+	uchar##N pixel = vload##N(id, A); \
+	pixel.y = 0; \
+	pixel.z = 0; \
+	vstore##N(pixel, id, B); \
+} \
+\
+kernel void invert_uchar##N(global const uchar* A, global uchar* B) { \
+	int id = get_global_id(0) + get_global_id(1) * get_global_size(0); \
+	uchar##N pixel = vload##N(id, A); \
+	pixel.xyz = (uchar3)(255) - pixel.xyz; \
+	vstore##N(pixel, id, B); \
+} \
+\
+kernel void rgb2gray_uchar##N(global const uchar* A, global uchar* B) { \
+	int id = get_global_id(0) + get_global_id(1) * get_global_size(0); \
+	uchar##N pixel = vload##N(id, A); \
+	uchar gray = (0.2126 * pixel.x) + (0.7152 * pixel.y) + (0.0722 * pixel.z); \
+	pixel.xyz = (uchar3)(gray); \
+	vstore##N(pixel, id, B); \
+} \
+\
+kernel void gamma_transform_uchar##N(global const uchar* A, global uchar* B, const float gamma) { \
+	int id = get_global_id(0) + get_global_id(1) * get_global_size(0); \
+	uchar##N pixel = vload##N(id, A); \
+	float3 norm_pixel = pow(convert_float3(pixel.xyz) / 255.0f, (float3)(gamma)); \
+	pixel.xyz = convert_uchar3(norm_pixel * 255.0f); \
+	vstore##N(pixel, id, B); \
+} \
+\
+kernel void avg_filter_uchar##N(global const uchar* A, global uchar* B, const int range) { \
+	int width = get_global_size(0); \
+	int height = get_global_size(1); \
+	int x = get_global_id(0); \
+	int y = get_global_id(1); \
+	uint3 result = 0; \
+	for (int i = max(0, x - range); i <= min(width - 1, x + range); i++) \
+		for (int j = max(0, y - range); j <= min(height - 1, y + range); j++) \
+			result += convert_uint3(vload##N(i + j * width, A).xyz); \
+	uchar##N pixel = vload##N(x + y * width, A); \
+	pixel.xyz = convert_uchar3(result / (uint)((2 * range + 1) * (2 * range + 1))); \
+	vstore##N(pixel, x + y * width, B); \
+} \
+\
+kernel void convolution_uchar##N(global const uchar* A, global uchar* B, constant float* mask, const int mask_size) { \
+	int width = get_global_size(0); \
+	int height = get_global_size(1); \
+	int x = get_global_id(0); \
+	int y = get_global_id(1); \
+	int offset = mask_size / 2; \
+	float3 result = 0; \
+	for (int i = -offset; i <= offset; i++) \
+		for (int j = -offset; j <= offset; j++) { \
+			int xi = x + i; \
+			int yi = y + j; \
+			if (xi >= 0 && xi < width && yi >= 0 && yi < height) \
+				result += convert_float3(vload##N(xi + yi * width, A).xyz) * mask[(i + offset) + (j + offset) * mask_size]; \
+		} \
+	uchar##N pixel = vload##N(x + y * width, A); \
+	pixel.xyz = convert_uchar3(clamp(result, 0.0f, 255.0f)); \
+	vstore##N(pixel, x + y * width, B); \
+}
+
+DEFINE_INTERLEAVED(3)
+DEFINE_INTERLEAVED(4)
+
+//packed RGB -> RGBA with a constant alpha, one work-item per pixel
+kernel void rgb_to_rgba(global const uchar* A, global uchar* B, const uchar alpha) {
+	int id = get_global_id(0);
+	vstore4((uchar4)(vload3(id, A), alpha), id, B);
+}
+
+//RGBA -> packed RGB, the alpha channel is dropped
+kernel void rgba_to_rgb(global const uchar* A, global uchar* B) {
+	int id = get_global_id(0);
+	vstore3(vload4(id, A).xyz, id, B);
+}
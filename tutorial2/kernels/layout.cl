@@ -0,0 +1,83 @@
+//layout conversion kernels: tiled 2D transpose, planar <-> interleaved pixels and N-D axis permutation
+//the transpose and permutation are defined for uchar (images) and float (intermediate/numeric data)
+
+//tiled 2D transpose of planes of width x height elements, the third global dimension selects the plane
+//the global size is padded to a multiple of the square local size; tile holds T x (T+1) elements where
+//the extra column shifts every row to another local memory bank, so the column-wise reads do not conflict
+#define DEFINE_TRANSPOSE(TYPE) \
+kernel void transpose_##TYPE(global const TYPE* A, global TYPE* B, const int width, const int height, local TYPE* tile) { \
+	int T = get_local_size(0); \
+	int tx = get_local_id(0); \
+	int ty = get_local_id(1); \
+	int plane = get_global_id(2) * width * height; \
+	int x = get_group_id(0) * T + tx; \
+	int y = get_group_id(1) * T + ty; \
+	if (x < width && y < height) \
+		tile[ty * (T + 1) + tx] = A[plane + y * width + x]; \
+	barrier(CLK_LOCAL_MEM_FENCE); \
+	x = get_group_id(1) * T + tx; /* the output is height x width, so the group indices swap */ \
+	y = get_group_id(0) * T + ty; \
+	if (x < height && y < width) \
+		B[plane + y * height + x] = tile[tx * (T + 1) + ty]; \
+}
+
+DEFINE_TRANSPOSE(uchar)
+DEFINE_TRANSPOSE(float)
+
+//CImg's planar layout (c*image_size + x + y*width) to interleaved pixels ((x + y*width)*channels_out + c)
+//one work-item per pixel, missing output channels (e.g. alpha when going from 3 to 4) are set to fill
+kernel void planar_to_interleaved(global const uchar* A, global uchar* B, const int channels_in, const int channels_out, const uchar fill) {
+	int id = get_global_id(0);
+	int image_size = get_global_size(0);
+
+	if (channels_out == 4) { //one 32-bit store per pixel
+		uchar4 pixel = (uchar4)(fill);
+		pixel.x = A[id];
+		if (channels_in > 1) pixel.y = A[id + image_size];
+		if (channels_in > 2) pixel.z = A[id + 2 * image_size];
+		if (channels_in > 3) pixel.w = A[id + 3 * image_size];
+		vstore4(pixel, id, B);
+		return;
+	}
+
+	for (int c = 0; c < channels_out; c++)
+		B[id * channels_out + c] = (c < channels_in) ? A[id + c * image_size] : fill;
+}
+
+//interleaved pixels back to the planar layout, extra input channels (e.g. alpha from 4 to 3) are dropped
+kernel void interleaved_to_planar(global const uchar* A, global uchar* B, const int channels_in, const int channels_out, const uchar fill) {
+	int id = get_global_id(0);
+	int image_size = get_global_size(0);
+
+	if (channels_in == 4) { //one 32-bit load per pixel
+		uchar4 pixel = vload4(id, A);
+		B[id] = pixel.x;
+		if (channels_out > 1) B[id + image_size] = pixel.y;
+		if (channels_out > 2) B[id + 2 * image_size] = pixel.z;
+		if (channels_out > 3) B[id + 3 * image_size] = pixel.w;
+		return;
+	}
+
+	for (int c = 0; c < channels_out; c++)
+		B[id + c * image_size] = (c < channels_in) ? A[id * channels_in + c] : fill;
+}
+
+//general axis permutation of a row-major N-D array, one work-item per output element
+//out_dims[d] is the size of output axis d and in_strides[d] the input stride of the axis it comes from
+#define DEFINE_PERMUTE(TYPE) \
+kernel void permute_##TYPE(global const TYPE* A, global TYPE* B, const int8 dims, const int8 strides, const int ndims) { \
+	int out_dims[8], in_strides[8]; \
+	vstore8(dims, 0, out_dims); \
+	vstore8(strides, 0, in_strides); \
+	int id = get_global_id(0); \
+	int rest = id; \
+	int offset = 0; \
+	for (int d = ndims - 1; d >= 0; d--) { \
+		offset += (rest % out_dims[d]) * in_strides[d]; \
+		rest /= out_dims[d]; \
+	} \
+	B[id] = A[offset]; \
+}
+
+DEFINE_PERMUTE(uchar)
+DEFINE_PERMUTE(float)
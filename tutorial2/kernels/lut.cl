@@ -0,0 +1,75 @@
+//lookup tables for tone curves: an 8-bit sample has only 256 possible values (65536 for 16-bit), so a
+//curve is evaluated once per value into a table and applied with a single gather per sample
+
+#define LUT_GAMMA 0
+#define LUT_CONTRAST 1
+#define LUT_BRIGHTNESS 2
+#define LUT_LEVELS 3
+#define LUT_CURVE 4
+
+//piecewise linear curve through points sorted by x, constant outside the first and last point
+float lut_curve(float v, global const float2* points, const int count) {
+	if (v <= points[0].x)
+		return points[0].y;
+	for (int k = 1; k < count; k++)
+		if (v <= points[k].x)
+			return mix(points[k - 1].y, points[k].y, (v - points[k - 1].x) / (points[k].x - points[k - 1].x));
+	return points[count - 1].y;
+}
+
+//entry i of a tone curve on the normalised value i/MAX; the parameters a..e depend on the operation:
+//  gamma: v^a (truncated like gamma_transform, so the table reproduces it exactly)
+//  contrast: (v - 0.5)*a + 0.5, brightness: v + a
+//  levels: input black a and white b, gamma c, output black d and white e
+//  curve: the points given in the buffer
+//the other operations round to the nearest value and all results are clamped to the sample range
+#define DEFINE_LUT(TYPE, MAX) \
+kernel void lut_build_##TYPE(global TYPE* lut, const int op, const float a, const float b, const float c, const float d, const float e, \
+			global const float2* points, const int count) { \
+	int i = get_global_id(0); \
+	float v = ((float)i) / MAX; \
+	if (op == LUT_GAMMA) { \
+		lut[i] = pow(v, a) * MAX; \
+		return; \
+	} \
+	if (op == LUT_CONTRAST) \
+		v = (v - 0.5f) * a + 0.5f; \
+	else if (op == LUT_BRIGHTNESS) \
+		v = v + a; \
+	else if (op == LUT_LEVELS) \
+		v = d + pow(clamp((v - a) / (b - a), 0.0f, 1.0f), 1.0f / c) * (e - d); \
+	else if (op == LUT_CURVE) \
+		v = lut_curve(v, points, count); \
+	lut[i] = (TYPE)(clamp(v, 0.0f, 1.0f) * (float)MAX + 0.5f); \
+} \
+\
+/* composition: applying out is the same as applying first and then second */ \
+kernel void lut_compose_##TYPE(global const TYPE* first, global const TYPE* second, global TYPE* out) { \
+	int i = get_global_id(0); \
+	out[i] = second[first[i]]; \
+}
+
+DEFINE_LUT(uchar, 255.0)
+DEFINE_LUT(ushort, 65535.0)
+
+//256-entry table in constant memory, one sample per work-item (any layout, all channels)
+kernel void lut_apply_constant(global const uchar* A, global uchar* B, constant uchar* lut) {
+	int id = get_global_id(0);
+	B[id] = lut[A[id]];
+}
+
+//256-entry table copied to local memory by the work-group first, for devices where divergent
+//constant reads are serialised
+kernel void lut_apply_local(global const uchar* A, global uchar* B, global const uchar* lut, local uchar* table) {
+	int id = get_global_id(0);
+	for (int i = get_local_id(0); i < 256; i += get_local_size(0))
+		table[i] = lut[i];
+	barrier(CLK_LOCAL_MEM_FENCE);
+	B[id] = table[A[id]];
+}
+
+//65536-entry table for 16-bit samples, too large for constant or local memory so it is read through the cache
+kernel void lut_apply_ushort(global const ushort* A, global ushort* B, global const ushort* lut) {
+	int id = get_global_id(0);
+	B[id] = lut[A[id]];
+}
@@ -0,0 +1,170 @@
+//non-linear filters of planar uchar images: median and rank filters, erosion and dilation
+//the median and rank filters replicate the edge pixels, erosion and dilation ignore pixels outside the image
+
+#define PIX_SORT(a, b) { uchar t = min(a, b); b = max(a, b); a = t; }
+
+//median of 9 values with the 19 compare-exchanges of the optimal network (Paeth/Devillard)
+uchar median9(uchar* p) {
+	PIX_SORT(p[1], p[2]); PIX_SORT(p[4], p[5]); PIX_SORT(p[7], p[8]);
+	PIX_SORT(p[0], p[1]); PIX_SORT(p[3], p[4]); PIX_SORT(p[6], p[7]);
+	PIX_SORT(p[1], p[2]); PIX_SORT(p[4], p[5]); PIX_SORT(p[7], p[8]);
+	PIX_SORT(p[0], p[3]); PIX_SORT(p[5], p[8]); PIX_SORT(p[4], p[7]);
+	PIX_SORT(p[3], p[6]); PIX_SORT(p[1], p[4]); PIX_SORT(p[2], p[5]);
+	PIX_SORT(p[4], p[7]); PIX_SORT(p[4], p[2]); PIX_SORT(p[6], p[4]);
+	PIX_SORT(p[4], p[2]);
+	return p[4];
+}
+
+//moves the minimum of p[lo..hi-1] to p[lo] and the maximum to p[hi-1]
+void min_max(uchar* p, int lo, int hi) {
+	for (int i = lo + 1; i < hi; i++)
+		PIX_SORT(p[lo], p[i]);
+	for (int i = lo + 1; i < hi - 1; i++)
+		PIX_SORT(p[i], p[hi - 1]);
+}
+
+//median of 25 values by forgetful selection: of the first 14 values the smallest and the largest cannot be
+//the median, both are dropped and the next value takes the place of the largest, until 3 values are left;
+//the sequence of compare-exchanges is fixed, so like a sorting network it does not branch on the data
+uchar median25(uchar* p) {
+	int lo = 0, hi = 14;
+	for (int next = 14; next < 25; next++) {
+		min_max(p, lo, hi);
+		lo++;
+		p[hi - 1] = p[next];
+	}
+	min_max(p, lo, hi);
+	return p[lo + 1];
+}
+
+//3x3 median, global size (width, height, channels)
+kernel void median3x3(global const uchar* A, global uchar* B) {
+	int width = get_global_size(0), height = get_global_size(1);
+	int x = get_global_id(0), y = get_global_id(1), c = get_global_id(2);
+	global const uchar* plane = A + c*width*height;
+
+	uchar p[9];
+	for (int j = -1; j <= 1; j++)
+		for (int i = -1; i <= 1; i++)
+			p[(i + 1) + (j + 1)*3] = plane[clamp(x + i, 0, width - 1) + clamp(y + j, 0, height - 1)*width];
+	B[x + y*width + c*width*height] = median9(p);
+}
+
+//5x5 median, global size (width, height, channels)
+kernel void median5x5(global const uchar* A, global uchar* B) {
+	int width = get_global_size(0), height = get_global_size(1);
+	int x = get_global_id(0), y = get_global_id(1), c = get_global_id(2);
+	global const uchar* plane = A + c*width*height;
+
+	uchar p[25];
+	for (int j = -2; j <= 2; j++)
+		for (int i = -2; i <= 2; i++)
+			p[(i + 2) + (j + 2)*5] = plane[clamp(x + i, 0, width - 1) + clamp(y + j, 0, height - 1)*width];
+	B[x + y*width + c*width*height] = median25(p);
+}
+
+//value of the given rank (0 is the minimum, (2*range+1)^2 - 1 the maximum) in a (2*range+1)^2 window, with a
+//sliding histogram (Huang): each work-item runs along a segment of a row, replacing the column that leaves
+//the window by the one that enters it, and moves the current value up or down the histogram from the last
+//one, so the cost per pixel grows with the radius and not with its square
+//histograms: 256 ushort per work-item (range up to 127), global size (segments rounded up to the work-group size, height, channels)
+kernel void rank_histogram(global const uchar* A, global uchar* B, const int range, const int rank, const int width, const int height,
+			const int segment, local ushort* histograms) {
+	int y = get_global_id(1), c = get_global_id(2);
+	int x_begin = get_global_id(0) * segment;
+	if (x_begin >= width)
+		return;
+	int x_end = min(x_begin + segment, width);
+	global const uchar* plane = A + c*width*height;
+	local ushort* hist = histograms + get_local_id(0)*256;
+
+	//the window of x_begin - 1
+	for (int i = 0; i < 256; i++)
+		hist[i] = 0;
+	for (int j = -range; j <= range; j++) {
+		int yj = clamp(y + j, 0, height - 1);
+		for (int i = -range; i <= range; i++)
+			hist[plane[clamp(x_begin - 1 + i, 0, width - 1) + yj*width]]++;
+	}
+
+	int value = 0, below = 0; //the current value and the number of pixels smaller than it
+	for (int x = x_begin; x < x_end; x++) {
+		int x_out = clamp(x - range - 1, 0, width - 1), x_in = clamp(x + range, 0, width - 1);
+		for (int j = -range; j <= range; j++) {
+			int yj = clamp(y + j, 0, height - 1);
+			uchar v = plane[x_out + yj*width];
+			hist[v]--;
+			if (v < value)
+				below--;
+			v = plane[x_in + yj*width];
+			hist[v]++;
+			if (v < value)
+				below++;
+		}
+		while (below > rank) {
+			value--;
+			below -= hist[value];
+		}
+		while (below + hist[value] <= rank) {
+			below += hist[value];
+			value++;
+		}
+		B[x + y*width + c*width*height] = value;
+	}
+}
+
+//1D erosion (minimum) or dilation (maximum) over 2*range+1 pixels with van Herk/Gil-Werman: the line is cut into
+//blocks of 2*range+1 pixels, and the window of a pixel is a suffix of one block plus a prefix of the next, so
+//with running suffix and prefix extremes the cost per pixel is 3 comparisons for any range
+//each work-item handles one block: the suffixes are stored into B walking backwards, then combined with the
+//prefixes walking forwards; the line starts at A[first] with step elements between pixels
+void morph_line(global const uchar* A, global uchar* B, int first, int step, int length, int block, int range, int erode) {
+	int k = 2 * range + 1;
+	uchar pad = erode ? 255 : 0;
+	int begin = block * k, end = min(begin + k, length);
+
+	uchar extreme = pad;
+	for (int i = begin + k - 1; i >= begin; i--) {
+		int j = i - range;
+		uchar v = (j >= 0 && j < length) ? A[first + j*step] : pad;
+		extreme = erode ? min(extreme, v) : max(extreme, v);
+		if (i < length)
+			B[first + i*step] = extreme;
+	}
+
+	extreme = pad;
+	for (int i = begin; i < end; i++) {
+		int j = i + range;
+		if (i > begin) {
+			uchar v = (j < length) ? A[first + j*step] : pad;
+			extreme = erode ? min(extreme, v) : max(extreme, v);
+		}
+		uchar suffix = B[first + i*step];
+		B[first + i*step] = erode ? min(suffix, extreme) : max(suffix, extreme);
+	}
+}
+
+//along the rows, global size (ceil(width/(2*range+1)), height, channels)
+kernel void morph_rows(global const uchar* A, global uchar* B, const int range, const int width, const int height, const int erode) {
+	int y = get_global_id(1), c = get_global_id(2);
+	morph_line(A, B, y*width + c*width*height, 1, width, get_global_id(0), range, erode);
+}
+
+//down the columns, global size (width, ceil(height/(2*range+1)), channels) so that neighbouring work-items read neighbouring pixels
+kernel void morph_columns(global const uchar* A, global uchar* B, const int range, const int width, const int height, const int erode) {
+	int x = get_global_id(0), c = get_global_id(2);
+	morph_line(A, B, x + c*width*height, width, height, get_global_id(1), range, erode);
+}
+
+//direct erosion/dilation over the whole (2*range_x+1)x(2*range_y+1) window, the reference for the benchmark
+kernel void morph_direct(global const uchar* A, global uchar* B, const int range_x, const int range_y, const int erode) {
+	int width = get_global_size(0), height = get_global_size(1);
+	int x = get_global_id(0), y = get_global_id(1), c = get_global_id(2);
+	global const uchar* plane = A + c*width*height;
+
+	uchar extreme = erode ? 255 : 0;
+	for (int j = max(y - range_y, 0); j <= min(y + range_y, height - 1); j++)
+		for (int i = max(x - range_x, 0); i <= min(x + range_x, width - 1); i++)
+			extreme = erode ? min(extreme, plane[i + j*width]) : max(extreme, plane[i + j*width]);
+	B[x + y*width + c*width*height] = extreme;
+}
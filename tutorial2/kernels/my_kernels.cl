@@ -120,7 +120,7 @@ kernel void avg_filterND(global const uchar* A, global uchar* B, const int range
 	int id = x + y*width + c*image_size; //global id in 1D space
 
 	uint result = 0;
-	int w_range = 4;
+	int w_range = range;
 
 	for (int i = max(0, x-w_range); i <= min(width - 1, x + w_range); i++)
 	{
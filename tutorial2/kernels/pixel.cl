@@ -0,0 +1,90 @@
+//the planar filters of my_kernels.cl for every pixel type: uchar (0..255), ushort (0..65535), float and half
+//(0..1, values above 1 are kept for HDR images); arithmetic is in float, rounding to the nearest and
+//saturation happen only when a result is stored into an integer type
+//half images are stored as 16-bit floats and read and written with vload_half/vstore_half, which do not
+//need the cl_khr_fp16 extension; the kernels index the buffers instead of offsetting pointers, which is not
+//allowed for half pointers
+
+#define LOAD_uchar(p, i) ((float)(p)[i])
+#define STORE_uchar(v, p, i) ((p)[i] = convert_uchar_sat_rte(v))
+#define LOAD_ushort(p, i) ((float)(p)[i])
+#define STORE_ushort(v, p, i) ((p)[i] = convert_ushort_sat_rte(v))
+#define LOAD_float(p, i) ((p)[i])
+#define STORE_float(v, p, i) ((p)[i] = (v))
+#define LOAD_half(p, i) vload_half(i, p)
+#define STORE_half(v, p, i) vstore_half_rte(v, i, p)
+
+//MAX is the value of white, global size (width, height, channels) unless noted
+#define DEFINE_PIXEL(TYPE, MAX) \
+kernel void identity_##TYPE(global const TYPE* A, global TYPE* B) { \
+	int id = get_global_id(0) + get_global_id(1)*get_global_size(0) + get_global_id(2)*get_global_size(0)*get_global_size(1); \
+	STORE_##TYPE(LOAD_##TYPE(A, id), B, id); \
+} \
+ \
+kernel void filter_r_##TYPE(global const TYPE* A, global TYPE* B) { \
+	int id = get_global_id(0) + get_global_id(1)*get_global_size(0) + get_global_id(2)*get_global_size(0)*get_global_size(1); \
+	STORE_##TYPE(get_global_id(2) == 0 ? LOAD_##TYPE(A, id) : 0.0f, B, id); \
+} \
+ \
+kernel void invert_##TYPE(global const TYPE* A, global TYPE* B) { \
+	int id = get_global_id(0) + get_global_id(1)*get_global_size(0) + get_global_id(2)*get_global_size(0)*get_global_size(1); \
+	STORE_##TYPE(MAX - LOAD_##TYPE(A, id), B, id); \
+} \
+ \
+/* luma of an RGB image into all three channels, global size (width, height) */ \
+kernel void gray_##TYPE(global const TYPE* A, global TYPE* B) { \
+	int image_size = get_global_size(0)*get_global_size(1); \
+	int id = get_global_id(0) + get_global_id(1)*get_global_size(0); \
+	float gray = 0.2126f*LOAD_##TYPE(A, id) + 0.7152f*LOAD_##TYPE(A, id + image_size) + 0.0722f*LOAD_##TYPE(A, id + 2*image_size); \
+	for (int c = 0; c < 3; c++) \
+		STORE_##TYPE(gray, B, id + c*image_size); \
+} \
+ \
+kernel void gamma_##TYPE(global const TYPE* A, global TYPE* B, const float gamma) { \
+	int id = get_global_id(0) + get_global_id(1)*get_global_size(0) + get_global_id(2)*get_global_size(0)*get_global_size(1); \
+	STORE_##TYPE(pow(max(LOAD_##TYPE(A, id) / MAX, 0.0f), gamma) * MAX, B, id); \
+} \
+ \
+/* mean of the (2*range+1)^2 neighbourhood, pixels outside the image count as 0 like in avg_filterND */ \
+kernel void average_##TYPE(global const TYPE* A, global TYPE* B, const int range) { \
+	int width = get_global_size(0), height = get_global_size(1); \
+	int x = get_global_id(0), y = get_global_id(1); \
+	int plane = get_global_id(2)*width*height; \
+	float result = 0; \
+	for (int j = max(0, y - range); j <= min(height - 1, y + range); j++) \
+		for (int i = max(0, x - range); i <= min(width - 1, x + range); i++) \
+			result += LOAD_##TYPE(A, plane + i + j*width); \
+	STORE_##TYPE(result / ((2*range + 1) * (2*range + 1)), B, plane + x + y*width); \
+} \
+ \
+/* mask_size x mask_size convolution, pixels outside the image count as 0 like in convolutionND */ \
+kernel void convolution_##TYPE(global const TYPE* A, global TYPE* B, constant const float* mask, const int mask_size) { \
+	int width = get_global_size(0), height = get_global_size(1); \
+	int x = get_global_id(0), y = get_global_id(1); \
+	int plane = get_global_id(2)*width*height; \
+	int offset = mask_size / 2; \
+	float result = 0; \
+	for (int j = -offset; j <= offset; j++) \
+		for (int i = -offset; i <= offset; i++) { \
+			int xi = x + i, yi = y + j; \
+			if (xi >= 0 && xi < width && yi >= 0 && yi < height) \
+				result += LOAD_##TYPE(A, plane + xi + yi*width) * mask[(i + offset) + (j + offset)*mask_size]; \
+		} \
+	STORE_##TYPE(result, B, plane + x + y*width); \
+} \
+ \
+/* conversions through float images normalised to 0..1, global size (pixels) */ \
+kernel void to_float_##TYPE(global const TYPE* A, global float* B) { \
+	int id = get_global_id(0); \
+	B[id] = LOAD_##TYPE(A, id) / MAX; \
+} \
+ \
+kernel void from_float_##TYPE(global const float* A, global TYPE* B) { \
+	int id = get_global_id(0); \
+	STORE_##TYPE(A[id] * MAX, B, id); \
+}
+
+DEFINE_PIXEL(uchar, 255.0f)
+DEFINE_PIXEL(ushort, 65535.0f)
+DEFINE_PIXEL(float, 1.0f)
+DEFINE_PIXEL(half, 1.0f)
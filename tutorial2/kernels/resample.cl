@@ -0,0 +1,132 @@
+//resampling of planar uchar images to a different size, and Gaussian/Laplacian pyramids
+//pixel centres are at (x + 0.5) in both images, pixels outside the source are clamped to the edge
+
+#define RESAMPLE_BILINEAR 0
+#define RESAMPLE_BICUBIC 1
+#define RESAMPLE_LANCZOS 2
+#define RESAMPLE_AREA 3
+
+#define PI_F 3.14159265f
+
+//weight of source pixel i for an output pixel centred at centre (in source pixels); when downscaling the
+//filter is stretched by fscale so that it also removes the frequencies the smaller image cannot hold
+float resample_weight(int filter, int i, float centre, float fscale) {
+	if (filter == RESAMPLE_AREA) {
+		//overlap of the source pixel with the footprint of the output pixel
+		float extent = 0.5f * fscale;
+		return clamp(min(i + 1.0f, centre + extent) - max((float)i, centre - extent), 0.0f, 1.0f);
+	}
+
+	float t = fabs((i + 0.5f - centre) / fscale);
+	if (filter == RESAMPLE_BILINEAR)
+		return max(1.0f - t, 0.0f);
+	if (filter == RESAMPLE_BICUBIC) {
+		//Keys' cubic with a = -0.5 (Catmull-Rom)
+		if (t < 1.0f)
+			return (1.5f * t - 2.5f) * t * t + 1.0f;
+		if (t < 2.0f)
+			return ((-0.5f * t + 2.5f) * t - 4.0f) * t + 2.0f;
+		return 0.0f;
+	}
+	//Lanczos with 3 lobes
+	if (t < 1e-5f)
+		return 1.0f;
+	if (t >= 3.0f)
+		return 0.0f;
+	return 3.0f * sin(PI_F * t) * sin(PI_F * t / 3.0f) / (PI_F * PI_F * t * t);
+}
+
+float resample_support(int filter) {
+	if (filter == RESAMPLE_BICUBIC) return 2.0f;
+	if (filter == RESAMPLE_LANCZOS) return 3.0f;
+	if (filter == RESAMPLE_AREA) return 0.5f;
+	return 1.0f;
+}
+
+//weighted sum of count samples of a line, the weights are normalised so the taps clipped at the edges do not darken them
+#define RESAMPLE_LINE(SRC, STEP, LENGTH, DST_LENGTH, POS) \
+	float scale = (float)(LENGTH) / (DST_LENGTH); \
+	float fscale = max(scale, 1.0f); \
+	float centre = ((POS) + 0.5f) * scale; \
+	float support = resample_support(filter) * fscale; \
+	int first = max((int)floor(centre - support), 0), last = min((int)ceil(centre + support), (LENGTH) - 1); \
+	float sum = 0.0f, weights = 0.0f; \
+	for (int i = first; i <= last; i++) { \
+		float w = resample_weight(filter, i, centre, fscale); \
+		sum += w * (SRC)[i * (STEP)]; \
+		weights += w; \
+	}
+
+//horizontal pass into a float image of dst_width x src_height, global size (dst_width, src_height, channels)
+kernel void resample_rows(global const uchar* A, global float* T, const int src_width, const int filter) {
+	int dst_width = get_global_size(0), height = get_global_size(1);
+	int x = get_global_id(0), y = get_global_id(1), c = get_global_id(2);
+	global const uchar* row = A + y*src_width + c*src_width*height;
+	RESAMPLE_LINE(row, 1, src_width, dst_width, x)
+	T[x + y*dst_width + c*dst_width*height] = sum / weights;
+}
+
+//vertical pass, global size (dst_width, dst_height, channels)
+kernel void resample_columns(global const float* T, global uchar* B, const int src_height, const int filter) {
+	int width = get_global_size(0), dst_height = get_global_size(1);
+	int x = get_global_id(0), y = get_global_id(1), c = get_global_id(2);
+	global const float* column = T + x + c*width*src_height;
+	RESAMPLE_LINE(column, width, src_height, dst_height, y)
+	B[x + y*width + c*width*dst_height] = convert_uchar_sat_rte(sum / weights);
+}
+
+//5-tap binomial filter (1 4 6 4 1)/16 of Burt and Adelson
+constant float pyramid_taps[5] = { 0.0625f, 0.25f, 0.375f, 0.25f, 0.0625f };
+
+//next (half size) level of a Gaussian pyramid: the 5x5 filter evaluated at every second pixel, one launch
+//global size ((width + 1)/2, (height + 1)/2, channels)
+kernel void pyramid_down(global const uchar* A, global uchar* B, const int width, const int height) {
+	int half_width = get_global_size(0), half_height = get_global_size(1);
+	int x = get_global_id(0), y = get_global_id(1), c = get_global_id(2);
+	global const uchar* plane = A + c*width*height;
+
+	float sum = 0.0f;
+	for (int j = -2; j <= 2; j++) {
+		int yj = clamp(2*y + j, 0, height - 1);
+		float row = 0.0f;
+		for (int i = -2; i <= 2; i++)
+			row += pyramid_taps[i + 2] * plane[clamp(2*x + i, 0, width - 1) + yj*width];
+		sum += pyramid_taps[j + 2] * row;
+	}
+	B[x + y*half_width + c*half_width*half_height] = convert_uchar_sat_rte(sum);
+}
+
+//the half size level G (small_width x small_height) expanded to pixel (x, y) of the level below, rounded:
+//the taps of the same filter that fall on even positions, times 4 to make up for the missing samples
+int pyramid_expand(global const uchar* G, int x, int y, int small_width, int small_height) {
+	float sum = 0.0f;
+	for (int j = -2; j <= 2; j++) {
+		if ((y + j) & 1)
+			continue;
+		int yj = clamp((y + j) / 2, 0, small_height - 1);
+		for (int i = -2; i <= 2; i++) {
+			if ((x + i) & 1)
+				continue;
+			sum += pyramid_taps[i + 2] * pyramid_taps[j + 2] * G[clamp((x + i) / 2, 0, small_width - 1) + yj*small_width];
+		}
+	}
+	return convert_int_sat_rte(4.0f * sum);
+}
+
+//Laplacian level: the Gaussian level minus the expanded next one, as signed values, one launch
+//global size (width, height, channels) of the larger level
+kernel void pyramid_laplacian(global const uchar* G, global const uchar* G_next, global short* L, const int small_width, const int small_height) {
+	int width = get_global_size(0), height = get_global_size(1);
+	int x = get_global_id(0), y = get_global_id(1), c = get_global_id(2);
+	int id = x + y*width + c*width*height;
+	L[id] = G[id] - pyramid_expand(G_next + c*small_width*small_height, x, y, small_width, small_height);
+}
+
+//inverse of pyramid_laplacian: the expanded smaller level plus the Laplacian level, exact since the
+//expansion is rounded the same way
+kernel void pyramid_collapse(global const short* L, global const uchar* G_next, global uchar* G, const int small_width, const int small_height) {
+	int width = get_global_size(0), height = get_global_size(1);
+	int x = get_global_id(0), y = get_global_id(1), c = get_global_id(2);
+	int id = x + y*width + c*width*height;
+	G[id] = clamp(L[id] + pyramid_expand(G_next + c*small_width*small_height, x, y, small_width, small_height), 0, 255);
+}
@@ -0,0 +1,83 @@
+//box/mean filter as two passes whose cost per pixel does not depend on the radius: window sums along the
+//rows into a ushort image, then a running sum down the columns of that
+//the row sums of a (2*range+1) window fit in a ushort up to range 128, so the only intermediate is half
+//the size of a summed-area table of uint
+//sample c of pixel (x, y) is at (x + y*width)*layout.x + c*layout.y, i.e. layout (1, width*height) for planar
+//images and (3, 1) for packed RGB; the row sums are planar
+
+//every work-group prefix-sums a tile of get_local_size(1) rows, segment pixels each plus range on either side,
+//in local memory: neighbouring work-items load neighbouring pixels, and the window sum of tile position i is
+//P[i + 2*range] - P[i - 1]; the row is scanned in chunks of one work-item each, whose totals are then scanned
+//together; global size (tiles * local size x, height rounded up, channels), tile and totals hold
+//(segment + 2*range) and local size x uints per row
+kernel void box_rows(global const uchar* A, global ushort* R, const int range, const int width, const int height, const int segment,
+			const int2 layout, local uint* tile, local uint* totals) {
+	int lx = get_local_id(0), ly = get_local_id(1), size = get_local_size(0);
+	int y = get_global_id(1), c = get_global_id(2);
+	int x_begin = get_group_id(0) * segment, length = segment + 2 * range;
+	local uint* P = tile + ly*length;
+	local uint* T = totals + ly*size;
+	bool row = y < height;
+
+	//zeros outside the image, like avg_filterND
+	for (int i = lx; i < length; i += size) {
+		int x = x_begin - range + i;
+		P[i] = (row && x >= 0 && x < width) ? A[(x + y*width)*layout.x + c*layout.y] : 0;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	int chunk = (length + size - 1) / size, first = min(lx*chunk, length), last = min(first + chunk, length);
+	uint sum = 0;
+	for (int i = first; i < last; i++) {
+		sum += P[i];
+		P[i] = sum;
+	}
+	T[lx] = sum;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int stride = 1; stride < size; stride *= 2) {
+		uint add = lx >= stride ? T[lx - stride] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		T[lx] += add;
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+	uint offset = lx ? T[lx - 1] : 0;
+	for (int i = first; i < last; i++)
+		P[i] += offset;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int i = lx; i < segment; i += size) {
+		int x = x_begin + i;
+		if (row && x < width)
+			R[x + y*width + c*width*height] = P[i + 2*range] - (i ? P[i - 1] : 0);
+	}
+}
+
+//global size (width, ceil(height/segment), channels), neighbouring work-items read neighbouring columns;
+//each work-item slides over a segment of its column (starting the window costs 2*range reads), which keeps
+//enough work-items busy on images with few rows
+//inside_only: divide by the number of pixels of the window inside the image instead of the full window
+//(which treats pixels outside as 0, like avg_filterND)
+kernel void box_columns(global const ushort* R, global uchar* B, const int range, const int width, const int height, const int segment,
+			const int inside_only, const int2 layout) {
+	int x = get_global_id(0), c = get_global_id(2);
+	int y_begin = get_global_id(1) * segment;
+	int y_end = min(y_begin + segment, height);
+	global const ushort* column = R + x + c*width*height;
+
+	int window = 2 * range + 1;
+	int columns = inside_only ? min(x + range, width - 1) - max(x - range, 0) + 1 : window;
+
+	uint sum = 0;
+	for (int j = max(y_begin - range, 0); j < min(y_begin + range, height); j++)
+		sum += column[j*width];
+
+	for (int y = y_begin; y < y_end; y++) {
+		if (y + range < height)
+			sum += column[(y + range)*width];
+		int rows = inside_only ? min(y + range, height - 1) - max(y - range, 0) + 1 : window;
+		B[(x + y*width)*layout.x + c*layout.y] = (uchar)(sum / (rows * columns));
+		if (y - range >= 0)
+			sum -= column[(y - range)*width];
+	}
+}
@@ -0,0 +1,14 @@
+//temporal filters of the frame stream mode: state that lives on the device from one frame to the next
+
+//running average over the last frames: ring holds the last frames (frame size apart) and sums their samples,
+//the frame in ring slot is replaced by A and the sums are updated by the difference, so the cost does not
+//depend on the number of frames; count is the number of frames in the ring, the slots not yet written are
+//zero; sums of up to 255 * frames fit into a uint; one work-item per sample
+kernel void temporal_average(global const uchar* A, global uchar* ring, global uint* sums, global uchar* B, const int slot, const int count) {
+	int id = get_global_id(0), size = get_global_size(0);
+	uchar value = A[id];
+	uint sum = sums[id] - ring[id + slot*size] + value;
+	ring[id + slot*size] = value;
+	sums[id] = sum;
+	B[id] = (sum + count/2) / count;
+}
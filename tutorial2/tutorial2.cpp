@@ -3,6 +3,25 @@
 
 #include "Utils.h"
 #include "CImg.h"
+#include "Layout.h"
+#include "Convolution.h"
+#include "ImagePath.h"
+#include "Interleaved.h"
+#include "Pipeline.h"
+#include "Graph.h"
+#include "Fusion.h"
+#include "Lut.h"
+#include "Gradient.h"
+#include "Integral.h"
+#include "Sliding.h"
+#include "Morphology.h"
+#include "Resample.h"
+#include "Equalize.h"
+#include "Stream.h"
+#include "Pixel.h"
+#include "Colour.h"
+#include "Fft.h"
+#include "Video.h"
 
 
 using namespace cimg_library;
@@ -14,6 +33,17 @@ void print_help() {
 	std::cerr << "  -d : select device" << std::endl;
 	std::cerr << "  -l : list all platforms and devices" << std::endl;
 	std::cerr << "  -f : input image file (default: test.ppm)" << std::endl;
+	std::cerr << "  -e : display the edges (Sobel gradient magnitude) of the input image instead of the convolution" << std::endl;
+	std::cerr << "  -b : run a benchmark on the input image instead of displaying it (layout, convolution, tiled, image, interleaved, ppm, graph, fusion, lut, gradient, integral, sliding, morphology, resample, equalize, stream, pixel, colour, fft, video)" << std::endl;
+	std::cerr << "  -i : process every image of a directory or list file without display (batch mode)" << std::endl;
+	std::cerr << "  -s : process a single image too large for memory in strips of rows, without display (stream mode)" << std::endl;
+	std::cerr << "  -n : rows per strip of the stream mode (default: 256)" << std::endl;
+	std::cerr << "  -v : process a stream of frames from a file or - for stdin and write them to stdout (video mode)" << std::endl;
+	std::cerr << "  -x : size WIDTHxHEIGHT of raw RGB frames in the video mode (default: concatenated PPM frames)" << std::endl;
+	std::cerr << "  -t : frames of the running average of the video mode (default: 0, none)" << std::endl;
+	std::cerr << "  -o : output directory of the batch and stream modes (default: output)" << std::endl;
+	std::cerr << "  -k : comma separated filters of the batch, stream and video modes (default: gamma,convolution)" << std::endl;
+	std::cerr << "  -r, -w, -q : reader threads, writer threads and images in flight of the batch mode (default: 2, 2, 4)" << std::endl;
 	std::cerr << "  -h : print this message" << std::endl;
 }
 
@@ -22,12 +52,35 @@ int main(int argc, char **argv) {
 	int platform_id = 0;
 	int device_id = 0;
 	string image_filename = "test_large.ppm";
+	string benchmark = "";
+	bool edges = false;
+	string batch_input = "";
+	string batch_output = "output";
+	string batch_filters = "";
+	PipelineConfig batch_config;
+	string stream_input = "";
+	StreamConfig stream_config;
+	string video_input = "";
+	VideoConfig video_config;
 
 	for (int i = 1; i < argc; i++) {
 		if ((strcmp(argv[i], "-p") == 0) && (i < (argc - 1))) { platform_id = atoi(argv[++i]); }
 		else if ((strcmp(argv[i], "-d") == 0) && (i < (argc - 1))) { device_id = atoi(argv[++i]); }
 		else if (strcmp(argv[i], "-l") == 0) { std::cout << ListPlatformsDevices() << std::endl; }
 		else if ((strcmp(argv[i], "-f") == 0) && (i < (argc - 1))) { image_filename = argv[++i]; }
+		else if (strcmp(argv[i], "-e") == 0) { edges = true; }
+		else if ((strcmp(argv[i], "-b") == 0) && (i < (argc - 1))) { benchmark = argv[++i]; }
+		else if ((strcmp(argv[i], "-i") == 0) && (i < (argc - 1))) { batch_input = argv[++i]; }
+		else if ((strcmp(argv[i], "-s") == 0) && (i < (argc - 1))) { stream_input = argv[++i]; }
+		else if ((strcmp(argv[i], "-n") == 0) && (i < (argc - 1))) { stream_config.strip_rows = std::max(1, atoi(argv[++i])); }
+		else if ((strcmp(argv[i], "-v") == 0) && (i < (argc - 1))) { video_input = argv[++i]; }
+		else if ((strcmp(argv[i], "-x") == 0) && (i < (argc - 1))) { sscanf(argv[++i], "%dx%d", &video_config.width, &video_config.height); }
+		else if ((strcmp(argv[i], "-t") == 0) && (i < (argc - 1))) { video_config.temporal = std::max(0, atoi(argv[++i])); }
+		else if ((strcmp(argv[i], "-o") == 0) && (i < (argc - 1))) { batch_output = argv[++i]; }
+		else if ((strcmp(argv[i], "-k") == 0) && (i < (argc - 1))) { batch_filters = argv[++i]; }
+		else if ((strcmp(argv[i], "-r") == 0) && (i < (argc - 1))) { batch_config.readers = std::max(1, atoi(argv[++i])); }
+		else if ((strcmp(argv[i], "-w") == 0) && (i < (argc - 1))) { batch_config.writers = std::max(1, atoi(argv[++i])); }
+		else if ((strcmp(argv[i], "-q") == 0) && (i < (argc - 1))) { batch_config.slots = std::max(1, atoi(argv[++i])); }
 		else if (strcmp(argv[i], "-h") == 0) { print_help(); return 0; }
 	}
 
@@ -35,25 +88,16 @@ int main(int argc, char **argv) {
 
 	//detect any potential exceptions
 	try {
-		CImg<unsigned char> image_input(image_filename.c_str());
-		CImgDisplay disp_input(image_input,"input");
+		//the batch, stream and video modes read their own files, an image that does not fit in memory must not be loaded here
+		CImg<unsigned char> image_input;
+		if (batch_input.empty() && stream_input.empty() && video_input.empty())
+			image_input.assign(image_filename.c_str());
 
 		//a 3x3 convolution mask implementing an averaging filter
 		std::vector<float> convolution_mask = { 1.f / 9, 1.f / 9, 1.f / 9, 1.f / 9, 1.f / 9,
 							1.f / 9, 1.f / 9, 1.f / 9, 1.f / 9, 1.f / 9,
 							1.f / 9, 1.f / 9, 1.f / 9, 1.f / 9, 1.f / 9 };
 		
-
-		std::vector<int> sobel_Gx = {
-			-1, 0, 1,
-			-2, 0, 2,
-			-1, 0, +1
-		};
-		std::vector<int> sobel_Gy = {
-			1, 2, 1,
-			0, 0, 0,
-			-1, -2, -1
-		};
 		float gamma_val = 1.5f;
 		int mask_size = 2;
 		int conv_size = 5;
@@ -62,8 +106,8 @@ int main(int argc, char **argv) {
 		//Select computing devices
 		cl::Context context = GetContext(platform_id, device_id);
 
-		//display the selected device
-		std::cout << "Runing on " << GetPlatformName(platform_id) << ", " << GetDeviceName(platform_id, device_id) << std::endl;
+		//display the selected device, the video mode writes its frames to stdout
+		(video_input.empty() ? std::cout : std::cerr) << "Runing on " << GetPlatformName(platform_id) << ", " << GetDeviceName(platform_id, device_id) << std::endl;
 
 		//create a queue to which we will push commands for the device
 		cl::CommandQueue queue(context, CL_QUEUE_PROFILING_ENABLE);
@@ -72,6 +116,22 @@ int main(int argc, char **argv) {
 		cl::Program::Sources sources;
 
 		AddSources(sources, "kernels/my_kernels.cl");
+		AddSources(sources, "kernels/layout.cl");
+		AddSources(sources, "kernels/convolution.cl");
+		AddSources(sources, "kernels/image.cl");
+		AddSources(sources, "kernels/interleaved.cl");
+		AddSources(sources, "kernels/graph.cl");
+		AddSources(sources, "kernels/lut.cl");
+		AddSources(sources, "kernels/gradient.cl");
+		AddSources(sources, "kernels/integral.cl");
+		AddSources(sources, "kernels/sliding.cl");
+		AddSources(sources, "kernels/morphology.cl");
+		AddSources(sources, "kernels/resample.cl");
+		AddSources(sources, "kernels/equalize.cl");
+		AddSources(sources, "kernels/pixel.cl");
+		AddSources(sources, "kernels/colour.cl");
+		AddSources(sources, "kernels/fft.cl");
+		AddSources(sources, "kernels/video.cl");
 
 		cl::Program program(context, sources);
 
@@ -86,20 +146,123 @@ int main(int argc, char **argv) {
 			throw err;
 		}
 
+		if (!batch_input.empty() || !stream_input.empty() || !video_input.empty()) {
+			if (!batch_filters.empty())
+				batch_config.filters = ParseFilters(batch_filters);
+			vector<float> batch_mask = BoxMask(5);
+			batch_config.params.gamma = gamma_val;
+			batch_config.params.range = mask_size;
+			batch_config.params.mask_size = 5;
+			batch_config.params.mask = cl::Buffer(context, CL_MEM_READ_ONLY, batch_mask.size() * sizeof(float));
+			queue.enqueueWriteBuffer(batch_config.params.mask, CL_TRUE, 0, batch_mask.size() * sizeof(float), &batch_mask[0]);
+			if (!video_input.empty()) {
+				video_config.filters = batch_config.filters;
+				video_config.params = batch_config.params;
+				RunVideo(context, program, video_input, video_config);
+			}
+			else if (!stream_input.empty()) {
+				stream_config.filters = batch_config.filters;
+				stream_config.params = batch_config.params;
+				RunStream(context, queue, program, stream_input, batch_output, stream_config);
+			}
+			else
+				RunPipeline(context, program, batch_input, batch_output, batch_config);
+			return 0;
+		}
+
+		if (benchmark == "layout") {
+			BenchmarkLayout(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "convolution") {
+			BenchmarkConvolution(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "tiled") {
+			BenchmarkTiled(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "image") {
+			BenchmarkImagePath(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "interleaved") {
+			BenchmarkInterleaved(context, queue, program, image_filename, image_input);
+			return 0;
+		}
+		else if (benchmark == "ppm") {
+			BenchmarkPpm(context, queue, image_filename);
+			return 0;
+		}
+		else if (benchmark == "graph") {
+			BenchmarkGraph(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "fusion") {
+			BenchmarkFusion(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "lut") {
+			BenchmarkLut(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "gradient") {
+			BenchmarkGradient(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "integral") {
+			BenchmarkIntegral(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "sliding") {
+			BenchmarkSliding(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "morphology") {
+			BenchmarkMorphology(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "resample") {
+			BenchmarkResample(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "equalize") {
+			BenchmarkEqualize(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "stream") {
+			BenchmarkStream(context, queue, program, image_filename);
+			return 0;
+		}
+		else if (benchmark == "pixel") {
+			BenchmarkPixel(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "colour") {
+			BenchmarkColour(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "fft") {
+			BenchmarkFft(context, queue, program, image_input);
+			return 0;
+		}
+		else if (benchmark == "video") {
+			BenchmarkVideo(context, queue, program, image_input);
+			return 0;
+		}
+
 		//--------device operations
 
 		//device - buffers
 		cl::Buffer dev_image_input(context, CL_MEM_READ_ONLY, image_input.size());
 		cl::Buffer dev_image_output(context, CL_MEM_READ_WRITE, image_input.size()); //should be the same as input image
 		cl::Buffer dev_convolution_mask(context, CL_MEM_READ_ONLY, convolution_mask.size()*sizeof(float));
-		cl::Buffer dev_sobel_gx(context, CL_MEM_READ_ONLY, sobel_Gx.size()*sizeof(int));
-		cl::Buffer grad_x(context, CL_MEM_READ_WRITE, sobel_Gx.size()*sizeof(int));
+		cl::Buffer dev_gradient(context, CL_MEM_READ_WRITE, image_input.width()*image_input.height());
 
 
 		//Copy images to device memory
 		queue.enqueueWriteBuffer(dev_image_input, CL_TRUE, 0, image_input.size(), &image_input.data()[0]);
 		queue.enqueueWriteBuffer(dev_convolution_mask, CL_TRUE, 0, convolution_mask.size()*sizeof(float), &convolution_mask[0]);
-		queue.enqueueWriteBuffer(dev_sobel_gx, CL_TRUE, 0, sobel_Gx.size()*sizeof(int), &sobel_Gx[0]);
 
 		int width = image_input.width();
 		int height = image_input.height();
@@ -123,11 +286,6 @@ int main(int argc, char **argv) {
 		conv_kernel.setArg(2, dev_convolution_mask);
 		conv_kernel.setArg(3, conv_size);
 
-		cl::Kernel edgingX = cl::Kernel(program, "convolutionND");
-		edgingX.setArg(0, dev_image_input);
-		edgingX.setArg(1, dev_image_output);
-		edgingX.setArg(2, dev_sobel_gx);
-
 		cl::Kernel gamma_correct = cl::Kernel(program, "gamma_transform");
 		gamma_correct.setArg(0, dev_image_input);
 		gamma_correct.setArg(1, dev_image_output);
@@ -139,16 +297,22 @@ int main(int argc, char **argv) {
 		std::cout << std::to_string(image_input.size()) << '\n';
 		// std::cout << std::to_string(image_output.size()) << '\n';
 		
-		queue.enqueueNDRangeKernel(conv_kernel, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &prof_event);
+		//edges: gray conversion, both Sobel derivatives and the magnitude in one launch into a single channel image;
+		//convolutionND cannot do this, it clamps the negative half of each derivative to 0
+		cl::Buffer no_orientation;
+		if (edges)
+			prof_event = Gradient(queue, program, dev_image_input, dev_gradient, no_orientation, width, height, channels, GradientConfig());
+		else
+			queue.enqueueNDRangeKernel(conv_kernel, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &prof_event);
 		//queue.enqueueNDRangeKernel(blur_kernel, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &prof_event);
 		//queue.enqueueNDRangeKernel(gray_kernel, cl::NullRange, cl::NDRange(image_input.size()/3), cl::NullRange, NULL, &prof_event);
 		
 		//queue.enqueueNDRangeKernel(gamma_correct, cl::NullRange, cl::NDRange(image_input.size()/3), cl::NullRange, NULL, &prof_event);
-		//queue.enqueueNDRangeKernel(edgingX, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &prof_event);
 		
-		vector<unsigned char> output_buffer(image_input.size());
+		int output_channels = edges ? 1 : channels;
+		vector<unsigned char> output_buffer(width * height * output_channels);
 		//Copy the result from device to host
-		queue.enqueueReadBuffer(dev_image_output, CL_TRUE, 0, output_buffer.size(), &output_buffer.data()[0]);
+		queue.enqueueReadBuffer(edges ? dev_gradient : dev_image_output, CL_TRUE, 0, output_buffer.size(), &output_buffer.data()[0]);
 		
 		std::cout << "Kernel Execution Time [ns]: " <<
 			prof_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
@@ -158,7 +322,8 @@ int main(int argc, char **argv) {
 		std::cout << GetFullProfilingInfo(prof_event, ProfilingResolution::PROF_US) << std::endl;
 
 
-		CImg<unsigned char> output_image(output_buffer.data(), image_input.width(), image_input.height(), image_input.depth(), image_input.spectrum());
+		CImg<unsigned char> output_image(output_buffer.data(), image_input.width(), image_input.height(), image_input.depth(), output_channels);
+		CImgDisplay disp_input(image_input,"input");
 		CImgDisplay disp_output(output_image,"output");
 		
  		while (!disp_input.is_closed() && !disp_output.is_closed()
@@ -174,6 +339,9 @@ int main(int argc, char **argv) {
 	catch (CImgException& err) {
 		std::cerr << "ERROR: " << err.what() << std::endl;
 	}
+	catch (const std::exception& err) {
+		std::cerr << "ERROR: " << err.what() << std::endl;
+	}
 
 	return 0;
 }
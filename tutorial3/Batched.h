@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <iomanip>
+
+#include "Utils.h"
+
+//the elementwise operations of tutorial 1
+enum BatchOp { BATCH_ADD, BATCH_MUL, BATCH_MULTADD };
+
+enum SegReduceOp { SEG_SUM, SEG_MIN, SEG_MAX };
+
+const char* BatchOpName(BatchOp op) {
+	switch (op) {
+	case BATCH_ADD: return "add";
+	case BATCH_MUL: return "mul";
+	default: return "multadd";
+	}
+}
+
+const char* SegReduceOpName(SegReduceOp op) {
+	switch (op) {
+	case SEG_SUM: return "sum";
+	case SEG_MIN: return "min";
+	default: return "max";
+	}
+}
+
+//C = op(A, B) over elements first .. first+count-1 of packed buffers; the default covers every segment at once
+cl::Event BatchElementwise(cl::CommandQueue& queue, cl::Program& program, BatchOp op, const cl::Buffer& A, const cl::Buffer& B,
+			cl::Buffer& C, int total, int first = 0, int count = -1, size_t local_size = 256) {
+	static const char* names[] = { "batch_add", "batch_mul", "batch_multadd" };
+	cl::Kernel kernel(program, names[op]);
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+	kernel.setArg(2, C);
+	if (count < 0)
+		count = total - first;
+	kernel.setArg(3, first + count);
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NDRange(first), cl::NDRange((count + local_size - 1) / local_size * local_size),
+		cl::NDRange(local_size), NULL, &prof_event);
+	return prof_event;
+}
+
+//work-items per segment: the smallest power of 2 covering the mean segment length, at most local_size
+int SegmentLanes(double mean_length, size_t local_size = 256) {
+	int lanes = 1;
+	while (lanes < mean_length && (size_t)lanes < local_size)
+		lanes *= 2;
+	return lanes;
+}
+
+//out[s] = reduction of segment s for s = seg_first .. segments-1, with lanes work-items per segment
+//(lanes must be a power of 2 no larger than local_size)
+cl::Event SegmentedReduce(cl::CommandQueue& queue, cl::Program& program, SegReduceOp op, const cl::Buffer& A,
+			const cl::Buffer& offsets, cl::Buffer& out, int segments, int lanes, int seg_first = 0, size_t local_size = 256) {
+	static const char* names[] = { "seg_reduce_sum", "seg_reduce_min", "seg_reduce_max" };
+	cl::Kernel kernel(program, names[op]);
+	kernel.setArg(0, A);
+	kernel.setArg(1, offsets);
+	kernel.setArg(2, out);
+	kernel.setArg(3, seg_first);
+	kernel.setArg(4, segments);
+	kernel.setArg(5, lanes);
+	kernel.setArg(6, cl::Local(local_size * sizeof(int)));
+
+	size_t work_items = (size_t)(segments - seg_first) * lanes;
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange((work_items + local_size - 1) / local_size * local_size),
+		cl::NDRange(local_size), NULL, &prof_event);
+	return prof_event;
+}
+
+//wall-clock time of a function including the time to finish the queue, in microseconds
+template <typename F>
+double TimeQueue(cl::CommandQueue& queue, F f) {
+	queue.finish();
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	f();
+	queue.finish();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count() / 1000.0;
+}
+
+//batched (single launch) against one launch per segment for segment batches of different shapes
+void BenchmarkBatched(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program) {
+	struct BatchShape { const char* name; int segments; int min_length; int max_length; };
+	BatchShape shapes[] = {
+		{ "10000 x 4..64", 10000, 4, 64 },
+		{ "2000 x 100..1000", 2000, 100, 1000 },
+		{ "100 x 50000", 100, 50000, 50000 },
+	};
+
+	std::cout << std::setw(18) << "segments" << std::setw(10) << "op" << std::setw(8) << "lanes" << std::setw(16) << "batched [us]"
+		<< std::setw(16) << "looped [us]" << std::setw(10) << "speedup" << std::setw(8) << "check" << std::endl;
+
+	for (const BatchShape& shape : shapes) {
+		vector<int> offsets(shape.segments + 1, 0);
+		for (int s = 0; s < shape.segments; s++)
+			offsets[s + 1] = offsets[s] + shape.min_length + rand() % (shape.max_length - shape.min_length + 1);
+		int total = offsets[shape.segments];
+
+		vector<int> A(total), B(total), C(total);
+		for (int i = 0; i < total; i++) {
+			A[i] = rand() % 200 - 100;
+			B[i] = rand() % 200 - 100;
+		}
+
+		cl::Buffer buffer_A(context, CL_MEM_READ_ONLY, total * sizeof(int));
+		cl::Buffer buffer_B(context, CL_MEM_READ_ONLY, total * sizeof(int));
+		cl::Buffer buffer_C(context, CL_MEM_READ_WRITE, total * sizeof(int));
+		cl::Buffer buffer_offsets(context, CL_MEM_READ_ONLY, offsets.size() * sizeof(int));
+		cl::Buffer buffer_out(context, CL_MEM_READ_WRITE, shape.segments * sizeof(int));
+		queue.enqueueWriteBuffer(buffer_A, CL_TRUE, 0, total * sizeof(int), &A[0]);
+		queue.enqueueWriteBuffer(buffer_B, CL_TRUE, 0, total * sizeof(int), &B[0]);
+		queue.enqueueWriteBuffer(buffer_offsets, CL_TRUE, 0, offsets.size() * sizeof(int), &offsets[0]);
+
+		for (BatchOp op : { BATCH_ADD, BATCH_MUL, BATCH_MULTADD }) {
+			double batched = TimeQueue(queue, [&]() { BatchElementwise(queue, program, op, buffer_A, buffer_B, buffer_C, total); });
+			queue.enqueueReadBuffer(buffer_C, CL_TRUE, 0, total * sizeof(int), &C[0]);
+			bool correct = true;
+			for (int i = 0; i < total; i++) {
+				int expected = (op == BATCH_ADD) ? A[i] + B[i] : (op == BATCH_MUL) ? A[i] * B[i] : A[i] * B[i] + B[i];
+				correct = correct && (C[i] == expected);
+			}
+
+			double looped = TimeQueue(queue, [&]() {
+				for (int s = 0; s < shape.segments; s++)
+					BatchElementwise(queue, program, op, buffer_A, buffer_B, buffer_C, total, offsets[s], offsets[s + 1] - offsets[s]);
+			});
+
+			std::cout << std::setw(18) << shape.name << std::setw(10) << BatchOpName(op) << std::setw(8) << "-" << std::setw(16) << std::fixed << std::setprecision(0) << batched
+				<< std::setw(16) << looped << std::setw(10) << std::setprecision(1) << looped / batched << std::setw(8) << (correct ? "OK" : "FAILED") << std::endl;
+		}
+
+		int lanes = SegmentLanes((double)total / shape.segments);
+		for (SegReduceOp op : { SEG_SUM, SEG_MIN, SEG_MAX }) {
+			double batched = TimeQueue(queue, [&]() { SegmentedReduce(queue, program, op, buffer_A, buffer_offsets, buffer_out, shape.segments, lanes); });
+			vector<int> out(shape.segments);
+			queue.enqueueReadBuffer(buffer_out, CL_TRUE, 0, shape.segments * sizeof(int), &out[0]);
+
+			bool correct = true;
+			for (int s = 0; s < shape.segments; s++) {
+				int expected = (op == SEG_SUM) ? 0 : (op == SEG_MIN) ? INT_MAX : INT_MIN;
+				for (int i = offsets[s]; i < offsets[s + 1]; i++)
+					expected = (op == SEG_SUM) ? expected + A[i] : (op == SEG_MIN) ? std::min(expected, A[i]) : std::max(expected, A[i]);
+				correct = correct && (out[s] == expected);
+			}
+
+			//one work-group per segment and one launch per segment
+			double looped = TimeQueue(queue, [&]() {
+				for (int s = 0; s < shape.segments; s++)
+					SegmentedReduce(queue, program, op, buffer_A, buffer_offsets, buffer_out, s + 1, 256, s);
+			});
+
+			std::cout << std::setw(18) << shape.name << std::setw(10) << SegReduceOpName(op) << std::setw(8) << lanes << std::setw(16) << std::setprecision(0) << batched
+				<< std::setw(16) << looped << std::setw(10) << std::setprecision(1) << looped / batched << std::setw(8) << (correct ? "OK" : "FAILED") << std::endl;
+		}
+	}
+}
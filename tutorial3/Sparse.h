@@ -0,0 +1,464 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+
+#include "Utils.h"
+
+//coordinate list, the usual way sparse matrices are assembled
+struct CooMatrix {
+	int rows, cols;
+	vector<int> row, col;
+	vector<float> val;
+};
+
+//compressed sparse rows: the entries of row r are row_ptr[r] .. row_ptr[r+1]-1
+struct CsrMatrix {
+	int rows, cols;
+	vector<int> row_ptr, col;
+	vector<float> val;
+};
+
+//every row padded to width entries, stored column-major, padding has col = -1
+struct EllMatrix {
+	int rows, cols, width;
+	vector<int> col;
+	vector<float> val;
+};
+
+//chunks of C rows, each its own column-major ELL block; rows are sorted by length within windows of
+//sigma rows first, row_perm[slot] is the matrix row stored in that slot (-1 for padding slots)
+struct SellMatrix {
+	int rows, cols, C, sigma;
+	vector<int> chunk_ptr, chunk_width, row_perm, col;
+	vector<float> val;
+};
+
+enum SpmvFormat {
+	SPMV_CSR_SCALAR,	//one work-item per row
+	SPMV_CSR_VECTOR,	//several work-items per row
+	SPMV_ELL,
+	SPMV_SELL
+};
+
+const char* SpmvFormatName(SpmvFormat format) {
+	switch (format) {
+	case SPMV_CSR_SCALAR: return "CSR scalar";
+	case SPMV_CSR_VECTOR: return "CSR vector";
+	case SPMV_ELL: return "ELL";
+	case SPMV_SELL: return "SELL-C-sigma";
+	default: return "unknown";
+	}
+}
+
+//counting sort of the entries by row, entries of a row are ordered by column
+CsrMatrix CooToCsr(const CooMatrix& coo) {
+	CsrMatrix csr;
+	csr.rows = coo.rows;
+	csr.cols = coo.cols;
+	csr.row_ptr.assign(coo.rows + 1, 0);
+	csr.col.resize(coo.val.size());
+	csr.val.resize(coo.val.size());
+
+	for (size_t i = 0; i < coo.row.size(); i++)
+		csr.row_ptr[coo.row[i] + 1]++;
+	for (int r = 0; r < coo.rows; r++)
+		csr.row_ptr[r + 1] += csr.row_ptr[r];
+
+	vector<int> next(csr.row_ptr.begin(), csr.row_ptr.end() - 1);
+	for (size_t i = 0; i < coo.row.size(); i++) {
+		int j = next[coo.row[i]]++;
+		csr.col[j] = coo.col[i];
+		csr.val[j] = coo.val[i];
+	}
+
+	vector<std::pair<int, float> > entries;
+	for (int r = 0; r < csr.rows; r++) {
+		entries.clear();
+		for (int j = csr.row_ptr[r]; j < csr.row_ptr[r + 1]; j++)
+			entries.push_back(std::make_pair(csr.col[j], csr.val[j]));
+		std::sort(entries.begin(), entries.end());
+		for (size_t k = 0; k < entries.size(); k++) {
+			csr.col[csr.row_ptr[r] + k] = entries[k].first;
+			csr.val[csr.row_ptr[r] + k] = entries[k].second;
+		}
+	}
+
+	return csr;
+}
+
+EllMatrix CsrToEll(const CsrMatrix& csr) {
+	EllMatrix ell;
+	ell.rows = csr.rows;
+	ell.cols = csr.cols;
+	ell.width = 0;
+	for (int r = 0; r < csr.rows; r++)
+		ell.width = std::max(ell.width, csr.row_ptr[r + 1] - csr.row_ptr[r]);
+
+	ell.col.assign((size_t)ell.width * ell.rows, -1);
+	ell.val.assign((size_t)ell.width * ell.rows, 0.0f);
+	for (int r = 0; r < csr.rows; r++) {
+		for (int j = csr.row_ptr[r]; j < csr.row_ptr[r + 1]; j++) {
+			size_t k = j - csr.row_ptr[r];
+			ell.col[k * ell.rows + r] = csr.col[j];
+			ell.val[k * ell.rows + r] = csr.val[j];
+		}
+	}
+
+	return ell;
+}
+
+SellMatrix CsrToSell(const CsrMatrix& csr, int C = 32, int sigma = 1024) {
+	SellMatrix sell;
+	sell.rows = csr.rows;
+	sell.cols = csr.cols;
+	sell.C = C;
+	sell.sigma = sigma;
+
+	int chunks = (csr.rows + C - 1) / C;
+	sell.row_perm.assign(chunks * C, -1);
+	for (int r = 0; r < csr.rows; r++)
+		sell.row_perm[r] = r;
+
+	//sort by decreasing length inside each window, so rows of similar length share a chunk
+	for (int start = 0; start < csr.rows; start += sigma) {
+		int end = std::min(start + sigma, csr.rows);
+		std::stable_sort(sell.row_perm.begin() + start, sell.row_perm.begin() + end, [&csr](int a, int b) {
+			return csr.row_ptr[a + 1] - csr.row_ptr[a] > csr.row_ptr[b + 1] - csr.row_ptr[b];
+		});
+	}
+
+	sell.chunk_ptr.assign(chunks + 1, 0);
+	sell.chunk_width.assign(chunks, 0);
+	for (int chunk = 0; chunk < chunks; chunk++) {
+		for (int lane = 0; lane < C; lane++) {
+			int r = sell.row_perm[chunk * C + lane];
+			if (r >= 0)
+				sell.chunk_width[chunk] = std::max(sell.chunk_width[chunk], csr.row_ptr[r + 1] - csr.row_ptr[r]);
+		}
+		sell.chunk_ptr[chunk + 1] = sell.chunk_ptr[chunk] + sell.chunk_width[chunk] * C;
+	}
+
+	sell.col.assign(sell.chunk_ptr[chunks], -1);
+	sell.val.assign(sell.chunk_ptr[chunks], 0.0f);
+	for (int slot = 0; slot < chunks * C; slot++) {
+		int r = sell.row_perm[slot];
+		if (r < 0)
+			continue;
+		int offset = sell.chunk_ptr[slot / C] + slot % C;
+		for (int j = csr.row_ptr[r]; j < csr.row_ptr[r + 1]; j++) {
+			int k = j - csr.row_ptr[r];
+			sell.col[offset + k * C] = csr.col[j];
+			sell.val[offset + k * C] = csr.val[j];
+		}
+	}
+
+	return sell;
+}
+
+vector<float> SpmvReference(const CsrMatrix& csr, const vector<float>& x) {
+	vector<float> y(csr.rows);
+	for (int r = 0; r < csr.rows; r++) {
+		double result = 0.0;
+		for (int j = csr.row_ptr[r]; j < csr.row_ptr[r + 1]; j++)
+			result += (double)csr.val[j] * x[csr.col[j]];
+		y[r] = (float)result;
+	}
+	return y;
+}
+
+//device buffer holding a copy of v (at least one element, so that empty matrices still get a valid buffer)
+template <typename T>
+cl::Buffer UploadVector(const cl::Context& context, cl::CommandQueue& queue, const vector<T>& v) {
+	cl::Buffer buffer(context, CL_MEM_READ_ONLY, std::max(v.size(), (size_t)1) * sizeof(T));
+	if (!v.empty())
+		queue.enqueueWriteBuffer(buffer, CL_TRUE, 0, v.size() * sizeof(T), &v[0]);
+	return buffer;
+}
+
+struct RowStats {
+	int rows;
+	int nnz;
+	int min_length;
+	int max_length;
+	double mean;
+};
+
+//row length statistics of a CSR matrix on the device, using the reduction kernels from my_kernels.cl
+RowStats GatherRowStats(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program,
+			const cl::Buffer& row_ptr, int rows, size_t local_size = 256) {
+	size_t padded = (rows + local_size - 1) / local_size * local_size;
+	cl::Buffer lengths(context, CL_MEM_READ_WRITE, padded * sizeof(int));
+	cl::Buffer min_lengths(context, CL_MEM_READ_WRITE, padded * sizeof(int));
+	cl::Buffer buffer_sum(context, CL_MEM_READ_WRITE, sizeof(int));
+	cl::Buffer buffer_min(context, CL_MEM_READ_WRITE, sizeof(int));
+	cl::Buffer buffer_max(context, CL_MEM_READ_WRITE, sizeof(int));
+
+	int init_sum = 0, init_min = INT_MAX, init_max = 0;
+	queue.enqueueWriteBuffer(buffer_sum, CL_TRUE, 0, sizeof(int), &init_sum);
+	queue.enqueueWriteBuffer(buffer_min, CL_TRUE, 0, sizeof(int), &init_min);
+	queue.enqueueWriteBuffer(buffer_max, CL_TRUE, 0, sizeof(int), &init_max);
+
+	cl::Kernel lengths_kernel(program, "csr_row_lengths");
+	lengths_kernel.setArg(0, row_ptr);
+	lengths_kernel.setArg(1, lengths);
+	lengths_kernel.setArg(2, min_lengths);
+	lengths_kernel.setArg(3, rows);
+	lengths_kernel.setArg(4, INT_MAX);
+	queue.enqueueNDRangeKernel(lengths_kernel, cl::NullRange, cl::NDRange(padded), cl::NDRange(local_size));
+
+	cl::Kernel sum_kernel(program, "reduce_add_4");
+	sum_kernel.setArg(0, lengths);
+	sum_kernel.setArg(1, buffer_sum);
+	sum_kernel.setArg(2, cl::Local(local_size * sizeof(int)));
+	queue.enqueueNDRangeKernel(sum_kernel, cl::NullRange, cl::NDRange(padded), cl::NDRange(local_size));
+
+	cl::Kernel min_kernel(program, "reduce_min");
+	min_kernel.setArg(0, min_lengths);
+	min_kernel.setArg(1, buffer_min);
+	min_kernel.setArg(2, cl::Local(local_size * sizeof(int)));
+	queue.enqueueNDRangeKernel(min_kernel, cl::NullRange, cl::NDRange(padded), cl::NDRange(local_size));
+
+	cl::Kernel max_kernel(program, "reduce_max");
+	max_kernel.setArg(0, lengths);
+	max_kernel.setArg(1, buffer_max);
+	max_kernel.setArg(2, cl::Local(local_size * sizeof(int)));
+	queue.enqueueNDRangeKernel(max_kernel, cl::NullRange, cl::NDRange(padded), cl::NDRange(local_size));
+
+	RowStats stats;
+	stats.rows = rows;
+	queue.enqueueReadBuffer(buffer_sum, CL_TRUE, 0, sizeof(int), &stats.nnz);
+	queue.enqueueReadBuffer(buffer_min, CL_TRUE, 0, sizeof(int), &stats.min_length);
+	queue.enqueueReadBuffer(buffer_max, CL_TRUE, 0, sizeof(int), &stats.max_length);
+	stats.mean = rows ? (double)stats.nnz / rows : 0.0;
+
+	return stats;
+}
+
+//pick a format from the row length statistics:
+//long rows are shared between several work-items, regular short rows lose little to ELL padding,
+//irregular rows need SELL's sorting to keep the padding down unless the matrix is too small to benefit
+SpmvFormat ChooseSpmvFormat(const RowStats& stats) {
+	if (stats.mean >= 32)
+		return SPMV_CSR_VECTOR;
+	if (stats.max_length <= 1.5 * stats.mean + 1)
+		return SPMV_ELL;
+	if (stats.rows < 4096)
+		return SPMV_CSR_SCALAR;
+	return SPMV_SELL;
+}
+
+//work-items per row for CSR vector: the smallest power of 2 covering the mean row length, at most 32
+int CsrVectorLanes(const RowStats& stats) {
+	int lanes = 2;
+	while (lanes < stats.mean && lanes < 32)
+		lanes *= 2;
+	return lanes;
+}
+
+struct DeviceCsr {
+	int rows;
+	cl::Buffer row_ptr, col, val;
+};
+
+struct DeviceEll {
+	int rows, width;
+	cl::Buffer col, val;
+};
+
+struct DeviceSell {
+	int slots, C;
+	cl::Buffer chunk_ptr, chunk_width, row_perm, col, val;
+};
+
+DeviceCsr UploadCsr(const cl::Context& context, cl::CommandQueue& queue, const CsrMatrix& csr) {
+	DeviceCsr A = { csr.rows, UploadVector(context, queue, csr.row_ptr), UploadVector(context, queue, csr.col), UploadVector(context, queue, csr.val) };
+	return A;
+}
+
+DeviceEll UploadEll(const cl::Context& context, cl::CommandQueue& queue, const EllMatrix& ell) {
+	DeviceEll A = { ell.rows, ell.width, UploadVector(context, queue, ell.col), UploadVector(context, queue, ell.val) };
+	return A;
+}
+
+DeviceSell UploadSell(const cl::Context& context, cl::CommandQueue& queue, const SellMatrix& sell) {
+	DeviceSell A = { (int)sell.row_perm.size(), sell.C, UploadVector(context, queue, sell.chunk_ptr), UploadVector(context, queue, sell.chunk_width),
+		UploadVector(context, queue, sell.row_perm), UploadVector(context, queue, sell.col), UploadVector(context, queue, sell.val) };
+	return A;
+}
+
+//y = A*x with a CSR matrix, lanes is only used by the vector kernel
+cl::Event SpmvCsr(cl::CommandQueue& queue, cl::Program& program, const DeviceCsr& A, const cl::Buffer& x, cl::Buffer& y,
+			bool vector, int lanes = 32, size_t local_size = 256) {
+	cl::Kernel kernel(program, vector ? "spmv_csr_vector" : "spmv_csr_scalar");
+	kernel.setArg(0, A.row_ptr);
+	kernel.setArg(1, A.col);
+	kernel.setArg(2, A.val);
+	kernel.setArg(3, x);
+	kernel.setArg(4, y);
+	kernel.setArg(5, A.rows);
+
+	size_t work_items = A.rows;
+	if (vector) {
+		kernel.setArg(6, lanes);
+		kernel.setArg(7, cl::Local(local_size * sizeof(float)));
+		work_items *= lanes;
+	}
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange((work_items + local_size - 1) / local_size * local_size),
+		cl::NDRange(local_size), NULL, &prof_event);
+	return prof_event;
+}
+
+cl::Event SpmvEll(cl::CommandQueue& queue, cl::Program& program, const DeviceEll& A, const cl::Buffer& x, cl::Buffer& y,
+			size_t local_size = 256) {
+	cl::Kernel kernel(program, "spmv_ell");
+	kernel.setArg(0, A.col);
+	kernel.setArg(1, A.val);
+	kernel.setArg(2, x);
+	kernel.setArg(3, y);
+	kernel.setArg(4, A.rows);
+	kernel.setArg(5, A.width);
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange((A.rows + local_size - 1) / local_size * local_size),
+		cl::NDRange(local_size), NULL, &prof_event);
+	return prof_event;
+}
+
+//one work-group per chunk
+cl::Event SpmvSell(cl::CommandQueue& queue, cl::Program& program, const DeviceSell& A, const cl::Buffer& x, cl::Buffer& y) {
+	cl::Kernel kernel(program, "spmv_sell");
+	kernel.setArg(0, A.chunk_ptr);
+	kernel.setArg(1, A.chunk_width);
+	kernel.setArg(2, A.row_perm);
+	kernel.setArg(3, A.col);
+	kernel.setArg(4, A.val);
+	kernel.setArg(5, x);
+	kernel.setArg(6, y);
+	kernel.setArg(7, A.C);
+
+	cl::Event prof_event;
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(A.slots), cl::NDRange(A.C), NULL, &prof_event);
+	return prof_event;
+}
+
+//synthetic test matrices, row lengths drawn by the given function and columns spread uniformly
+template <typename F>
+CooMatrix RandomSparseMatrix(int rows, int cols, F row_length) {
+	CooMatrix coo;
+	coo.rows = rows;
+	coo.cols = cols;
+	for (int r = 0; r < rows; r++) {
+		int length = std::min(row_length(r), cols);
+		for (int k = 0; k < length; k++) {
+			coo.row.push_back(r);
+			coo.col.push_back(rand() % cols);
+			coo.val.push_back((rand() % 2000 - 1000) / 1000.0f);
+		}
+	}
+	return coo;
+}
+
+//5-point Laplacian on an n x n grid, the typical regular matrix from PDE solvers
+CooMatrix LaplacianMatrix(int n) {
+	CooMatrix coo;
+	coo.rows = coo.cols = n * n;
+	for (int y = 0; y < n; y++) {
+		for (int x = 0; x < n; x++) {
+			int r = y * n + x;
+			int neighbours[4][2] = { { x - 1, y }, { x + 1, y }, { x, y - 1 }, { x, y + 1 } };
+			coo.row.push_back(r); coo.col.push_back(r); coo.val.push_back(4.0f);
+			for (int i = 0; i < 4; i++) {
+				if (neighbours[i][0] >= 0 && neighbours[i][0] < n && neighbours[i][1] >= 0 && neighbours[i][1] < n) {
+					coo.row.push_back(r);
+					coo.col.push_back(neighbours[i][1] * n + neighbours[i][0]);
+					coo.val.push_back(-1.0f);
+				}
+			}
+		}
+	}
+	return coo;
+}
+
+bool SpmvCheck(const vector<float>& y, const vector<float>& reference) {
+	for (size_t i = 0; i < y.size(); i++)
+		if (std::fabs(y[i] - reference[i]) > 1e-3f * (1.0f + std::fabs(reference[i])))
+			return false;
+	return true;
+}
+
+//every format on matrices with different sparsity patterns; the format picked from the row statistics is marked with *
+void BenchmarkSpmv(const cl::Context& context, cl::CommandQueue& queue, cl::Program& program) {
+	const int repeats = 5;
+	const size_t max_padded_entries = 64 << 20; //skip ELL when padding would exceed this many entries
+
+	struct TestMatrix { string name; CooMatrix coo; };
+	vector<TestMatrix> matrices;
+	matrices.push_back({ "laplacian 1024^2", LaplacianMatrix(1024) });
+	matrices.push_back({ "uniform 1..31", RandomSparseMatrix(1 << 20, 1 << 20, [](int) { return 1 + rand() % 31; }) });
+	matrices.push_back({ "power law", RandomSparseMatrix(1 << 20, 1 << 20, [](int) {
+		double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+		return (int)std::min(2.0 / std::pow(u, 0.8), 20000.0); }) });
+	matrices.push_back({ "long rows 256", RandomSparseMatrix(1 << 15, 1 << 20, [](int) { return 192 + rand() % 128; }) });
+	matrices.push_back({ "small irregular", RandomSparseMatrix(2000, 2000, [](int r) { return (r % 10) ? 2 : 200; }) });
+
+	for (TestMatrix& m : matrices) {
+		CsrMatrix csr = CooToCsr(m.coo);
+		m.coo = CooMatrix(); //the COO copy is no longer needed
+
+		vector<float> x(csr.cols);
+		for (int i = 0; i < csr.cols; i++)
+			x[i] = (rand() % 2000 - 1000) / 1000.0f;
+		vector<float> reference = SpmvReference(csr, x);
+		vector<float> y(csr.rows);
+
+		cl::Buffer buffer_x = UploadVector(context, queue, x);
+		cl::Buffer buffer_y(context, CL_MEM_READ_WRITE, std::max(csr.rows, 1) * sizeof(float));
+		DeviceCsr dev_csr = UploadCsr(context, queue, csr);
+
+		RowStats stats = GatherRowStats(context, queue, program, dev_csr.row_ptr, csr.rows);
+		SpmvFormat chosen = ChooseSpmvFormat(stats);
+		int lanes = CsrVectorLanes(stats);
+
+		std::cout << std::endl << m.name << ": " << stats.rows << " rows, " << stats.nnz << " non-zeros, row length min "
+			<< stats.min_length << " mean " << std::fixed << std::setprecision(1) << stats.mean << " max " << stats.max_length
+			<< " -> " << SpmvFormatName(chosen) << std::endl;
+
+		for (SpmvFormat format : { SPMV_CSR_SCALAR, SPMV_CSR_VECTOR, SPMV_ELL, SPMV_SELL }) {
+			DeviceEll dev_ell;
+			DeviceSell dev_sell;
+			if (format == SPMV_ELL) {
+				if ((size_t)stats.max_length * stats.rows > max_padded_entries) {
+					std::cout << std::setw(16) << SpmvFormatName(format) << "  skipped, padding to " << stats.max_length << " entries per row" << std::endl;
+					continue;
+				}
+				dev_ell = UploadEll(context, queue, CsrToEll(csr));
+			}
+			else if (format == SPMV_SELL) {
+				dev_sell = UploadSell(context, queue, CsrToSell(csr));
+			}
+
+			double total = 0;
+			for (int r = 0; r < repeats; r++) {
+				cl::Event prof_event;
+				if (format == SPMV_CSR_SCALAR) prof_event = SpmvCsr(queue, program, dev_csr, buffer_x, buffer_y, false);
+				else if (format == SPMV_CSR_VECTOR) prof_event = SpmvCsr(queue, program, dev_csr, buffer_x, buffer_y, true, lanes);
+				else if (format == SPMV_ELL) prof_event = SpmvEll(queue, program, dev_ell, buffer_x, buffer_y);
+				else prof_event = SpmvSell(queue, program, dev_sell, buffer_x, buffer_y);
+				prof_event.wait();
+				total += prof_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - prof_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+			}
+			double seconds = total / repeats / PROF_S;
+
+			queue.enqueueReadBuffer(buffer_y, CL_TRUE, 0, y.size() * sizeof(float), &y[0]);
+			std::cout << std::setw(16) << SpmvFormatName(format) << (format == chosen ? " *" : "  ")
+				<< std::setw(10) << (int)(seconds * 1e6) << " us" << std::setw(10) << std::setprecision(2) << (2.0 * stats.nnz / seconds / 1e9) << " GFLOP/s"
+				<< std::setw(8) << (SpmvCheck(y, reference) ? "OK" : "FAILED") << std::endl;
+		}
+	}
+}
@@ -0,0 +1,56 @@
+//batched operations on many small vectors packed one after another into a single buffer
+//segment s occupies elements offsets[s] .. offsets[s+1]-1, so segments can have different lengths
+
+//elementwise operations do not care where one segment ends, so the whole packed buffer is one launch
+//(a single segment can still be processed on its own by launching with a global offset); end is one past the
+//last element of the launch, the rounded-up work-items beyond it must not spill into the next segment
+kernel void batch_add(global const int* A, global const int* B, global int* C, const int end) {
+	int id = get_global_id(0);
+	if (id < end)
+		C[id] = A[id] + B[id];
+}
+
+kernel void batch_mul(global const int* A, global const int* B, global int* C, const int end) {
+	int id = get_global_id(0);
+	if (id < end)
+		C[id] = A[id] * B[id];
+}
+
+kernel void batch_multadd(global const int* A, global const int* B, global int* C, const int end) {
+	int id = get_global_id(0);
+	if (id < end)
+		C[id] = (A[id] * B[id]) + B[id];
+}
+
+//per-segment reductions: lanes consecutive work-items share a segment, so a work-group handles
+//get_local_size(0)/lanes segments (lanes = local size gives one work-group per segment, small lanes
+//pack many short segments into one work-group); each lane accumulates a strided part of its segment
+//privately and the lanes are then combined with a tree reduction in local memory
+//out[s] receives the result of segment s for s = seg_first .. segments-1, empty segments give the neutral element
+#define DEFINE_SEG_REDUCE(NAME, OP, NEUTRAL) \
+kernel void NAME(global const int* A, global const int* offsets, global int* out, \
+			const int seg_first, const int segments, const int lanes, local int* scratch) { \
+	int lid = get_local_id(0); \
+	int segment = seg_first + get_global_id(0) / lanes; \
+	int lane = get_global_id(0) % lanes; \
+	int result = NEUTRAL; \
+	if (segment < segments) { \
+		for (int i = offsets[segment] + lane; i < offsets[segment + 1]; i += lanes) \
+			result = OP(result, A[i]); \
+	} \
+	scratch[lid] = result; \
+	barrier(CLK_LOCAL_MEM_FENCE); \
+	for (int i = lanes / 2; i > 0; i /= 2) { \
+		if (lane < i) \
+			scratch[lid] = OP(scratch[lid], scratch[lid + i]); \
+		barrier(CLK_LOCAL_MEM_FENCE); \
+	} \
+	if (lane == 0 && segment < segments) \
+		out[segment] = scratch[lid]; \
+}
+
+#define SEG_ADD(a, b) ((a) + (b))
+
+DEFINE_SEG_REDUCE(seg_reduce_sum, SEG_ADD, 0)
+DEFINE_SEG_REDUCE(seg_reduce_min, min, INT_MAX)
+DEFINE_SEG_REDUCE(seg_reduce_max, max, INT_MIN)
@@ -0,0 +1,95 @@
+//sparse matrix-vector multiplication y = A*x in CSR, ELL and SELL-C-sigma formats
+
+//length of every CSR row, for the row statistics gathered with reduce_add_4/reduce_min/reduce_max
+//the global size is padded to a multiple of the reduction work-group size: padding entries are set
+//to 0 for the sum and max reductions and to pad_min (a large value) in min_lengths for the min reduction
+kernel void csr_row_lengths(global const int* row_ptr, global int* lengths, global int* min_lengths, const int rows, const int pad_min) {
+	int id = get_global_id(0);
+	int length = (id < rows) ? row_ptr[id + 1] - row_ptr[id] : 0;
+	lengths[id] = length;
+	min_lengths[id] = (id < rows) ? length : pad_min;
+}
+
+//CSR scalar: one work-item per row, good for short rows
+kernel void spmv_csr_scalar(global const int* row_ptr, global const int* col, global const float* val,
+				global const float* x, global float* y, const int rows) {
+	int row = get_global_id(0);
+	if (row >= rows)
+		return;
+
+	float result = 0.0f;
+	for (int j = row_ptr[row]; j < row_ptr[row + 1]; j++)
+		result += val[j] * x[col[j]];
+
+	y[row] = result;
+}
+
+//CSR vector: lanes consecutive work-items share a row, so reads of col/val are coalesced for long rows
+//the partial sums are combined with a tree reduction in local memory (scratch holds one float per work-item)
+//lanes must be a power of 2 dividing the local size
+kernel void spmv_csr_vector(global const int* row_ptr, global const int* col, global const float* val,
+				global const float* x, global float* y, const int rows, const int lanes, local float* scratch) {
+	int id = get_global_id(0);
+	int lid = get_local_id(0);
+	int row = id / lanes;
+	int lane = id % lanes;
+
+	float result = 0.0f;
+	if (row < rows) {
+		for (int j = row_ptr[row] + lane; j < row_ptr[row + 1]; j += lanes)
+			result += val[j] * x[col[j]];
+	}
+
+	scratch[lid] = result;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int i = lanes / 2; i > 0; i /= 2) {
+		if (lane < i)
+			scratch[lid] += scratch[lid + i];
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (lane == 0 && row < rows)
+		y[row] = scratch[lid];
+}
+
+//ELL: every row padded to width entries, stored column-major (entry k of row r at k*rows + r)
+//so consecutive work-items read consecutive addresses; padding entries have col = -1
+kernel void spmv_ell(global const int* col, global const float* val, global const float* x, global float* y,
+			const int rows, const int width) {
+	int row = get_global_id(0);
+	if (row >= rows)
+		return;
+
+	float result = 0.0f;
+	for (int k = 0; k < width; k++) {
+		int c = col[k * rows + row];
+		if (c >= 0)
+			result += val[k * rows + row] * x[c];
+	}
+
+	y[row] = result;
+}
+
+//SELL-C-sigma: rows are sorted by length within windows of sigma rows and cut into chunks of C rows,
+//each chunk is an ELL matrix of its own width, so padding stays small for irregular row lengths
+//one work-item per row slot, the global size is chunks*C; row_perm maps a slot back to its matrix row
+kernel void spmv_sell(global const int* chunk_ptr, global const int* chunk_width, global const int* row_perm,
+			global const int* col, global const float* val, global const float* x, global float* y, const int C) {
+	int id = get_global_id(0);
+	int chunk = id / C;
+	int lane = id % C;
+	int row = row_perm[id];
+	if (row < 0) //padding slot of the last chunk
+		return;
+
+	int offset = chunk_ptr[chunk] + lane;
+	float result = 0.0f;
+	for (int k = 0; k < chunk_width[chunk]; k++) {
+		int c = col[offset + k * C];
+		if (c >= 0)
+			result += val[offset + k * C] * x[c];
+	}
+
+	y[row] = result;
+}
@@ -3,6 +3,8 @@
 #include <climits>
 
 #include "Utils.h"
+#include "Sparse.h"
+#include "Batched.h"
 
 void print_help() {
 	std::cerr << "Application usage:" << std::endl;
@@ -10,6 +12,7 @@ void print_help() {
 	std::cerr << "  -p : select platform " << std::endl;
 	std::cerr << "  -d : select device" << std::endl;
 	std::cerr << "  -l : list all platforms and devices" << std::endl;
+	std::cerr << "  -b : run a benchmark instead of the example (spmv, batched)" << std::endl;
 	std::cerr << "  -h : print this message" << std::endl;
 }
 
@@ -17,11 +20,13 @@ int main(int argc, char **argv) {
 	//------- handle command line options such as device selection, verbosity, etc.
 	int platform_id = 0;
 	int device_id = 0;
+	string benchmark = "";
 
 	for (int i = 1; i < argc; i++)	{
 		if ((strcmp(argv[i], "-p") == 0) && (i < (argc - 1))) { platform_id = atoi(argv[++i]); }
 		else if ((strcmp(argv[i], "-d") == 0) && (i < (argc - 1))) { device_id = atoi(argv[++i]); }
 		else if (strcmp(argv[i], "-l") == 0) { std::cout << ListPlatformsDevices() << std::endl; }
+		else if ((strcmp(argv[i], "-b") == 0) && (i < (argc - 1))) { benchmark = argv[++i]; }
 		else if (strcmp(argv[i], "-h") == 0) { print_help(); return 0;}
 	}
 
@@ -41,6 +46,8 @@ int main(int argc, char **argv) {
 		cl::Program::Sources sources;
 
 		AddSources(sources, "kernels/my_kernels.cl");
+		AddSources(sources, "kernels/spmv.cl");
+		AddSources(sources, "kernels/batched.cl");
 
 		cl::Program program(context, sources);
 
@@ -55,6 +62,15 @@ int main(int argc, char **argv) {
 			throw err;
 		}
 
+		if (benchmark == "spmv") {
+			BenchmarkSpmv(context, queue, program);
+			return 0;
+		}
+		else if (benchmark == "batched") {
+			BenchmarkBatched(context, queue, program);
+			return 0;
+		}
+
 		typedef int mytype;
 
 		//----------- memory allocation